@@ -11,23 +11,62 @@
 #include <windows.h>
 #else
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
+#define DEFAULT_HEAP_SIZE (64 * 1024 * 1024)
+
 static int global_mem[1024 * 8];
 
+// the program is mapped into memory, or read in blocks if that fails
+static char *text;
+static int  text_len;
+
+static struct {
+    int  fileno;
+    int  pos, len;
+    char buffer[4096];
+} input;
+
 static int read_from_fileno(void *arg)
 {
     // read one character from file
-    long fileno = (long) arg;
-    char buffer[4];
-    int rc = read(fileno, buffer, 1);
-    if (rc)
-        return buffer[0];
+    if (input.pos >= input.len) {
+        input.pos = 0;
+        input.len = read(input.fileno, input.buffer, sizeof(input.buffer));
+        if (input.len <= 0) {
+            input.len = 0;
+            return 0;
+        }
+    }
+    return input.buffer[input.pos++];
+}
 
-    return 0;
+static void map_program(int fileno)
+{
+#ifndef _MSC_VER
+    struct stat st;
+
+    if (fstat(fileno, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size < 0x7fffffff) {
+        text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno, 0);
+        if (text == MAP_FAILED)
+            text = NULL;
+        else
+            text_len = (int) st.st_size;
+    }
+#endif
+    input.fileno = fileno;
+}
+
+static struct urubasic_ctx *load_program(void *mem, int max_mem)
+{
+    if (text != NULL)
+        return urubasic_init_text(mem, max_mem, text, text_len);
+    return urubasic_init(mem, max_mem, read_from_fileno, NULL);
 }
 
-static int fct_rnd(int n, struct urubasic_type *arg, void *user)
+static int fct_rnd(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     int res = rand();
     if (n > 1 && urubasic_is_number(&arg[1]))
@@ -38,7 +77,7 @@ static int fct_rnd(int n, struct urubasic_type *arg, void *user)
     return res;
 }
 
-static int fct_randomize(int n, struct urubasic_type *arg, void *user)
+static int fct_randomize(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     unsigned int seed = time(NULL);
 
@@ -52,16 +91,85 @@ static int fct_randomize(int n, struct urubasic_type *arg, void *user)
     return 0;
 }
 
+static int parse_size(char *s)
+{
+    // number of bytes with an optional k or m suffix
+    char *end;
+    long size = strtol(s, &end, 0);
+
+    if (*end == 'k' || *end == 'K')
+        size *= 1024, ++end;
+    else if (*end == 'm' || *end == 'M')
+        size *= 1024 * 1024, ++end;
+    if (*end != '\0' || size <= 0 || size > 0x7fffffffL)
+        return 0;
+    return (int) size;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: urubasic [-m size[k|m]] [-f] [-l] [-O0|-O1|-O2] [--emit-c] [file]\n");
+    fprintf(stderr, "  -m  heap size, default %d bytes\n", DEFAULT_HEAP_SIZE);
+    fprintf(stderr, "  -f  fixed heap which does not grow\n");
+    fprintf(stderr, "  -l  list the program instead of running it\n");
+    fprintf(stderr, "  -O  optimization level, default 2\n");
+    fprintf(stderr, "  --emit-c  translate the program to C instead of running it\n");
+}
+
 int main(int argc, char *argv[])
 {
-    int fileno = 0;
-    if (argc > 1)
-        fileno = open(argv[1], 0);
-
-    urubasic_init(global_mem, sizeof(global_mem), read_from_fileno, (void *) (long) fileno);
-    urubasic_add_function("RND", fct_rnd, NULL);
-    urubasic_add_function("RANDOMIZE", fct_randomize, NULL);
-    urubasic_execute(0);
-    urubasic_term();
+    struct urubasic_ctx *ctx = NULL;
+    int fileno = 0, heap_size = 0, fixed = 0, list = 0, emit_c = 0, optimize = 2, i;
+    void *heap = NULL;
+
+    for (i=1; i<argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        if (0 == strcmp(argv[i], "-m") && i+1 < argc && (heap_size = parse_size(argv[i+1])) != 0)
+            ++i;
+        else if (0 == strcmp(argv[i], "-f"))
+            fixed = 1;
+        else if (0 == strcmp(argv[i], "-l"))
+            list = 1;
+        else if (argv[i][1] == 'O' && argv[i][2] >= '0' && argv[i][2] <= '2' && argv[i][3] == '\0')
+            optimize = argv[i][2] - '0';
+        else if (0 == strcmp(argv[i], "--emit-c"))
+            emit_c = 1;
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (i < argc && (fileno = open(argv[i], 0)) < 0) {
+        fprintf(stderr, "urubasic: cannot open %s\n", argv[i]);
+        return 1;
+    }
+    map_program(fileno);
+
+    // the heap grows when mmap is available, otherwise it has a fixed size
+    if (!fixed)
+        ctx = load_program(NULL, heap_size ? heap_size : DEFAULT_HEAP_SIZE);
+    if (ctx == NULL && heap_size)
+        heap = malloc(heap_size);
+    if (ctx == NULL && heap != NULL)
+        ctx = load_program(heap, heap_size);
+    if (ctx == NULL)
+        ctx = load_program(global_mem, sizeof(global_mem));
+#ifndef _MSC_VER
+    if (text != NULL)
+        munmap(text, text_len);
+#endif
+    if (ctx == NULL)
+        return 1;
+
+    urubasic_add_function(ctx, "RND", fct_rnd, NULL);
+    urubasic_add_function(ctx, "RANDOMIZE", fct_randomize, NULL);
+    urubasic_set_optimize(ctx, optimize);
+    if (list)
+        urubasic_list(ctx);
+    else if (emit_c)
+        urubasic_emit_c(ctx);
+    else
+        urubasic_execute(ctx, 0);
+    urubasic_term(ctx);
+    free(heap);
     return 0;
 }
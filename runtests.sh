@@ -1,4 +1,22 @@
 #!/bin/bash
+# -c runs the tests translated to C by urubasic --emit-c,
+# -l runs them from the listing of urubasic -l,
+# -p pipes them to the loader which reads characters,
+# -O0 or -O1 runs them with less optimization,
+# -16 skips the tests which need more than the 32 KB heap of SMEMBLK_16BIT
+translate=0
+listed=0
+piped=0
+options=""
+compact=0
+big_tests="055_bigheap 067_symtab"
+for arg in "$@"; do
+    [ "$arg" = "-c" ] && translate=1
+    [ "$arg" = "-l" ] && listed=1
+    [ "$arg" = "-p" ] && piped=1
+    [ "$arg" = "-16" ] && compact=1
+    [[ "$arg" == -O* ]] && options="$options $arg"
+done
 total=0
 copied=0
 diffed=0
@@ -18,12 +36,29 @@ run_test () {
 
     for filename in ${spec}; do
         [ -e "$filename" ] || continue
+        fname=${filename##*/}
+        if [ $compact -eq 1 ] && [[ " $big_tests " == *" ${fname%.*} "* ]]; then
+            echo "$filename skipped"
+            continue
+        fi
         ((l_total=l_total+1))
         echo "$program <""$filename"
-        fname=${filename##*/}
 
         rm -f "${filename%.*}.res"
-        $program < "$filename" > "${filename%.*}.res"
+        if [ $translate -eq 1 ]; then
+            $program --emit-c "$filename" > "${filename%.*}.c" 2>/dev/null
+            gcc -O1 -w -I. -o "${filename%.*}.bin" "${filename%.*}.c" main.c smemblk.c
+            "${filename%.*}.bin" < "$filename" > "${filename%.*}.res" 2>&1
+            rm -f "${filename%.*}.c" "${filename%.*}.bin"
+        elif [ $listed -eq 1 ]; then
+            $program -l "$filename" > "${filename%.*}.lst" 2>/dev/null
+            $program < "${filename%.*}.lst" > "${filename%.*}.res" 2>&1
+            rm -f "${filename%.*}.lst"
+        elif [ $piped -eq 1 ]; then
+            cat "$filename" | $program > "${filename%.*}.res" 2>&1
+        else
+            $program < "$filename" > "${filename%.*}.res" 2>&1
+        fi
 
         if [ -f "${filename%.*}.ok" ]; then
             ((l_diffed=l_diffed+1))
@@ -61,7 +96,7 @@ read_test_results () {
 
 # run all tests
 
-run_test "test" "./urubasic" "/*.bas"
+run_test "test" "./urubasic$options" "/*.bas"
 
 read_test_results "test/result.out"
 
@@ -10,26 +10,41 @@
 #endif
 #include "smemblk.h"
 
+#if defined(SMEMBLK_32BIT) && !defined(__ETS__) && !defined(_WIN32)
+#define SMEMBLK_MMAP
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 // #define SMEMBLK_DEBUG
 
-static int16_t ICACHE_FLASH_ATTR abs16(int16_t n) { return n < 0 ? -n : n; }
+static smemblk_size_t ICACHE_FLASH_ATTR abs_size(smemblk_size_t n) { return n < 0 ? -n : n; }
 
-static int16_t * ICACHE_FLASH_ATTR block_ptr(smemblk_t *smem, int offset)
+static smemblk_size_t * ICACHE_FLASH_ATTR block_ptr(smemblk_t *smem, int offset)
 {
-    return (int16_t *)((int8_t *)&smem[1]+offset);
+    return (smemblk_size_t *)((int8_t *)&smem[1]+offset);
 }
 
-static int16_t ICACHE_FLASH_ATTR block_len(smemblk_t *smem, int offset)
+#ifdef SMEMBLK_FIRSTFIT
+static smemblk_size_t ICACHE_FLASH_ATTR block_len(smemblk_t *smem, int offset)
+{
+    return abs_size(*block_ptr(smem, offset));
+}
+#else
+static smemblk_size_t ICACHE_FLASH_ATTR block_len(smemblk_t *smem, int offset)
 {
-    return abs16(*block_ptr(smem, offset));
+    // the lower two bits of the size are flags
+    return abs_size(*block_ptr(smem, offset)) & ~3;
 }
+#endif
 
+#ifdef SMEMBLK_FIRSTFIT
 void ICACHE_FLASH_ATTR smemblk_gc(smemblk_t *smem)
 {
     int16_t *p, *base_ptr;
 
     p = base_ptr = block_ptr(smem, smem->start);
-    while ((p - base_ptr) < (smem->total_size >> 1) && (((int8_t *) p + abs16(*p)) < (int8_t *) base_ptr + smem->total_size)) {
+    while ((p - base_ptr) < (smem->total_size >> 1) && (((int8_t *) p + abs_size(*p)) < (int8_t *) base_ptr + smem->total_size)) {
         if (*p < 0 && p[-*p >> 1] < 0)
             *p += p[-*p >> 1];
         else if (*p < 0)
@@ -39,29 +54,6 @@ void ICACHE_FLASH_ATTR smemblk_gc(smemblk_t *smem)
     }
 }
 
-// #ifdef SMEMBLK_DEBUG
-void ICACHE_FLASH_ATTR smemblk_debug_dump(smemblk_t *smem)
-{
-    int offset, prev_offset = smem->start, prev_len = 0, total_used = 0, total_free = 0;
-
-    for (offset = smem->start; offset < smem->total_size; offset += block_len(smem, offset)) {
-        if (offset != prev_offset + prev_len)
-            TRACE_LOG("INTEGRITY ERROR in smemblk offset %d !!\n", offset);
-        if (*block_ptr(smem, offset) < 0) {
-            TRACE_LOG("%5d: FREE %5d bytes\n", offset, block_len(smem, offset));
-            total_free += block_len(smem, offset);
-        }
-        else {
-            TRACE_LOG("%5d: USED %5d bytes\n", offset, block_len(smem, offset));
-            total_used += block_len(smem, offset);
-        }
-
-        prev_offset = offset;
-        prev_len    = block_len(smem, offset);
-    }
-    TRACE_LOG("first_free = %d, total_used = %d, total_free = %d\n\n", (int) (smem->first_free), total_used, total_free);
-}
-// #endif
 
 smemblk_t * ICACHE_FLASH_ATTR smemblk_init(char *buffer, int buffer_len)
 {
@@ -69,6 +61,8 @@ smemblk_t * ICACHE_FLASH_ATTR smemblk_init(char *buffer, int buffer_len)
     int16_t   *p;
     int       remain;
 
+    if (buffer_len > 0x8000)
+        buffer_len = 0x8000;    // offsets are 16 bit
     while ((long)buffer % 4) {
         ++buffer;
         buffer_len -= 1;
@@ -146,7 +140,7 @@ static void * ICACHE_FLASH_ATTR smemblk_alloc_intern(smemblk_t *smem, int16_t si
     return NULL;
 }
 
-void * ICACHE_FLASH_ATTR smemblk_alloc(smemblk_t *smem, int16_t size)
+void * ICACHE_FLASH_ATTR smemblk_alloc(smemblk_t *smem, smemblk_size_t size)
 {
     void *p;
     if (smem == NULL)
@@ -163,15 +157,7 @@ void * ICACHE_FLASH_ATTR smemblk_alloc(smemblk_t *smem, int16_t size)
     return p;
 }
 
-void * ICACHE_FLASH_ATTR smemblk_zalloc(smemblk_t *smem, int16_t size)
-{
-    void *p = smemblk_alloc(smem, size);
-    if (p != NULL)
-        memset(p, 0, size);
-    return p;
-}
-
-void * ICACHE_FLASH_ATTR smemblk_realloc(smemblk_t *smem, void *buf, int16_t size)
+void * ICACHE_FLASH_ATTR smemblk_realloc(smemblk_t *smem, void *buf, smemblk_size_t size)
 {
     int16_t *p, *temp, buf_size;
     int8_t  *next_p, *base_ptr = (int8_t *) block_ptr(smem, sizeof(*smem));
@@ -228,6 +214,16 @@ void * ICACHE_FLASH_ATTR smemblk_realloc(smemblk_t *smem, void *buf, int16_t siz
     return temp;
 }
 
+smemblk_size_t ICACHE_FLASH_ATTR smemblk_size(smemblk_t *smem, void *buf)
+{
+    return ((int16_t *) buf)[-1] - 2;
+}
+
+smemblk_t * ICACHE_FLASH_ATTR smemblk_init_mmap(int size, int max_size)
+{
+    return NULL;
+}
+
 void ICACHE_FLASH_ATTR smemblk_free(smemblk_t *smem, void *buf)
 {
     int16_t *p;
@@ -246,9 +242,435 @@ void ICACHE_FLASH_ATTR smemblk_free(smemblk_t *smem, void *buf)
 #endif
 }
 
+#endif
+
+#ifdef SMEMBLK_FREELIST
+// a block starts with its size. The size is negative for free blocks and
+// PREV_FREE is set when the block in front is free. Free blocks hold the
+// offsets of the next and previous block of their size class list and end
+// with a copy of their size, so that neighbours are merged in O(1)
+#define HDR ((int) sizeof(smemblk_size_t))
+
+enum {
+    ALIGN     = 2 * HDR,        // alignment of the data behind the header
+    MIN_BLOCK = 4 * HDR,        // header, next, prev and footer
+    MAX_BLOCK = SMEMBLK_MAX_SIZE + 8,
+    PREV_FREE = 2,
+};
+
+static int ICACHE_FLASH_ATTR size_class(int size)
+{
+    // class k holds blocks of MIN_BLOCK<<k up to (MIN_BLOCK<<(k+1))-1 bytes
+    int k = 0;
+
+    while (k < SMEMBLK_CLASSES-1 && (size >> (k+1)) >= MIN_BLOCK)
+        ++k;
+    return k;
+}
+
+static int ICACHE_FLASH_ATTR block_size(int size)
+{
+    // size of the block for size bytes of data, p+HDR stays aligned
+    size = (size + HDR + ALIGN-1) & ~(ALIGN-1);
+    return size < MIN_BLOCK ? MIN_BLOCK : size;
+}
+
+static void ICACHE_FLASH_ATTR set_header(smemblk_t *smem, int offset, int size, int flags, int is_free)
+{
+    *block_ptr(smem, offset) = (smemblk_size_t) (is_free ? -(size | flags) : (size | flags));
+}
+
+static void ICACHE_FLASH_ATTR set_footer(smemblk_t *smem, int offset, int size)
+{
+    block_ptr(smem, offset)[size / HDR - 1] = (smemblk_size_t) size;
+}
+
+static int ICACHE_FLASH_ATTR prev_free(smemblk_t *smem, int offset)
+{
+    if (offset >= smem->total_size)
+        return smem->end_flags;
+    return abs_size(*block_ptr(smem, offset)) & PREV_FREE;
+}
+
+static void ICACHE_FLASH_ATTR set_prev_free(smemblk_t *smem, int offset, int flag)
+{
+    // update the flag in the header of the block at offset
+    smemblk_size_t *p;
+
+    if (offset >= smem->total_size) {
+        smem->end_flags = (smemblk_size_t) flag;  // remembered for growing the heap
+        return;
+    }
+    p = block_ptr(smem, offset);
+    set_header(smem, offset, block_len(smem, offset), flag, *p < 0);
+}
+
+static void ICACHE_FLASH_ATTR list_insert(smemblk_t *smem, int offset)
+{
+    smemblk_size_t *p = block_ptr(smem, offset);
+    int k = size_class(block_len(smem, offset));
+
+    p[1] = smem->free_list[k];
+    p[2] = -1;
+    if (p[1] >= 0)
+        block_ptr(smem, p[1])[2] = (smemblk_size_t) offset;
+    smem->free_list[k] = (smemblk_size_t) offset;
+    smem->free_map |= (smemblk_map_t) 1 << k;
+}
+
+static void ICACHE_FLASH_ATTR list_remove(smemblk_t *smem, int offset)
+{
+    smemblk_size_t *p = block_ptr(smem, offset);
+    int k = size_class(block_len(smem, offset));
+
+    if (p[2] >= 0)
+        block_ptr(smem, p[2])[1] = p[1];
+    else
+        smem->free_list[k] = p[1];
+    if (p[1] >= 0)
+        block_ptr(smem, p[1])[2] = p[2];
+    if (smem->free_list[k] < 0)
+        smem->free_map &= ~((smemblk_map_t) 1 << k);
+}
+
+static void ICACHE_FLASH_ATTR make_free(smemblk_t *smem, int offset, int size, int flags)
+{
+    // turn the area into a free block and merge it with its free neighbours
+    int next = offset + size, prev_size;
+
+    if (next < smem->total_size && *block_ptr(smem, next) < 0 && size + block_len(smem, next) <= MAX_BLOCK) {
+        list_remove(smem, next);
+        size += block_len(smem, next);
+        next = offset + size;
+    }
+
+    if (flags & PREV_FREE) {
+        prev_size = block_ptr(smem, offset)[-1];
+        if (prev_size + size <= MAX_BLOCK) {
+            offset -= prev_size;
+            list_remove(smem, offset);
+            size += prev_size;
+            flags = prev_free(smem, offset);
+        }
+    }
+
+    set_header(smem, offset, size, flags, 1);
+    set_footer(smem, offset, size);
+    list_insert(smem, offset);
+    set_prev_free(smem, next, PREV_FREE);
+}
+
+static void * ICACHE_FLASH_ATTR use_block(smemblk_t *smem, int offset, int size)
+{
+    // allocate size bytes of the free block at offset, the rest stays free
+    int len = block_len(smem, offset), flags = prev_free(smem, offset);
+
+    list_remove(smem, offset);
+    if (len - size >= MIN_BLOCK) {
+        set_header(smem, offset, size, flags, 0);
+        make_free(smem, offset + size, len - size, 0);
+    }
+    else {
+        set_header(smem, offset, len, flags, 0);
+        set_prev_free(smem, offset + len, 0);
+    }
+    return block_ptr(smem, offset) + 1;
+}
+
+static void ICACHE_FLASH_ATTR add_free_area(smemblk_t *smem, int offset, int end)
+{
+    // cover offset up to end with free blocks, end is moved down if the rest is too small
+    int size;
+
+    for (; offset + MIN_BLOCK <= end; offset += size) {
+        size = end - offset > MAX_BLOCK ? MAX_BLOCK : end - offset;
+        if (end - offset - size > 0 && end - offset - size < MIN_BLOCK)
+            size -= MIN_BLOCK;
+        smem->total_size = offset + size;
+        make_free(smem, offset, size, smem->end_flags);
+    }
+}
+
+static smemblk_t * ICACHE_FLASH_ATTR init_freelist(char *buffer, int buffer_len, int reserved_size)
+{
+    smemblk_t *smem;
+    int       k, end;
+
+#ifdef SMEMBLK_16BIT
+    if (buffer_len > 0x8000)
+        buffer_len = 0x8000;    // offsets are 16 bit
+#endif
+    while ((long)buffer % sizeof(long)) {
+        ++buffer;
+        buffer_len -= 1;
+    }
+    smem = (smemblk_t *) buffer;
+    smem->start = 0;
+    while (((long)block_ptr(smem, smem->start)+HDR) % ALIGN)
+        smem->start += HDR;
+    end = smem->start + ((buffer_len - (int) sizeof(smemblk_t) - smem->start) & ~(ALIGN-1));
+
+    smem->first_free = 0;
+    smem->free_map = 0;
+    for (k=0; k<SMEMBLK_CLASSES; ++k)
+        smem->free_list[k] = -1;
+    smem->end_flags = 0;
+#ifdef SMEMBLK_32BIT
+    smem->reserved_size = reserved_size;
+#endif
+
+    smem->total_size = smem->start;
+    add_free_area(smem, smem->start, end);
+
+#ifdef SMEMBLK_DEBUG
+    smemblk_debug_dump(smem);
+#endif
+    return smem;
+}
+
+smemblk_t * ICACHE_FLASH_ATTR smemblk_init(char *buffer, int buffer_len)
+{
+    return init_freelist(buffer, buffer_len, 0);
+}
+
+#ifdef SMEMBLK_MMAP
+static int ICACHE_FLASH_ATTR mapped_size(int size)
+{
+    long page = sysconf(_SC_PAGESIZE);
+
+    return (int) ((size + page - 1) & ~(page - 1));
+}
+
+smemblk_t * ICACHE_FLASH_ATTR smemblk_init_mmap(int size, int max_size)
+{
+    // reserve the address space and make the first part accessible
+    char *buffer;
+
+    if (max_size < size)
+        max_size = size;
+    size     = mapped_size(size);
+    max_size = mapped_size(max_size);
+    buffer = mmap(NULL, max_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+        return NULL;
+    if (mprotect(buffer, size, PROT_READ | PROT_WRITE) != 0) {
+        munmap(buffer, max_size);
+        return NULL;
+    }
+    return init_freelist(buffer, size, max_size);
+}
+
+static int ICACHE_FLASH_ATTR grow(smemblk_t *smem, int len)
+{
+    // make at least len more bytes accessible, at least doubling the heap
+    int old_total = smem->total_size, old_size, new_size;
+
+    if (smem->reserved_size == 0 || len >= smem->reserved_size - MIN_BLOCK)
+        return 0;
+    old_size = mapped_size((int) sizeof(smemblk_t) + old_total);
+    new_size = old_size > smem->reserved_size / 2 ? smem->reserved_size : 2 * old_size;
+    if (new_size - old_size < len + MIN_BLOCK)
+        new_size = smem->reserved_size - old_size < len + MIN_BLOCK ? smem->reserved_size : mapped_size(old_size + len + MIN_BLOCK);
+    if (new_size <= old_size || mprotect((char *) smem + old_size, new_size - old_size, PROT_READ | PROT_WRITE) != 0)
+        return 0;
+
+    add_free_area(smem, old_total, smem->start + ((new_size - (int) sizeof(smemblk_t) - smem->start) & ~(ALIGN-1)));
+    return smem->total_size > old_total;
+}
+#else
+smemblk_t * ICACHE_FLASH_ATTR smemblk_init_mmap(int size, int max_size)
+{
+    return NULL;
+}
+
+static int ICACHE_FLASH_ATTR grow(smemblk_t *smem, int len)
+{
+    return 0;
+}
+#endif
+
+void ICACHE_FLASH_ATTR smemblk_gc(smemblk_t *smem)
+{
+    // free blocks are merged when they are freed
+}
+
+void * ICACHE_FLASH_ATTR smemblk_alloc(smemblk_t *smem, smemblk_size_t size)
+{
+    int k, offset, len;
+    smemblk_map_t map;
+
+    if (smem == NULL || size < 0 || size > SMEMBLK_MAX_SIZE)
+        return NULL;
+
+    len = block_size(size);
+    do {
+        // first fit within the size class
+        k = size_class(len);
+        for (offset=smem->free_list[k]; offset >= 0; offset = block_ptr(smem, offset)[1]) {
+            if (block_len(smem, offset) >= len)
+                return use_block(smem, offset, len);
+        }
+
+        // any block of a larger class is big enough
+        map = smem->free_map & ~(((smemblk_map_t) 2 << k) - 1);
+        if (map != 0) {
+            for (k=k+1; !(map & ((smemblk_map_t) 1 << k)); ++k)
+                ;
+            return use_block(smem, smem->free_list[k], len);
+        }
+    } while (grow(smem, len));
+    return NULL;
+}
+
+void * ICACHE_FLASH_ATTR smemblk_realloc(smemblk_t *smem, void *buf, smemblk_size_t size)
+{
+    int offset, len, next, flags, need;
+    void *temp;
+
+    if (buf == NULL)
+        return smemblk_alloc(smem, size);
+    if (size < 0 || size > SMEMBLK_MAX_SIZE)
+        return NULL;
+
+    offset = (int) ((int8_t *) buf - (int8_t *) block_ptr(smem, 0)) - HDR;
+    len    = block_len(smem, offset);
+    flags  = prev_free(smem, offset);
+    need   = block_size(size);
+
+    // grow into the next block if it is free
+    next = offset + len;
+    if (need > len && next < smem->total_size && *block_ptr(smem, next) < 0 && len + block_len(smem, next) >= need) {
+        list_remove(smem, next);
+        len += block_len(smem, next);
+        set_header(smem, offset, len, flags, 0);
+        set_prev_free(smem, offset + len, 0);
+    }
+
+    if (need <= len) {
+        // release the end of the block
+        if (len - need >= MIN_BLOCK) {
+            set_header(smem, offset, need, flags, 0);
+            make_free(smem, offset + need, len - need, 0);
+        }
+        return buf;
+    }
+
+    temp = smemblk_alloc(smem, size);
+    if (temp == NULL)
+        return NULL;
+
+    memcpy(temp, buf, len - HDR);
+    smemblk_free(smem, buf);
+    return temp;
+}
+
+void ICACHE_FLASH_ATTR smemblk_free(smemblk_t *smem, void *buf)
+{
+    int offset;
+
+    if (buf == NULL)
+        return;
+
+    offset = (int) ((int8_t *) buf - (int8_t *) block_ptr(smem, 0)) - HDR;
+    if (*block_ptr(smem, offset) > 0)
+        make_free(smem, offset, block_len(smem, offset), prev_free(smem, offset));
+}
+
+smemblk_size_t ICACHE_FLASH_ATTR smemblk_size(smemblk_t *smem, void *buf)
+{
+    // the block may be larger than requested, the rest of a free block is kept
+    // when it is too small for a block of its own
+    int offset = (int) ((int8_t *) buf - (int8_t *) block_ptr(smem, 0)) - HDR;
+
+    return (smemblk_size_t) (block_len(smem, offset) - HDR);
+}
+#endif
+
+void * ICACHE_FLASH_ATTR smemblk_zalloc(smemblk_t *smem, smemblk_size_t size)
+{
+    void *p = smemblk_alloc(smem, size);
+    if (p != NULL)
+        memset(p, 0, size);
+    return p;
+}
+
+int ICACHE_FLASH_ATTR smemblk_save_size(smemblk_t *smem)
+{
+#ifdef SMEMBLK_FREELIST
+    // a free last block is saved up to its links, its footer is restored from its header
+    if (smem->end_flags & PREV_FREE)
+        return (int) sizeof(smemblk_t) + smem->total_size - block_ptr(smem, smem->total_size)[-1] + 3 * HDR;
+#endif
+    return (int) sizeof(smemblk_t) + smem->total_size;
+}
+
+void ICACHE_FLASH_ATTR smemblk_save(smemblk_t *smem, void *snapshot)
+{
+    memcpy(snapshot, smem, (size_t) smemblk_save_size(smem));
+}
+
+smemblk_t * ICACHE_FLASH_ATTR smemblk_restore(char *buffer, int buffer_len, const void *snapshot, int len)
+{
+    smemblk_t *smem, saved;
+
+    while ((long)buffer % sizeof(long)) {
+        ++buffer;
+        buffer_len -= 1;
+    }
+    if (len < (int) sizeof(smemblk_t))
+        return NULL;
+    memcpy(&saved, snapshot, sizeof(saved));
+    if (len > (int) sizeof(smemblk_t) + saved.total_size || (int) sizeof(smemblk_t) + saved.total_size > buffer_len)
+        return NULL;
+#ifdef SMEMBLK_FREELIST
+    // the blocks are aligned for the address the heap was saved at
+    if (((long)block_ptr((smemblk_t *) buffer, saved.start)+HDR) % ALIGN)
+        return NULL;
+#endif
+
+    smem = (smemblk_t *) buffer;
+    memcpy(smem, snapshot, (size_t) len);
+#ifdef SMEMBLK_32BIT
+    smem->reserved_size = 0;    // the buffer does not grow
+#endif
+#ifdef SMEMBLK_FREELIST
+    if (smem->end_flags & PREV_FREE) {
+        len -= (int) sizeof(smemblk_t) + 3 * HDR;
+        set_footer(smem, len, block_len(smem, len));
+    }
+#endif
+    return smem;
+}
+
+// #ifdef SMEMBLK_DEBUG
+void ICACHE_FLASH_ATTR smemblk_debug_dump(smemblk_t *smem)
+{
+    int offset, prev_offset = smem->start, prev_len = 0, total_used = 0, total_free = 0;
+
+    for (offset = smem->start; offset < smem->total_size; offset += block_len(smem, offset)) {
+        if (offset != prev_offset + prev_len)
+            TRACE_LOG("INTEGRITY ERROR in smemblk offset %d !!\n", offset);
+        if (*block_ptr(smem, offset) < 0) {
+            TRACE_LOG("%5d: FREE %5d bytes\n", offset, block_len(smem, offset));
+            total_free += block_len(smem, offset);
+        }
+        else {
+            TRACE_LOG("%5d: USED %5d bytes\n", offset, block_len(smem, offset));
+            total_used += block_len(smem, offset);
+        }
+
+        prev_offset = offset;
+        prev_len    = block_len(smem, offset);
+    }
+    TRACE_LOG("first_free = %d, total_used = %d, total_free = %d\n\n", (int) (smem->first_free), total_used, total_free);
+}
+// #endif
+
 void ICACHE_FLASH_ATTR smemblk_term(smemblk_t *smem)
 {
-#ifndef __ETS__
+    // the blocks are released with the heap, SMEMBLK_CHECK_LEAKS reports the
+    // ones which were not freed
+#if defined(SMEMBLK_CHECK_LEAKS) && !defined(__ETS__)
     int offset, prev_offset = smem->start, prev_len = 0;
 
     for (offset = smem->start; offset < smem->total_size; offset += block_len(smem, offset)) {
@@ -261,4 +683,8 @@ void ICACHE_FLASH_ATTR smemblk_term(smemblk_t *smem)
         prev_len    = block_len(smem, offset);
     }
 #endif
+#ifdef SMEMBLK_MMAP
+    if (smem->reserved_size)
+        munmap(smem, smem->reserved_size);
+#endif
 }
@@ -5,21 +5,77 @@
 #define ICACHE_FLASH_ATTR
 #endif
 
+// SMEMBLK_16BIT selects the compact layout with 16-bit sizes and offsets,
+// which limits the heap to 32 KB. It is the default of the ESP8266 build,
+// other builds use 32-bit sizes and offsets (SMEMBLK_32BIT)
+#if !defined(SMEMBLK_16BIT) && !defined(SMEMBLK_32BIT)
+#ifdef __ETS__
+#define SMEMBLK_16BIT
+#else
+#define SMEMBLK_32BIT
+#endif
+#endif
+
+// SMEMBLK_FIRSTFIT selects the original first fit allocator, otherwise free
+// blocks are kept in segregated size class lists and coalesced on free
+#if !defined(SMEMBLK_FIRSTFIT) && !defined(SMEMBLK_FREELIST)
+#define SMEMBLK_FREELIST
+#endif
+
+#if defined(SMEMBLK_FIRSTFIT) && defined(SMEMBLK_32BIT)
+#error "the first fit allocator requires SMEMBLK_16BIT"
+#endif
+
+#ifdef SMEMBLK_32BIT
+typedef int32_t smemblk_size_t;
+typedef uint32_t smemblk_map_t;
+#define SMEMBLK_MAX_SIZE 0x7ffffff0     // largest block which can be allocated
+#define SMEMBLK_CLASSES  28
+#else
+typedef int16_t smemblk_size_t;
+typedef uint16_t smemblk_map_t;
+#define SMEMBLK_MAX_SIZE 0x7ff0
+#define SMEMBLK_CLASSES  12
+#endif
+
 typedef struct {
-    int16_t first_free;
-    int16_t start;
+    smemblk_size_t first_free;
+    smemblk_size_t start;
     int     total_size;
+#ifdef SMEMBLK_FREELIST
+    smemblk_map_t  free_map;                    // bit k is set when free_list[k] is not empty
+    smemblk_size_t free_list[SMEMBLK_CLASSES];  // offset of first free block of size class k
+    smemblk_size_t end_flags;                   // PREV_FREE when the last block is free
+#endif
+#ifdef SMEMBLK_32BIT
+    int     reserved_size;                      // address space reserved for growing, 0 if fixed
+#endif
 } smemblk_t;
 
 
 smemblk_t * ICACHE_FLASH_ATTR smemblk_init(char *buffer, int buffer_len);
-void * ICACHE_FLASH_ATTR smemblk_alloc(smemblk_t *smem, int16_t size);
-void * ICACHE_FLASH_ATTR smemblk_zalloc(smemblk_t *smem, int16_t size);
-void * ICACHE_FLASH_ATTR smemblk_realloc(smemblk_t *smem, void *buf, int16_t size);
+void * ICACHE_FLASH_ATTR smemblk_alloc(smemblk_t *smem, smemblk_size_t size);
+void * ICACHE_FLASH_ATTR smemblk_zalloc(smemblk_t *smem, smemblk_size_t size);
+void * ICACHE_FLASH_ATTR smemblk_realloc(smemblk_t *smem, void *buf, smemblk_size_t size);
 void ICACHE_FLASH_ATTR smemblk_free(smemblk_t *smem, void *buf);
+// bytes buf can hold, at least the size it was allocated with
+smemblk_size_t ICACHE_FLASH_ATTR smemblk_size(smemblk_t *smem, void *buf);
 void ICACHE_FLASH_ATTR smemblk_gc(smemblk_t *smem);
+// releases the heap without looking at its blocks, compiled with
+// SMEMBLK_CHECK_LEAKS it reports the blocks which are still allocated
 void ICACHE_FLASH_ATTR smemblk_term(smemblk_t *smem);
 
+// a snapshot of the heap is its used part, smemblk_save_size() bytes.
+// smemblk_restore() copies it to a buffer of at least the size of the saved
+// heap, pointers into the heap stay valid when it is the same buffer
+int ICACHE_FLASH_ATTR smemblk_save_size(smemblk_t *smem);
+void ICACHE_FLASH_ATTR smemblk_save(smemblk_t *smem, void *snapshot);
+smemblk_t * ICACHE_FLASH_ATTR smemblk_restore(char *buffer, int buffer_len, const void *snapshot, int len);
+
+// a heap of initial size bytes, which grows in mmap'd memory up to
+// max_size bytes. Returns NULL if mmap is not available
+smemblk_t * ICACHE_FLASH_ATTR smemblk_init_mmap(int size, int max_size);
+
 void ICACHE_FLASH_ATTR smemblk_debug_dump(smemblk_t *smem);
 
 #endif
@@ -0,0 +1,10 @@
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
+HELLO WORLD from subroutine
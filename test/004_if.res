@@ -0,0 +1 @@
+SUCCESS
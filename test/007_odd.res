@@ -0,0 +1,5 @@
+ 1
+ 3
+ 5
+ 7
+ 9
@@ -0,0 +1,4 @@
+ 1
+ 5
+ 9
+AFTER LOOP X IS 13
@@ -0,0 +1,13 @@
+ 20
+ 18
+ 16
+ 14
+ 12
+ 10
+ 8
+ 6
+ 4
+ 2
+ 0
+AFTER LOOP X IS -2
+SUCCESS
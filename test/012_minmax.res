@@ -0,0 +1 @@
+ 2              68            -2147483648     2147483647
@@ -0,0 +1,11 @@
+-5             -1
+-4             -1
+-3             -1
+-2             -1
+-1             -1
+ 0              0
+ 1              1
+ 2              1
+ 3              1
+ 4              1
+ 5              1
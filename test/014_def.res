@@ -0,0 +1,9 @@
+-4              16             256
+-3              9              81
+-2              4              16
+-1              1              1
+ 0              0              0
+ 1              1              1
+ 2              4              16
+ 3              9              81
+ 4              16             256
@@ -0,0 +1,3 @@
+HELLO
+               WORLD
+HELLO     WORLD
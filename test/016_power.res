@@ -0,0 +1,3 @@
+ 162            1296           162
+ 15625         -15625         -15625          15625
+ 1              1              0
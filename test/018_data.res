@@ -0,0 +1,17 @@
+YOU READ 1
+YOU READ 2
+YOU READ 3
+YOU READ -4
+YOU READ 4 ITEMS
+
+YOU SHOULD READ 4 ITEMS
+ITEM # 1 : 1
+ITEM # 2 : 2
+ITEM # 3 : 3
+ITEM # 4 : -4
+
+YOU SHOULD READ 4 ITEMS
+ITEM # 1 : 1
+ITEM # 2 : 2
+ITEM # 3 : 3
+ITEM # 4 : -4
@@ -0,0 +1 @@
+ 48
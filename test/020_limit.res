@@ -0,0 +1,6 @@
+ 2147483647
+-2147483648
+ 2147483647
+-2147483648
+ 0  32
+SUCCESS
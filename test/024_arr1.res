@@ -0,0 +1,3 @@
+ 0  3  6  9  12
+ 1  4  7  10  13
+ 2  5  8  11  14
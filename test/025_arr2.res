@@ -0,0 +1,7 @@
+ 0  4  8  12  16  20
+ 1  5  9  13  17  21
+ 2  6  10  14  18  22
+ 3  7  11  15  19  23
+
+ 0  0
+ 0  5
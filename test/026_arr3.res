@@ -0,0 +1,4 @@
+ 0  5  0  0  0  0  0  0  0  0  0 
+ 0  5  0  0  0  0  0  0  0  0  0 
+ 100
+ 0  0  0  0  0  0  0  0  0  5  100 
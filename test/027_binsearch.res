@@ -0,0 +1 @@
+ 13 FOUND AT INDEX 2
@@ -0,0 +1,3 @@
+HI              2
+HELLO           5
+SUCCESS
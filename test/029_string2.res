@@ -0,0 +1,39 @@
+
+S
+SA
+SAT
+SATU
+SATUR
+SATURD
+SATURDA
+SATURDAY
+SATURDAY
+SATURDAY M
+SATURDAY MO
+SATURDAY MOR
+SATURDAY MORN
+SATURDAY MORNI
+SATURDAY MORNIN
+SATURDAY MORNING
+SATURDAY MORNING
+
+G
+NG
+ING
+NING
+RNING
+ORNING
+MORNING
+ MORNING
+Y MORNING
+AY MORNING
+DAY MORNING
+NDAY MORNING
+UNDAY MORNING
+SUNDAY MORNING
+SUNDAY MORNING
+SUNDAY MORNING
+SUNDAY MORNING
+DAY
+MONDAY
+MORNING
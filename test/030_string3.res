@@ -0,0 +1,2 @@
+123            -123           X = 49 Y = 50 Z = 51
+SUCCESS
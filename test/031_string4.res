@@ -0,0 +1 @@
+HELLO WORLD
@@ -0,0 +1,2 @@
+ 42             43
+ 48  6  96
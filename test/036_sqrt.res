@@ -0,0 +1,2 @@
+Square root of 130000 is 360 ( 360 * 360 = 129600 )
+SUCCESS
@@ -0,0 +1,3 @@
+ 0             -2              1              0
+-2             -1             -1              1
+SUCCESS
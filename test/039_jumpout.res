@@ -0,0 +1,30 @@
+ 1
+ 2
+ 3
+ 4
+ 5
+SUCCESS
+ 1
+ 2
+ 3
+ 4
+ 5
+SUCCESS
+ 1
+ 2
+ 3
+ 4
+ 5
+SUCCESS
+ 1
+ 2
+ 3
+ 4
+ 5
+SUCCESS
+ 1
+ 2
+ 3
+ 4
+ 5
+SUCCESS
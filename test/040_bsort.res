@@ -0,0 +1,22 @@
+SORT SUCCEEDED
+ 2              3              5              5              8
+ 11             11             12             13             13
+ 14             15             15             19             21
+ 21             22             23             24             24
+ 25             26             26             26             26
+ 27             27             29             29             29
+ 29             30             32             34             35
+ 35             36             36             37             39
+ 39             40             42             43             45
+ 46             49             50             51             54
+ 56             56             57             58             59
+ 60             62             62             62             63
+ 64             67             67             67             67
+ 68             68             69             70             70
+ 72             73             73             76             76
+ 77             78             80             81             82
+ 82             83             84             84             84
+ 86             86             86             87             88
+ 90             91             92             93             93
+ 94             95             96             98             99
+
@@ -0,0 +1,10 @@
+FIB( 1 )= 1
+FIB( 2 )= 1
+FIB( 3 )= 2
+FIB( 4 )= 3
+FIB( 5 )= 5
+FIB( 6 )= 8
+FIB( 7 )= 13
+FIB( 8 )= 21
+FIB( 9 )= 34
+FIB( 10 )= 55
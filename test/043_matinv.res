@@ -0,0 +1,8 @@
+ORIGINAL 3 X 3 MATRIX
+ 1              2              3             
+ 4              5              6             
+ 7              8              9             
+TRANPOSED 3 X 3 MATRIX
+ 1              4              7             
+ 2              5              8             
+ 3              6              9             
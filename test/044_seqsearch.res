@@ -0,0 +1,102 @@
+ 21 FOUND IN SLOT 0
+ 85 FOUND IN SLOT 1
+ 80 FOUND IN SLOT 2
+ 14 FOUND IN SLOT 3
+ 60 FOUND IN SLOT 4
+ 76 FOUND IN SLOT 5
+ 87 FOUND IN SLOT 6
+ 49 FOUND IN SLOT 7
+ 78 FOUND IN SLOT 8
+ 81 FOUND IN SLOT 9
+ 96 FOUND IN SLOT 10
+ 25 FOUND IN SLOT 11
+ 17 FOUND IN SLOT 12
+ 22 FOUND IN SLOT 13
+ 13 FOUND IN SLOT 14
+ 91 FOUND IN SLOT 15
+ 23 FOUND IN SLOT 16
+ 62 FOUND IN SLOT 17
+ 5 FOUND IN SLOT 18
+ 57 FOUND IN SLOT 19
+ALL POSITIVE TESTS SUCCESSFUL!
+ 1 NOT FOUND IN ANY SLOT
+ 2 NOT FOUND IN ANY SLOT
+ 3 NOT FOUND IN ANY SLOT
+ 4 NOT FOUND IN ANY SLOT
+ 6 NOT FOUND IN ANY SLOT
+ 7 NOT FOUND IN ANY SLOT
+ 8 NOT FOUND IN ANY SLOT
+ 9 NOT FOUND IN ANY SLOT
+ 10 NOT FOUND IN ANY SLOT
+ 11 NOT FOUND IN ANY SLOT
+ 12 NOT FOUND IN ANY SLOT
+ 15 NOT FOUND IN ANY SLOT
+ 16 NOT FOUND IN ANY SLOT
+ 18 NOT FOUND IN ANY SLOT
+ 19 NOT FOUND IN ANY SLOT
+ 20 NOT FOUND IN ANY SLOT
+ 24 NOT FOUND IN ANY SLOT
+ 26 NOT FOUND IN ANY SLOT
+ 27 NOT FOUND IN ANY SLOT
+ 28 NOT FOUND IN ANY SLOT
+ 29 NOT FOUND IN ANY SLOT
+ 30 NOT FOUND IN ANY SLOT
+ 31 NOT FOUND IN ANY SLOT
+ 32 NOT FOUND IN ANY SLOT
+ 33 NOT FOUND IN ANY SLOT
+ 34 NOT FOUND IN ANY SLOT
+ 35 NOT FOUND IN ANY SLOT
+ 36 NOT FOUND IN ANY SLOT
+ 37 NOT FOUND IN ANY SLOT
+ 38 NOT FOUND IN ANY SLOT
+ 39 NOT FOUND IN ANY SLOT
+ 40 NOT FOUND IN ANY SLOT
+ 41 NOT FOUND IN ANY SLOT
+ 42 NOT FOUND IN ANY SLOT
+ 43 NOT FOUND IN ANY SLOT
+ 44 NOT FOUND IN ANY SLOT
+ 45 NOT FOUND IN ANY SLOT
+ 46 NOT FOUND IN ANY SLOT
+ 47 NOT FOUND IN ANY SLOT
+ 48 NOT FOUND IN ANY SLOT
+ 50 NOT FOUND IN ANY SLOT
+ 51 NOT FOUND IN ANY SLOT
+ 52 NOT FOUND IN ANY SLOT
+ 53 NOT FOUND IN ANY SLOT
+ 54 NOT FOUND IN ANY SLOT
+ 55 NOT FOUND IN ANY SLOT
+ 56 NOT FOUND IN ANY SLOT
+ 58 NOT FOUND IN ANY SLOT
+ 59 NOT FOUND IN ANY SLOT
+ 61 NOT FOUND IN ANY SLOT
+ 63 NOT FOUND IN ANY SLOT
+ 64 NOT FOUND IN ANY SLOT
+ 65 NOT FOUND IN ANY SLOT
+ 66 NOT FOUND IN ANY SLOT
+ 67 NOT FOUND IN ANY SLOT
+ 68 NOT FOUND IN ANY SLOT
+ 69 NOT FOUND IN ANY SLOT
+ 70 NOT FOUND IN ANY SLOT
+ 71 NOT FOUND IN ANY SLOT
+ 72 NOT FOUND IN ANY SLOT
+ 73 NOT FOUND IN ANY SLOT
+ 74 NOT FOUND IN ANY SLOT
+ 75 NOT FOUND IN ANY SLOT
+ 77 NOT FOUND IN ANY SLOT
+ 79 NOT FOUND IN ANY SLOT
+ 82 NOT FOUND IN ANY SLOT
+ 83 NOT FOUND IN ANY SLOT
+ 84 NOT FOUND IN ANY SLOT
+ 86 NOT FOUND IN ANY SLOT
+ 88 NOT FOUND IN ANY SLOT
+ 89 NOT FOUND IN ANY SLOT
+ 90 NOT FOUND IN ANY SLOT
+ 92 NOT FOUND IN ANY SLOT
+ 93 NOT FOUND IN ANY SLOT
+ 94 NOT FOUND IN ANY SLOT
+ 95 NOT FOUND IN ANY SLOT
+ 97 NOT FOUND IN ANY SLOT
+ 98 NOT FOUND IN ANY SLOT
+ 99 NOT FOUND IN ANY SLOT
+ 100 NOT FOUND IN ANY SLOT
+ALL NEGATIVE TESTS SUCCESSFUL!
@@ -0,0 +1,122 @@
+( 8 , 6 , 7 , 5 , 3 , 0 , 9 )
+ 8 FOUND IN SLOT 0 --> 8
+ 6 FOUND IN SLOT 1 --> 6
+ 7 FOUND IN SLOT 2 --> 7
+ 5 FOUND IN SLOT 3 --> 5
+ 3 FOUND IN SLOT 4 --> 3
+ 0 FOUND IN SLOT 5 --> 0
+ 9 FOUND IN SLOT 6 --> 9
+ 1 NOT FOUND AS EXPECTED
+ 2 NOT FOUND AS EXPECTED
+ 4 NOT FOUND AS EXPECTED
+ 10 NOT FOUND AS EXPECTED
+( 6 , 7 , 5 , 3 , 0 , 9 )
+( 6 , 7 , 5 , 3 , 0 )
+( 6 , 7 , 3 , 0 )
+( 6 , 7 , 3 , 0 , 99 )
+( 7 , 3 , 0 , 99 )
+( 3 , 0 , 99 )
+( 0 , 99 )
+( 99 )
+()
+F1= 3          H1=-1          T1=-1
+A( 0 ,0)= 8    A( 0 ,1)= 7
+A( 1 ,0)= 6    A( 1 ,1)= 6
+A( 2 ,0)= 7    A( 2 ,1)= 1
+A( 3 ,0)= 99   A( 3 ,1)= 5
+A( 4 ,0)= 3    A( 4 ,1)= 2
+A( 5 ,0)= 0    A( 5 ,1)= 4
+A( 6 ,0)= 9    A( 6 ,1)= 0
+A( 7 ,0)= 0    A( 7 ,1)= 8
+A( 8 ,0)= 0    A( 8 ,1)= 9
+A( 9 ,0)= 0    A( 9 ,1)= 10
+A( 10 ,0)= 0   A( 10 ,1)= 11
+A( 11 ,0)= 0   A( 11 ,1)= 12
+A( 12 ,0)= 0   A( 12 ,1)= 13
+A( 13 ,0)= 0   A( 13 ,1)= 14
+A( 14 ,0)= 0   A( 14 ,1)= 15
+A( 15 ,0)= 0   A( 15 ,1)= 16
+A( 16 ,0)= 0   A( 16 ,1)= 17
+A( 17 ,0)= 0   A( 17 ,1)= 18
+A( 18 ,0)= 0   A( 18 ,1)= 19
+A( 19 ,0)= 0   A( 19 ,1)= 20
+A( 20 ,0)= 0   A( 20 ,1)= 21
+A( 21 ,0)= 0   A( 21 ,1)= 22
+A( 22 ,0)= 0   A( 22 ,1)= 23
+A( 23 ,0)= 0   A( 23 ,1)= 24
+A( 24 ,0)= 0   A( 24 ,1)= 25
+A( 25 ,0)= 0   A( 25 ,1)= 26
+A( 26 ,0)= 0   A( 26 ,1)= 27
+A( 27 ,0)= 0   A( 27 ,1)= 28
+A( 28 ,0)= 0   A( 28 ,1)= 29
+A( 29 ,0)= 0   A( 29 ,1)= 30
+A( 30 ,0)= 0   A( 30 ,1)= 31
+A( 31 ,0)= 0   A( 31 ,1)= 32
+A( 32 ,0)= 0   A( 32 ,1)= 33
+A( 33 ,0)= 0   A( 33 ,1)= 34
+A( 34 ,0)= 0   A( 34 ,1)= 35
+A( 35 ,0)= 0   A( 35 ,1)= 36
+A( 36 ,0)= 0   A( 36 ,1)= 37
+A( 37 ,0)= 0   A( 37 ,1)= 38
+A( 38 ,0)= 0   A( 38 ,1)= 39
+A( 39 ,0)= 0   A( 39 ,1)= 40
+A( 40 ,0)= 0   A( 40 ,1)= 41
+A( 41 ,0)= 0   A( 41 ,1)= 42
+A( 42 ,0)= 0   A( 42 ,1)= 43
+A( 43 ,0)= 0   A( 43 ,1)= 44
+A( 44 ,0)= 0   A( 44 ,1)= 45
+A( 45 ,0)= 0   A( 45 ,1)= 46
+A( 46 ,0)= 0   A( 46 ,1)= 47
+A( 47 ,0)= 0   A( 47 ,1)= 48
+A( 48 ,0)= 0   A( 48 ,1)= 49
+A( 49 ,0)= 0   A( 49 ,1)= 50
+A( 50 ,0)= 0   A( 50 ,1)= 51
+A( 51 ,0)= 0   A( 51 ,1)= 52
+A( 52 ,0)= 0   A( 52 ,1)= 53
+A( 53 ,0)= 0   A( 53 ,1)= 54
+A( 54 ,0)= 0   A( 54 ,1)= 55
+A( 55 ,0)= 0   A( 55 ,1)= 56
+A( 56 ,0)= 0   A( 56 ,1)= 57
+A( 57 ,0)= 0   A( 57 ,1)= 58
+A( 58 ,0)= 0   A( 58 ,1)= 59
+A( 59 ,0)= 0   A( 59 ,1)= 60
+A( 60 ,0)= 0   A( 60 ,1)= 61
+A( 61 ,0)= 0   A( 61 ,1)= 62
+A( 62 ,0)= 0   A( 62 ,1)= 63
+A( 63 ,0)= 0   A( 63 ,1)= 64
+A( 64 ,0)= 0   A( 64 ,1)= 65
+A( 65 ,0)= 0   A( 65 ,1)= 66
+A( 66 ,0)= 0   A( 66 ,1)= 67
+A( 67 ,0)= 0   A( 67 ,1)= 68
+A( 68 ,0)= 0   A( 68 ,1)= 69
+A( 69 ,0)= 0   A( 69 ,1)= 70
+A( 70 ,0)= 0   A( 70 ,1)= 71
+A( 71 ,0)= 0   A( 71 ,1)= 72
+A( 72 ,0)= 0   A( 72 ,1)= 73
+A( 73 ,0)= 0   A( 73 ,1)= 74
+A( 74 ,0)= 0   A( 74 ,1)= 75
+A( 75 ,0)= 0   A( 75 ,1)= 76
+A( 76 ,0)= 0   A( 76 ,1)= 77
+A( 77 ,0)= 0   A( 77 ,1)= 78
+A( 78 ,0)= 0   A( 78 ,1)= 79
+A( 79 ,0)= 0   A( 79 ,1)= 80
+A( 80 ,0)= 0   A( 80 ,1)= 81
+A( 81 ,0)= 0   A( 81 ,1)= 82
+A( 82 ,0)= 0   A( 82 ,1)= 83
+A( 83 ,0)= 0   A( 83 ,1)= 84
+A( 84 ,0)= 0   A( 84 ,1)= 85
+A( 85 ,0)= 0   A( 85 ,1)= 86
+A( 86 ,0)= 0   A( 86 ,1)= 87
+A( 87 ,0)= 0   A( 87 ,1)= 88
+A( 88 ,0)= 0   A( 88 ,1)= 89
+A( 89 ,0)= 0   A( 89 ,1)= 90
+A( 90 ,0)= 0   A( 90 ,1)= 91
+A( 91 ,0)= 0   A( 91 ,1)= 92
+A( 92 ,0)= 0   A( 92 ,1)= 93
+A( 93 ,0)= 0   A( 93 ,1)= 94
+A( 94 ,0)= 0   A( 94 ,1)= 95
+A( 95 ,0)= 0   A( 95 ,1)= 96
+A( 96 ,0)= 0   A( 96 ,1)= 97
+A( 97 ,0)= 0   A( 97 ,1)= 98
+A( 98 ,0)= 0   A( 98 ,1)= 99
+A( 99 ,0)= 0   A( 99 ,1)=-1
@@ -0,0 +1,5 @@
+ X              Y              X XOR Y        X = Y
+ 0              0              0              1
+ 0              1              1              0
+ 1              0              1              0
+ 1              1              0              1
@@ -0,0 +1,6 @@
+10 PRINT (5)*2
+20 PRINT (5)
+30 X=(7)
+40 PRINT X
+50 PRINT 2*(3)+1
+60 PRINT ((2+3))
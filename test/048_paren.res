@@ -0,0 +1,5 @@
+ 10
+ 5
+ 7
+ 7
+ 5
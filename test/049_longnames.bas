@@ -0,0 +1,11 @@
+10 DIM ELEMENTS_TO_BE_SORTED(20)
+20 FOR POSITION_IN_ARRAY = 1 TO 20
+30 ELEMENTS_TO_BE_SORTED(POSITION_IN_ARRAY) = 21 - POSITION_IN_ARRAY
+40 NEXT POSITION_IN_ARRAY
+50 SUM_OF_ALL_ELEMENTS = 0
+60 FOR POSITION_IN_ARRAY = 1 TO 20
+70 SUM_OF_ALL_ELEMENTS = SUM_OF_ALL_ELEMENTS + ELEMENTS_TO_BE_SORTED(POSITION_IN_ARRAY)
+80 NEXT POSITION_IN_ARRAY
+90 PRINT "SUM"; SUM_OF_ALL_ELEMENTS
+100 DEF FN_TWICE(VALUE_OF_ARGUMENT) = VALUE_OF_ARGUMENT * 2
+110 PRINT FN_TWICE(SUM_OF_ALL_ELEMENTS)
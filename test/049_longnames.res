@@ -0,0 +1,2 @@
+SUM 210
+ 420
@@ -0,0 +1,21 @@
+10 FOR I = 0 TO 3
+20 ON I GOSUB 200, 300, 400
+30 ON I GOTO 40, 50 : PRINT "NONE"; I : GOTO 60
+40 PRINT "FORTY"; I : GOTO 60
+50 PRINT "FIFTY"; I
+60 GOSUB 500 + 10 * I
+70 IF I = 2 THEN 95 : PRINT "NEVER"
+80 PRINT "NOT TWO"; I
+90 GOTO 100
+95 PRINT "TWO"
+100 NEXT I
+110 GOTO 1000
+200 PRINT "ONE" : RETURN
+300 PRINT "TWO" : RETURN
+400 PRINT "THREE" : RETURN
+500 PRINT "500" : RETURN
+515 PRINT "515" : RETURN
+520 PRINT "520" : RETURN
+535 PRINT "535" : RETURN
+999 PRINT "FAILED"
+1000 END
@@ -0,0 +1,15 @@
+NONE 0
+500
+NOT TWO 0
+ONE
+FORTY 1
+515
+NOT TWO 1
+TWO
+FIFTY 2
+520
+TWO
+THREE
+NONE 3
+535
+NOT TWO 3
@@ -0,0 +1,16 @@
+10 FOR I = 1 TO 3
+20 FOR J = I TO 2
+30 PRINT I; J;
+40 NEXT J
+50 PRINT
+60 NEXT I
+70 FOR K = 1 TO 20
+80 FOR L = 1 TO 5
+90 IF L = 2 THEN 110
+100 NEXT L
+110 NEXT K
+120 PRINT "K"; K; "L"; L
+130 FOR M = 5 TO 1 : PRINT "NEVER" : NEXT M
+140 PRINT "M"; M
+150 FOR N = 1 TO 0
+160 PRINT "NOT REACHED"
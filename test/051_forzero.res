@@ -0,0 +1,5 @@
+ 1  1  1  2 
+ 2  2 
+
+K 6 L 2
+M 6
@@ -0,0 +1,12 @@
+10 DEF AREA(W, H) = W * H
+20 DEF VOLUME(W, H, D) = AREA(W, H) * D
+30 DEF CLAMP(V, LO, HI) = MIN(MAX(V, LO), HI)
+40 DEF GREET$(N$) = "HELLO " + N$
+50 W = 100
+60 PRINT AREA(3, 4); VOLUME(2, 3, 4); W
+70 FOR I = -2 TO 12 STEP 7
+80 PRINT CLAMP(I, 0, 10);
+90 NEXT I
+100 PRINT
+110 PRINT GREET$("WORLD")
+120 PRINT AREA(5)
@@ -0,0 +1,4 @@
+ 12  24  100
+ 0  5  10 
+HELLO WORLD
+ 0
@@ -0,0 +1,9 @@
+10 A$ = "CONSTANT"
+20 B$ = A$ : A$ = "OTHER"
+30 PRINT A$; " "; B$
+40 PRINT ((((((((((((((1+2)*2)+1)*2)+1)*2)+1)*2)+1)*2)+1)*2)+1)*2)
+50 PRINT 1+(2+(3+(4+(5+(6+(7+(8+(9+(10+(11+(12+(13+(14+(15+(16)))))))))))))))
+60 PRINT -(-(-(-(-(-(-(-(-(-(-(-(1))))))))))))
+65 C$ = ""
+70 FOR I = 1 TO 3 : C$ = C$ + "AB" : NEXT I
+80 PRINT C$
@@ -0,0 +1,5 @@
+OTHER CONSTANT
+ 510
+ 136
+ 1
+ABABAB
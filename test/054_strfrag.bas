@@ -0,0 +1,17 @@
+10 REM many strings of different length are allocated and freed
+20 A$ = "" : B$ = "" : C$ = "" : D$ = "" : E$ = "" : F$ = "" : G$ = "" : H$ = ""
+30 R = 7
+40 FOR I = 1 TO 3000
+50 R = (R * 109 + 89) AND 1023
+60 L = R AND 63
+70 ON (R AND 7) + 1 GOSUB 100, 110, 120, 130, 140, 150, 160, 170
+80 NEXT I
+90 PRINT LEN(A$); LEN(B$); LEN(C$); LEN(D$); LEN(E$); LEN(F$); LEN(G$); LEN(H$) : END
+100 A$ = LEFT$(STRING$(L, 65) + B$, 90) : RETURN
+110 B$ = MID$(C$ + STRING$(L, 66), 3) : RETURN
+120 C$ = RIGHT$(D$ + STRING$(L, 67) + A$, 120) : RETURN
+130 D$ = STRING$(L, 68) : RETURN
+140 E$ = LEFT$(E$ + F$ + STRING$(L, 69), 200) : RETURN
+150 F$ = MID$(G$, 2, L) + STRING$(L / 2, 70) : RETURN
+160 G$ = RIGHT$(H$ + A$ + STRING$(L, 71), 150) : RETURN
+170 H$ = STRING$(L, 72) + LEFT$(E$, L) : RETURN
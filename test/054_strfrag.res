@@ -0,0 +1 @@
+ 90  159  120  51  200  67  150  30
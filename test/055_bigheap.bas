@@ -0,0 +1,20 @@
+REM arrays and strings larger than 32 KB
+DIM A(100,100)
+FOR I = 0 TO 100
+FOR J = 0 TO 100
+LET A(I,J) = I*J
+NEXT J
+NEXT I
+LET S = 0
+FOR I = 0 TO 100
+LET S = S + A(I,I)
+NEXT I
+PRINT A(100,100), A(37,59), S
+DIM B(20000)
+LET B(20000) = 7
+PRINT B(20000), B(19999)
+LET S$ = "AB"
+FOR I = 1 TO 15
+LET S$ = S$ + S$
+NEXT I
+PRINT LEN(S$), MID$(S$, 65535, 2)
@@ -0,0 +1,3 @@
+ 10000          2183           338350
+ 7              0
+ 65536         AB
@@ -0,0 +1,11 @@
+10 REM number formatting and output in blocks
+20 LET A = -2147483647 - 1
+30 PRINT A; 2147483647; 0; -1; 7
+40 PRINT STR$(A); STR$(0); STR$(-5); STR$(123456789)
+50 PRINT "A", "B", -10, 10
+60 PRINT TAB(3); 5; TAB(20); -5
+70 FOR I = 1 TO 400
+80 PRINT I;
+90 IF I - 20 * (I / 20) = 0 THEN PRINT
+100 NEXT I
+110 PRINT "END   "
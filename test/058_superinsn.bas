@@ -0,0 +1,17 @@
+10 REM superinstructions and their generic fallback
+15 X = X + 1
+20 X = X + 1 : Y = Y - 3
+30 PRINT X; Y
+40 A$ = "AB"
+60 IF Z < 1 THEN PRINT "Z0"
+70 IF A$ = 1 THEN PRINT "BAD"
+80 B(3) = 7 : B(4) = B(3) * 2
+90 PRINT B(3); B(4)
+100 C$(2) = "S"
+110 IF X <> 2 THEN 200
+120 IF X >= 2 THEN PRINT "GE" : IF Y <= -3 THEN PRINT "LE"
+130 FOR I = 1 TO 5 : S = S + I : NEXT I
+140 PRINT S; I
+150 Y = Y - -2147483647 - 1
+160 PRINT Y
+200 END
@@ -0,0 +1,9 @@
+ 2 -3
+Z0
+ERROR:70: syntax error (6)
+    IF A$=1 THEN PRINT "BAD"
+ 7  14
+GE
+LE
+ 15  6
+ 2147483643
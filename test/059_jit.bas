@@ -0,0 +1,42 @@
+10 REM hot loops which run as machine code
+20 DIM A(200), M(20,20)
+30 FOR I = 0 TO 200 : A(I) = (I * 37) - (I * 37 / 101) * 101 : NEXT I
+40 S = 0
+50 FOR I = 200 TO 0 STEP -1
+60 IF A(I) > 50 THEN 80
+70 S = S + A(I) * 2 - 1
+80 NEXT I
+90 PRINT S; I
+100 FOR I = 0 TO 20 : FOR J = 0 TO 20
+110 M(I,J) = I * 100 + J
+120 NEXT J : NEXT I
+130 T = 0
+140 FOR K = 1 TO 300 STEP 3
+150 T = T + M(K / 15, K - (K / 21) * 21) + (K < 150) - (K >= 200) + (K = 100 OR K = 103)
+160 T = T + (NOT K AND 7) + -K / 7
+170 NEXT K
+180 PRINT T; K
+190 REM leave the loop and come back
+200 C = 0
+210 FOR I = 1 TO 1000
+220 IF I = 500 THEN 400
+230 C = C + 1
+240 NEXT I
+250 PRINT C; I
+260 REM the variable is not assigned before the loop is hot
+270 FOR I = 1 TO 100
+280 IF I < 80 THEN 300
+290 L = L + I
+300 NEXT I
+310 PRINT L
+320 GOSUB 500
+330 STOP
+400 C = C + 1000 : GOTO 240
+500 REM option base 1 and a loop which is entered again
+510 OPTION BASE 1
+520 DIM B(100)
+530 FOR R = 1 TO 3
+540 FOR I = 1 TO 100 : B(I) = B(I) + I * R : NEXT I
+550 NEXT R
+560 PRINT B(1); B(50); B(100)
+570 RETURN
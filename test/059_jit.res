@@ -0,0 +1,5 @@
+ 4998 -1
+ 94223  301
+ 1999  1001
+ 1890
+ 6  300  600
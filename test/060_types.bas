@@ -0,0 +1,17 @@
+10 REM variables which only hold numbers share the program with strings
+20 DEF TWICE(X) = X + X
+30 DEF NAME$(N) = "N" + CHR$(48 + N)
+40 A = 1 : B = 2
+50 PRINT TWICE(A); TWICE("AB"); NAME$(A)
+60 C = A + B * 3 - -B
+70 PRINT C; NOT C; C / 2; C ^ 2; C - B
+80 IF C > 5 THEN V = "BIG"
+90 PRINT V; V + "GER"
+100 V = 7 : PRINT V + 1
+110 READ R, S
+120 PRINT R; S; R * 2
+130 U = U + 1 : PRINT U
+140 FOR I = 1 TO 3 : T = T + I * I : NEXT I
+150 PRINT T; T = 14; T <> 14; T AND 6; T OR 1; T < 20; T >= 15
+160 DIM Z(3) : Z(1) = T : Z(2) = Z(1) * -2 : PRINT Z(1) + Z(2)
+170 DATA 5, "FIVE"
@@ -0,0 +1,8 @@
+ 2 ABABN1
+ 9 -10  4  81  7
+BIGBIGGER
+ 8
+ 5 FIVE 10
+ 1
+ 14 -1  0  6  15 -1  0
+-14
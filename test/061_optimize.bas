@@ -0,0 +1,28 @@
+10 REM the optimizer must not change what a program does
+20 N = 10 : W = 4 : S = 2 ^ 31 - 1
+30 DIM A(N * W), B(N)
+40 PRINT S; (N - 1) * W; -(3 + 4) * 2; 7 / 2; 2 ^ 40
+50 GOTO 70
+60 PRINT "NOT REACHED"
+70 FOR I = 0 TO N - 1
+80 A(I * W + 1) = I * W + (N + W) * 2 : B(I) = N * W - I
+90 NEXT I
+100 FOR I = 0 TO N - 1 STEP 3 : PRINT A(I * W + 1); B(I); : NEXT I
+110 PRINT
+120 FOR I = 1 TO 3
+130 FOR J = I TO 3 : T = T + I * 10 + J * (W - 1) : NEXT J
+140 NEXT I
+150 PRINT T
+160 FOR K = 5 TO 1 STEP -2 : PRINT K * 3 - 1; 2 - K; : NEXT K
+170 PRINT
+180 FOR I = 1 TO 100 : IF I * W > 20 THEN 200
+190 NEXT I
+200 PRINT I; I * W
+210 X = 1
+220 FOR I = 1 TO 3 : PRINT X * 5; : X = X + 1 : NEXT I
+230 PRINT
+240 Y = 6 : GOSUB 300 : PRINT Y * 2
+250 FOR I = 1 TO 0 : PRINT "NEVER"; W / 0 : NEXT I
+260 PRINT I
+270 END
+300 Y = Y + 1 : RETURN
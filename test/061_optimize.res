@@ -0,0 +1,8 @@
+ 2147483647  36 -14  3  0
+ 28  40  40  37  52  34  64  31 
+ 142
+ 14 -3  8 -1  2  1 
+ 6  24
+ 5  10  15 
+ 14
+ 2
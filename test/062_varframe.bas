@@ -0,0 +1,9 @@
+10 REM numeric variables live in one frame, strings and arrays in own blocks
+20 X = 5 : Y = 7 : Z = X * Y
+30 X = "HELLO" : PRINT X; Y; Z
+40 X = 3 : PRINT X + Y
+50 READ X : PRINT X
+60 READ X : PRINT X + 1
+70 DIM Y(4) : Y(2) = 9 : PRINT Y(2); Z
+80 FOR I = 1 TO 3 : S = S + I : NEXT I : PRINT S; I
+90 DATA "STR", 41
@@ -0,0 +1,6 @@
+HELLO 7  35
+ 10
+STR
+ 42
+ 9  35
+ 6  4
@@ -0,0 +1,13 @@
+10 REM strings know their length, X = X + value grows X in place
+20 A$ = "" : FOR I = 1 TO 200 : A$ = A$ + CHR$(65 + I - (I / 26) * 26) : NEXT I
+30 PRINT LEN(A$); LEFT$(A$, 5); RIGHT$(A$, 5); MID$(A$, 100, 4)
+40 B$ = A$ : A$ = A$ + "!" : PRINT LEN(A$); LEN(B$); RIGHT$(A$, 2); RIGHT$(B$, 2)
+50 C$ = "AB" : FOR I = 1 TO 5 : C$ = C$ + C$ : NEXT I : PRINT LEN(C$); MID$(C$, 60)
+60 D$ = "X" : D$ = D$ + STR$(42) + "-" + STRING$(3, "Y") : PRINT D$; LEN(D$)
+70 N = 1 : FOR I = 1 TO 4 : N = N + I : NEXT I : PRINT N
+80 READ E$ : E$ = E$ + E$ : PRINT E$; LEN(E$)
+90 F$ = "Q" : F$ = F$ + LEFT$(F$ + "RS", 2) : X = F$ = "QQR" : PRINT F$; X
+100 PRINT MID$("HELLO", 0, 2); MID$("HELLO", 9); LEFT$("", 3); LEN(""); LEN(CHR$(0) + "A")
+110 G = 5 : G = G + 1 + G : PRINT G
+120 H$ = "AB" : H$ = H$ + 1
+130 DATA "DATA"
@@ -0,0 +1,11 @@
+ 200 BCDEFOPQRSWXYZ
+ 201  200 S!RS
+ 64 BABAB
+X 42 -YYY 9
+ 11
+DATADATA 8
+QQR 1
+HE 0  1
+ 11
+ERROR:120: syntax error (6)
+    H$=H$+1
@@ -0,0 +1,15 @@
+10 REM substrings show a part of their string, assignment shares strings
+20 R$ = "SMITH,JOHN,1234 MAIN STREET,SPRINGFIELD"
+30 P = 1 : FOR I = 1 TO LEN(R$) + 1
+40 IF I <= LEN(R$) THEN IF MID$(R$, I, 1) <> "," THEN 70
+50 F$ = MID$(R$, P, I - P) : PRINT LEN(F$); F$
+60 P = I + 1
+70 NEXT I
+80 A$ = MID$(R$, 12, 16) : B$ = A$ : A$ = A$ + "!" : PRINT A$ : PRINT B$
+90 C$ = MID$(B$, 6, 11) : B$ = "GONE" : R$ = "" : PRINT C$; LEN(C$); ASC(C$); B$
+100 D$ = LEFT$(C$, 11) + RIGHT$(C$, 10) : PRINT D$
+110 E$ = C$ : X = E$ = "MAIN STREET" : Y = MID$(D$, 12, 10) = "AIN STREET" : PRINT X; Y
+120 DEF FNA(S$) = LEN(S$ + S$)
+130 PRINT FNA(C$); FNA(MID$(C$, 2, 9)); FNA("AB")
+140 G$ = "CONST" : H$ = G$ : G$ = G$ + "ANT" : PRINT G$; H$
+150 PRINT MID$(MID$(MID$("ABCDEFGHIJKLMNOPQRSTUVWXYZ", 2, 20), 3, 15), 4, 9)
@@ -0,0 +1,12 @@
+ 5 SMITH
+ 4 JOHN
+ 16 1234 MAIN STREET
+ 11 SPRINGFIELD
+1234 MAIN STREET!
+1234 MAIN STREET
+MAIN STREET 11  77 GONE
+MAIN STREETAIN STREET
+ 1  1
+ 22  18  4
+CONSTANTCONST
+GHIJKLMNO
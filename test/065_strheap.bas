@@ -0,0 +1,33 @@
+10 REM strings stay intact while the string heap is compacted and grows
+20 DEF FNW$(S$, N) = LEFT$(S$ + STRING$(N, "."), N) + "|"
+30 A$ = "" : B$ = "" : C$ = "" : K$ = "KEEP" : L$ = ""
+40 R = 11
+50 FOR I = 1 TO 3000
+60 R = (R * 109 + 89) AND 1023
+70 T$ = STRING$((R AND 31) + 1, 65 + (I AND 15))
+80 A$ = MID$(T$ + B$, 2, 40)
+90 B$ = RIGHT$(C$ + T$, 60)
+100 C$ = T$ + LEFT$(A$, 10)
+110 IF (I AND 255) = 0 THEN K$ = K$ + CHR$(48 + I / 256)
+120 IF I > 2900 THEN L$ = L$ + FNW$(T$, 7)
+130 NEXT I
+140 PRINT LEN(A$); LEN(B$); LEN(C$)
+150 PRINT A$
+160 PRINT B$
+170 PRINT C$
+180 PRINT K$
+190 PRINT LEN(L$); LEFT$(L$, 48)
+200 REM temporaries of one expression live through several compactions
+210 X$ = STRING$(200, "X")
+220 Y$ = LEFT$(X$ + "1", 190) + MID$(X$ + "2", 5, 190) + RIGHT$("3" + X$, 190) + FNW$(X$, 150) + STRING$(100, "Z")
+230 PRINT LEN(Y$); MID$(Y$, 185, 12); RIGHT$(Y$, 3)
+240 REM a long string grows in a block of its own
+250 Z$ = ""
+260 FOR I = 1 TO 100
+270 Z$ = Z$ + STR$(I)
+280 D$ = STRING$(I, "D")
+290 NEXT I
+300 PRINT LEN(Z$); LEFT$(Z$, 20); RIGHT$(Z$, 12); LEN(D$)
+310 W$ = Z$
+320 Z$ = Z$ + "END"
+330 PRINT LEN(W$); LEN(Z$); RIGHT$(W$, 4); RIGHT$(Z$, 6)
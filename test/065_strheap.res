@@ -0,0 +1,9 @@
+ 40  33  30
+IIIIIIIIIIIIIIIIIIIGGGGGGGGGGGGGGGGGGGGG
+HHHHHFFFFFFFFIIIIIIIIIIIIIIIIIIII
+IIIIIIIIIIIIIIIIIIIIIIIIIIIIII
+KEEP123456789:;
+ 800 FFFFF..|GGGGGGG|HHH....|IIIIIII|JJJJJJJ|KKKKKKK|
+ 821 XXXXXXXXXXXXZZZ
+ 392  1  2  3  4  5  6  798  99  100  100
+ 392  395 100 00 END
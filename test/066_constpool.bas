@@ -0,0 +1,33 @@
+10 REM strings of DATA and literals are shared constants of the program
+20 DEF FNJ$(FIRSTPART$, SECONDPART$) = FIRSTPART$ + "-" + SECONDPART$
+30 DEF FNK(COUNTER, FACTOR) = COUNTER * FACTOR + 1
+40 FOR PASS = 1 TO 3
+50 RESTORE
+60 FOR I = 1 TO 4
+70 READ NAME$, AMOUNT
+80 PRINT PASS; I; NAME$; AMOUNT; LEN(NAME$); FNK(PASS, AMOUNT)
+90 NEXT I
+100 NEXT PASS
+110 RESTORE
+120 READ FIRST$, X, SECOND$
+130 KEEP$ = FIRST$
+140 FIRST$ = FIRST$ + "PLUS"
+150 SECOND$ = SECOND$ + SECOND$
+160 PRINT FIRST$; " "; KEEP$; " "; SECOND$
+170 RESTORE
+180 READ FIRST$, X, THIRD$
+190 PRINT FIRST$; " "; THIRD$; " "; FNJ$(FIRST$, THIRD$)
+200 ALL$ = ""
+210 RESTORE
+220 FOR I = 1 TO 4
+230 READ WORD$, X
+240 ALL$ = ALL$ + WORD$ + ","
+250 WORD$ = WORD$ + "?"
+260 PRINT WORD$; " ";
+270 NEXT I
+280 PRINT ALL$
+300 LONGVARIABLENAMENUMBERONE = 1 : LONGVARIABLENAMENUMBERTWO = 2
+310 LONGVARIABLENAMENUMBERTHREE$ = "THREE" : LONGVARIABLENAMENUMBERFOUR = 4
+320 PRINT LONGVARIABLENAMENUMBERONE + LONGVARIABLENAMENUMBERTWO; LONGVARIABLENAMENUMBERTHREE$; LONGVARIABLENAMENUMBERFOUR
+330 PRINT FNJ$("APPLE", "PEAR"); FNK(2, 3)
+340 DATA APPLE, 1, "PEAR", -200, "APPLE", 70000, "", 3
@@ -0,0 +1,17 @@
+ 1  1 APPLE 1  5  2
+ 1  2 PEAR-200  4 -199
+ 1  3 APPLE 70000  5  70001
+ 1  4  3  0  4
+ 2  1 APPLE 1  5  3
+ 2  2 PEAR-200  4 -399
+ 2  3 APPLE 70000  5  140001
+ 2  4  3  0  7
+ 3  1 APPLE 1  5  4
+ 3  2 PEAR-200  4 -599
+ 3  3 APPLE 70000  5  210001
+ 3  4  3  0  10
+APPLEPLUS APPLE PEARPEAR
+APPLE PEAR APPLE-PEAR
+APPLE? PEAR? APPLE? ? APPLE,PEAR,APPLE,,
+ 3 THREE 4
+APPLE-PEAR 7
@@ -0,0 +1,61 @@
+REM many variables with similar names fill the symbol table
+A0=10:A1=11:A2=12:A3=13:A4=14:A5=15:A6=16:A7=17:A8=18:A9=19
+B0=20:B1=21:B2=22:B3=23:B4=24:B5=25:B6=26:B7=27:B8=28:B9=29
+C0=30:C1=31:C2=32:C3=33:C4=34:C5=35:C6=36:C7=37:C8=38:C9=39
+D0=40:D1=41:D2=42:D3=43:D4=44:D5=45:D6=46:D7=47:D8=48:D9=49
+E0=50:E1=51:E2=52:E3=53:E4=54:E5=55:E6=56:E7=57:E8=58:E9=59
+F0=60:F1=61:F2=62:F3=63:F4=64:F5=65:F6=66:F7=67:F8=68:F9=69
+G0=70:G1=71:G2=72:G3=73:G4=74:G5=75:G6=76:G7=77:G8=78:G9=79
+H0=80:H1=81:H2=82:H3=83:H4=84:H5=85:H6=86:H7=87:H8=88:H9=89
+I0=90:I1=91:I2=92:I3=93:I4=94:I5=95:I6=96:I7=97:I8=98:I9=99
+J0=100:J1=101:J2=102:J3=103:J4=104:J5=105:J6=106:J7=107:J8=108:J9=109
+K0=110:K1=111:K2=112:K3=113:K4=114:K5=115:K6=116:K7=117:K8=118:K9=119
+L0=120:L1=121:L2=122:L3=123:L4=124:L5=125:L6=126:L7=127:L8=128:L9=129
+M0=130:M1=131:M2=132:M3=133:M4=134:M5=135:M6=136:M7=137:M8=138:M9=139
+N0=140:N1=141:N2=142:N3=143:N4=144:N5=145:N6=146:N7=147:N8=148:N9=149
+O0=150:O1=151:O2=152:O3=153:O4=154:O5=155:O6=156:O7=157:O8=158:O9=159
+P0=160:P1=161:P2=162:P3=163:P4=164:P5=165:P6=166:P7=167:P8=168:P9=169
+Q0=170:Q1=171:Q2=172:Q3=173:Q4=174:Q5=175:Q6=176:Q7=177:Q8=178:Q9=179
+R0=180:R1=181:R2=182:R3=183:R4=184:R5=185:R6=186:R7=187:R8=188:R9=189
+S0=190:S1=191:S2=192:S3=193:S4=194:S5=195:S6=196:S7=197:S8=198:S9=199
+T0=200:T1=201:T2=202:T3=203:T4=204:T5=205:T6=206:T7=207:T8=208:T9=209
+U0=210:U1=211:U2=212:U3=213:U4=214:U5=215:U6=216:U7=217:U8=218:U9=219
+V0=220:V1=221:V2=222:V3=223:V4=224:V5=225:V6=226:V7=227:V8=228:V9=229
+W0=230:W1=231:W2=232:W3=233:W4=234:W5=235:W6=236:W7=237:W8=238:W9=239
+X0=240:X1=241:X2=242:X3=243:X4=244:X5=245:X6=246:X7=247:X8=248:X9=249
+Y0=250:Y1=251:Y2=252:Y3=253:Y4=254:Y5=255:Y6=256:Y7=257:Y8=258:Y9=259
+Z0=260:Z1=261:Z2=262:Z3=263:Z4=264:Z5=265:Z6=266:Z7=267:Z8=268:Z9=269
+S=0
+S=S+A0+A1+A2+A3+A4+A5+A6+A7+A8+A9
+S=S+B0+B1+B2+B3+B4+B5+B6+B7+B8+B9
+S=S+C0+C1+C2+C3+C4+C5+C6+C7+C8+C9
+S=S+D0+D1+D2+D3+D4+D5+D6+D7+D8+D9
+S=S+E0+E1+E2+E3+E4+E5+E6+E7+E8+E9
+S=S+F0+F1+F2+F3+F4+F5+F6+F7+F8+F9
+S=S+G0+G1+G2+G3+G4+G5+G6+G7+G8+G9
+S=S+H0+H1+H2+H3+H4+H5+H6+H7+H8+H9
+S=S+I0+I1+I2+I3+I4+I5+I6+I7+I8+I9
+S=S+J0+J1+J2+J3+J4+J5+J6+J7+J8+J9
+S=S+K0+K1+K2+K3+K4+K5+K6+K7+K8+K9
+S=S+L0+L1+L2+L3+L4+L5+L6+L7+L8+L9
+S=S+M0+M1+M2+M3+M4+M5+M6+M7+M8+M9
+S=S+N0+N1+N2+N3+N4+N5+N6+N7+N8+N9
+S=S+O0+O1+O2+O3+O4+O5+O6+O7+O8+O9
+S=S+P0+P1+P2+P3+P4+P5+P6+P7+P8+P9
+S=S+Q0+Q1+Q2+Q3+Q4+Q5+Q6+Q7+Q8+Q9
+S=S+R0+R1+R2+R3+R4+R5+R6+R7+R8+R9
+S=S+S0+S1+S2+S3+S4+S5+S6+S7+S8+S9
+S=S+T0+T1+T2+T3+T4+T5+T6+T7+T8+T9
+S=S+U0+U1+U2+U3+U4+U5+U6+U7+U8+U9
+S=S+V0+V1+V2+V3+V4+V5+V6+V7+V8+V9
+S=S+W0+W1+W2+W3+W4+W5+W6+W7+W8+W9
+S=S+X0+X1+X2+X3+X4+X5+X6+X7+X8+X9
+S=S+Y0+Y1+Y2+Y3+Y4+Y5+Y6+Y7+Y8+Y9
+S=S+Z0+Z1+Z2+Z3+Z4+Z5+Z6+Z7+Z8+Z9
+PRINT S
+PRINT A1;B0;Z9;M5
+REM names which start like keywords and builtins
+TOTAL=1:FORM=2:ONE=3:LENGTH=4:STEPS=5:ABSOLUTE=6:MINIMUM=7:PRINTED=8
+PRINT TOTAL+FORM+ONE+LENGTH+STEPS+ABSOLUTE+MINIMUM+PRINTED
+PRINT ABS(-3);LEN("ABC");MAX(A1,Z9)
+END
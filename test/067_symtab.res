@@ -0,0 +1,4 @@
+ 36270
+ 11  20  269  135
+ 36
+ 3  3  269
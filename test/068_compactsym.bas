@@ -0,0 +1,11 @@
+REM functions keep their code offset and parameter count in the symbol
+10 X = 7
+20 PRINT TWICE(X); SUM3(1, 2, 3); SUM3(4); X
+30 DEF TWICE(X) = X + X
+40 DEF SUM3(X, Y, Z) = X + Y + Z
+50 DEF HYP(A, B) = SUM3(A * A, B * B)
+60 DEF TAG$(A$, N) = LEFT$(A$, N) + STR$(LEN(A$))
+70 PRINT HYP(3, 4); TWICE(HYP(1, 1))
+80 PRINT TAG$("SYMBOL", 3)
+90 FOR I = 1 TO 3: PRINT ABS(I - 2) + TWICE(I); : NEXT I
+100 PRINT
@@ -0,0 +1,4 @@
+ 14  6  4  7
+ 25  4
+SYM 6
+ 3  4  7 
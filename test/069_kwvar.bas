@@ -0,0 +1,8 @@
+REM keywords cannot be variables, the lines are errors and nothing breaks
+10 PRINT "START"
+20 LET TO=3
+30 FOR STEP=1 TO 2
+40 READ PRINT
+50 DIM IF(3)
+60 NEXT THEN
+70 PRINT "END"
@@ -0,0 +1,12 @@
+ERROR:20: missing IDENTIFIER in instruction (1)
+    LET TO =3
+ERROR:30: missing IDENTIFIER in instruction (1)
+    FOR STEP =1 TO 2
+ERROR:40: missing IDENTIFIER in instruction (1)
+    READ PRINT
+ERROR:50: missing IDENTIFIER in instruction (1)
+    DIM IF (3)
+ERROR:60: missing IDENTIFIER in instruction (1)
+    NEXT THEN
+START
+END
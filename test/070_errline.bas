@@ -0,0 +1,19 @@
+REM a runtime error shows the line it happened in, the program goes on
+10 PRINT "READ"
+20 READ X
+30 PRINT "DIM"
+40 DIM B(-1)
+50 PRINT "OPTION"
+60 OPTION BASE 3
+70 PRINT "LET"
+80 DIM C(2,2)
+90 C(1,1) = "S"
+100 PRINT "LETARR1"
+110 DIM D(3)
+120 D(1) = "S"
+130 PRINT "APPEND"
+140 FOR I = 1 TO 2
+150 X = X + CHR$(64 + I)
+160 NEXT I
+170 Y = Y + "A"
+200 PRINT "END"
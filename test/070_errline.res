@@ -0,0 +1,23 @@
+READ
+ERROR:20: out of DATA in READ instruction (17)
+    READ X
+DIM
+ERROR:40: invalid dimension specified (13)
+    DIM B(-1)
+OPTION
+ERROR:60: invalid OPTION BASE (12)
+    OPTION BASE 3
+LET
+ERROR:90: wrong type in assignment (14)
+    C(1,1)="S"
+LETARR1
+ERROR:120: wrong type in assignment (14)
+    D(1)="S"
+APPEND
+ERROR:150: syntax error (6)
+    X=X+CHR$(64+I)
+ERROR:150: syntax error (6)
+    X=X+CHR$(64+I)
+ERROR:170: syntax error (6)
+    Y=Y+"A"
+END
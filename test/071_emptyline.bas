@@ -0,0 +1,10 @@
+REM a line with a label only is an empty instruction, a colon ends DATA
+10 GOTO 30
+20
+30 PRINT "30"
+40 PRINT "40"
+50 GOSUB 80
+60 DATA 1,2:PRINT "DATA"
+70 READ A,B: PRINT A;B: END
+80
+90 RETURN
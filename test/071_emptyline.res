@@ -0,0 +1,4 @@
+30
+40
+DATA
+ 1  2
@@ -0,0 +1,7 @@
+REM a broken line is reported and left out, NEXT without FOR is an error
+10 PRINT "A"
+20 PRINT (
+30 NEXT I
+40 FOR I=1 TO 2:PRINT I:NEXT I
+50 NEXT I
+60 PRINT "B"
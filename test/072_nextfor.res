@@ -0,0 +1,10 @@
+ERROR:20: syntax error (6)
+    PRINT (
+A
+ERROR:30: NEXT without FOR (18)
+    NEXT I
+ 1
+ 2
+ERROR:50: NEXT without FOR (18)
+    NEXT I
+B
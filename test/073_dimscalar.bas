@@ -0,0 +1,6 @@
+REM a variable keeps its number as element 0 when DIM makes it an array
+10 V=4
+20 DIM V(3)
+30 V(2)=9
+40 PRINT V;V(2)
+50 W=7:DIM W(2,2):PRINT W;W(0,0)
@@ -0,0 +1,2 @@
+ 4  9
+ 7  7
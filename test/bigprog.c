@@ -0,0 +1,80 @@
+// generates programs beyond the 16-bit limits of the compact heap: more than
+// 32767 code words and DATA strings behind the first 64 KB of the constant pool
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stdintw.h"
+#include "urubasic.h"
+
+struct Output {
+    char    text[256];
+    int     len;
+};
+
+static int collect(void *arg, const char *buf, int len)
+{
+    // keeps the end of the output
+    struct Output *out = arg;
+    int n = len < (int) sizeof(out->text) - 1 ? len : (int) sizeof(out->text) - 1;
+
+    if (out->len + n >= (int) sizeof(out->text)) {
+        memmove(out->text, out->text + out->len + n - (sizeof(out->text) - 1), sizeof(out->text) - 1 - n);
+        out->len = (int) sizeof(out->text) - 1 - n;
+    }
+    memcpy(out->text + out->len, buf + len - n, n);
+    out->len += n;
+    out->text[out->len] = '\0';
+    return len;
+}
+
+static int run(const char *name, const char *text, const char *expect)
+{
+    struct urubasic_ctx *ctx;
+    struct Output out;
+
+    out.len = 0;
+    out.text[0] = '\0';
+    ctx = urubasic_init_text(NULL, 16 * 1024 * 1024, text, (int) strlen(text));
+    if (ctx == NULL) {
+        printf("bigprog: %s not loaded\n", name);
+        return 1;
+    }
+    urubasic_set_output(ctx, collect, &out);
+    urubasic_execute(ctx, 0);
+    urubasic_term(ctx);
+    if (out.len < (int) strlen(expect) || 0 != strcmp(out.text + out.len - strlen(expect), expect)) {
+        printf("bigprog: %s printed\n%s\ninstead of\n%s\n", name, out.text, expect);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    char *text = malloc(1024 * 1024), *p;
+    int i, j, failed = 0;
+
+    if (text == NULL)
+        return 1;
+
+    // 2000 lines of about 20 code words each
+    for (p=text, i=1; i<=2000; ++i)
+        p += sprintf(p, "%d LET A = A + %d : PRINT A;\n", 10 * i, i);
+    failed += run("2000 lines", text, " 2001000 ");
+
+    // 300 strings of 250 characters, then short ones with offsets above 64 KB
+    for (p=text, i=1; i<=300; ++i) {
+        p += sprintf(p, "%d DATA \"%05d", i, i);
+        for (j=5; j<250; ++j)
+            *p++ = (char) ('A' + (i + j) % 26);
+        p += sprintf(p, "\"\n");
+    }
+    sprintf(p, "400 DATA \"\", \"A\", 7\n"
+               "410 FOR I = 1 TO 300 : READ S$ : L = L + LEN(S$) : NEXT I\n"
+               "420 READ E$, F$, N : PRINT L; LEN(E$); F$; N\n");
+    failed += run("DATA", text, " 75000  0 A 7\n");
+
+    free(text);
+    printf("bigprog: %d failed\n", failed);
+    return failed != 0;
+}
@@ -0,0 +1,94 @@
+// saves a context with a host function, restores it for several programs and
+// compares their output with the one of a context which is set up from scratch
+#include <stdio.h>
+#include <string.h>
+#include "stdintw.h"
+#include "urubasic.h"
+
+static int mem[16 * 1024];
+static char snapshot[sizeof(mem)];
+
+struct Output {
+    char    text[1024];
+    int     len;
+};
+
+static int twice(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
+{
+    return urubasic_set_number(&arg[0], 2 * urubasic_get_number(&arg[1]));
+}
+
+static int collect(void *arg, const char *buf, int len)
+{
+    struct Output *out = arg;
+
+    if (out->len + len >= (int) sizeof(out->text))
+        len = (int) sizeof(out->text) - 1 - out->len;
+    memcpy(out->text + out->len, buf, len);
+    out->len += len;
+    out->text[out->len] = '\0';
+    return len;
+}
+
+static void run(struct urubasic_ctx *ctx, struct Output *out)
+{
+    out->len = 0;
+    out->text[0] = '\0';
+    urubasic_set_output(ctx, collect, out);
+    urubasic_execute(ctx, 0);
+    urubasic_term(ctx);
+}
+
+int main(void)
+{
+    static const char *const programs[] = {
+        "10 DATA \"X\",21\n20 READ A$,B\n30 A$=A$+\"Y\"\n40 PRINT A$;TWICE(B);LEN(A$)\n",
+        "10 FOR I=1 TO 200:S=S+I:NEXT I\n20 PRINT S;TWICE(S)\n",
+        "10 DEF F(X)=TWICE(X)+1\n20 PRINT F(1);F(F(2))\n",
+    };
+    struct urubasic_ctx *ctx;
+    struct Output expect, got;
+    int len, i, failed = 0;
+
+    ctx = urubasic_init_text(mem, sizeof(mem), "", 0);
+    if (ctx == NULL)
+        return 1;
+    urubasic_add_function(ctx, "TWICE", twice, NULL);
+    len = urubasic_save_size(ctx);
+    if (len <= 0 || len > (int) sizeof(snapshot)) {
+        printf("snapshot: no snapshot (%d bytes)\n", len);
+        return 1;
+    }
+    urubasic_save(ctx, snapshot);
+    urubasic_term(ctx);
+
+    // each program runs twice from the same snapshot
+    for (i=0; i<(int) (sizeof(programs) / sizeof(programs[0])) * 2; ++i) {
+        const char *text = programs[i / 2];
+
+        ctx = urubasic_init_text(mem, sizeof(mem), text, (int) strlen(text));
+        urubasic_add_function(ctx, "TWICE", twice, NULL);
+        run(ctx, &expect);
+
+        ctx = urubasic_init_saved(mem, sizeof(mem), snapshot, len, text, (int) strlen(text));
+        if (ctx == NULL) {
+            printf("snapshot: program %d not restored\n", i / 2);
+            ++failed;
+            continue;
+        }
+        run(ctx, &got);
+        if (expect.len == 0 || 0 != strcmp(expect.text, got.text)) {
+            printf("snapshot: program %d printed\n%s instead of\n%s", i / 2, got.text, expect.text);
+            ++failed;
+        }
+    }
+
+    // a snapshot only fits the memory it was saved from
+    if (urubasic_init_saved(mem + 2, sizeof(mem) - 2 * sizeof(mem[0]), snapshot, len, programs[0], (int) strlen(programs[0])) != NULL) {
+        printf("snapshot: restored at another address\n");
+        ++failed;
+    }
+
+    printf("snapshot: %d failed\n", failed);
+    return failed != 0;
+}
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <time.h>
 #include "stdintw.h"
 #define ICACHE_FLASH_ATTR
@@ -26,6 +27,14 @@
 #include <unistd.h>
 #endif
 
+// hot FOR loops are translated to machine code on Linux x86-64,
+// URUBASIC_NO_JIT leaves them to the VM
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && !defined(URUBASIC_NO_JIT)
+#define URUBASIC_JIT
+#include <stddef.h>
+#include <sys/mman.h>
+#endif
+
 enum Sizes {
     MAX_LINE_LEN            = 128,
     PRINT_ZONE_LEN          = 15,
@@ -33,9 +42,26 @@ enum Sizes {
     MAX_SYMBOLS             = 128,
     FOR_LOOP_DEPTH          = 10,
     EXPR_STACK_SIZE         = 10,
+    VM_STACK_SIZE           = 64,
     MAX_LOOKAHEAD           = 7,
-    MAX_FUNCTION_ARGS       = 4,
-    HASHSIZE                = 57,
+    SYMTAB_INITIAL_SIZE     = 64,       // of the symbol table, it doubles when 3/4 full
+    STD_HASH_SIZE           = 128,
+    STD_SYMBOLS             = 39,       // entries of std_symbols[], host functions follow
+    CODE_CHUNK              = 64,
+    LOOP_EXPRS              = 8,        // expressions moved out of one loop
+    CONST_CHUNK             = 64,
+    NAME_CHUNK              = 128,      // names of symbols are stored side by side
+    SLOT_CHUNK              = 16,
+    HEAP_INITIAL_SIZE       = 0x10000,  // of a growing heap
+    STRING_HEAP_SIZE        = 0x400,    // first size of the string heap, it doubles when full
+    STRING_LONG             = 0x200,    // larger strings get a heap block of their own
+    JIT_THRESHOLD           = 64,       // iterations before a loop is translated
+    JIT_BUFFER_SIZE         = 0x40000,  // machine code of all loops
+#ifdef SMEMBLK_16BIT
+    OUTPUT_BUFFER_SIZE      = 128,      // the context is part of the compact heap
+#else
+    OUTPUT_BUFFER_SIZE      = 4096,
+#endif
 };
 
 enum Token {
@@ -44,9 +70,8 @@ enum Token {
 
     NUM_KEYWORDS,
     NUMBER = MAX_SYMBOLS, NEWLINE, STRING, IDENTIFIER, LT, LE, GE, GT, LSH, RSH, NEQ, EQ, COMMA, SEMICOLON, LPAREN, RPAREN, CIRCUMFLEX,
-    PLUS, MINUS, MULT, SOLIDUS, FUNCTION, AND, OR, NOT, COLON,
+    PLUS, MINUS, MULT, SOLIDUS, FUNCTION, AND, OR, NOT, COLON, ILLEGAL,
 
-    NAME_ALLOC = 0x2000, // flag set when name was allocaated
     ALLOC      = 0x4000, // flag set when STRING was allocaated within expression
     UNARY      = 0x8000, // flag set when operator (+, -) is unary
 };
@@ -65,186 +90,744 @@ enum ErrorCode {
     E_MISSING_BASE        = 11,
     E_INVALID_OPTION_BASE = 12,
     E_INVALID_DIM         = 13,
-    E_WRONG_TYPE          = 14,
-    E_INDEX_OUT_OF_BOUNDS = 15,
+    E_WRONG_TYPE          = 14,
+    E_INDEX_OUT_OF_BOUNDS = 15,
     E_OUT_OF_MEMORY       = 16,
+    E_OUT_OF_DATA         = 17,
+    E_NEXT_WITHOUT_FOR    = 18,
+    E_PROGRAM_TOO_LARGE   = 19,
 };
 
+// the program is compiled once into code words. Operands follow the opcode,
+// a symbol operand is the index of the symbol in slot_table and
+// 32-bit operands (numbers, code offsets) occupy two code words
+enum Opcode {
+    OP_STOP = 0,    // end of program
+    OP_JUMP,        // offset: continue at code offset
+    OP_PUSHNUM,     // number: push number
+    OP_PUSHSTR,     // const: push string constant
+    OP_PUSHNIL,     // reserve room for the return value of a builtin function
+    OP_LOADVAR,     // symbol: push variable
+    OP_LOADARR1,    // symbol: pop x, push variable(x)
+    OP_LOADARR2,    // symbol: pop y and x, push variable(x, y)
+    OP_LOADPARAM,   // n: push argument n of the DEF function
+    OP_LET,         // symbol, dims: pop value and subscripts, assign value to variable
+    OP_ASSIGN,      // symbol: pop number and store it in variable (FOR)
+    OP_NEG,
+    OP_NOT,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_POW,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NEQ,
+    OP_AND,
+    OP_OR,
+    OP_CALL,        // symbol, n: call builtin function with n arguments
+    OP_CALLDEF,     // symbol, n: call DEF function with n arguments
+    OP_RETDEF,      // return from DEF function
+    OP_POP,         // discard top of stack
+    OP_IFFALSE,     // insn: pop condition, skip rest of the line when zero
+    OP_GOTO,        // pop line number and jump there
+    OP_GOSUB,       // pop line number, remember return address and jump there
+    OP_GOTOINSN,    // insn: jump to instruction
+    OP_GOSUBINSN,   // insn: remember return address and jump to instruction
+    OP_RETURN,
+    OP_ONTARGET,    // n, gosub, insn: pop line number, jump there if selector is n
+    OP_ONTABLE,     // n, gosub, insn, n instructions: pop selector and jump to the selected instruction
+    OP_FOR,         // symbol, exit insn, frame: pop end and step of loop
+    OP_NEXT,        // symbol, jit: jit counts the iterations, then refers to the machine code of the loop
+    OP_PRINTVAL,    // pop value and print it
+    OP_PRINTSTR,    // const: print string constant
+    OP_PRINTTAB,    // pop column and print blanks up to it
+    OP_PRINTCOMMA,  // print blanks up to the next print zone
+    OP_PRINTEND,    // ends_with_separator: end of PRINT statement
+    OP_READ,        // symbol, dims: pop subscripts and READ variable
+    OP_RESTORE,
+    OP_OPTIONBASE,  // pop base
+    OP_DIM,         // symbol, dims: pop subscripts and DIM variable
+
+    // superinstructions for common statements, the first two are followed by
+    // the generic code which runs when the variable is not a number yet
+    OP_ADDVAR,      // symbol, number: LET X = X + number, 9 words of generic code follow
+    OP_IFVAR,       // symbol, relop, number: IF X relop number, 6 words of generic code and OP_IFFALSE follow
+    OP_LETARR1,     // symbol: pop value and x, assign value to variable(x)
+    OP_APPEND,      // symbol, 0, 0: pop value, LET X = X + value, a string grows in place
+
+    // variants without type checks for values which infer_types() has proven
+    // to be numbers, OP_NEGN to OP_ORN are in the order of OP_NEG to OP_OR
+    OP_LOADNUM,     // symbol: push numeric variable
+    OP_LETNUM,      // symbol, 0: pop number and assign it to numeric variable
+    OP_NEGN,
+    OP_NOTN,
+    OP_ADDN,
+    OP_SUBN,
+    OP_MULN,
+    OP_DIVN,
+    OP_POWN,
+    OP_LTN,
+    OP_LEN,
+    OP_GTN,
+    OP_GEN,
+    OP_EQN,
+    OP_NEQN,
+    OP_ANDN,
+    OP_ORN,
+};
+
+// the VM threads its code with computed gotos where the compiler supports them
+#if defined(__GNUC__) && !defined(URUBASIC_SWITCH_DISPATCH)
+#define VM_THREADED
+#define VM_CASE(op)   case op: L_##op
+#define VM_NEXT       goto *dispatch[*pc++]
+#else
+#define VM_CASE(op)   case op
+#define VM_NEXT       break
+#endif
+
 struct symbol_def;
 typedef struct symbol_def *SYMIDX;
 
+// a code word, instruction indices and labels fit into one. The compact heap
+// keeps it in 16 bits, the 32-bit layout allows programs which need more
+#ifdef SMEMBLK_32BIT
+typedef int32_t code_t;
+#define CODE_MAX 0x7fffffff
+#else
+typedef int16_t code_t;
+#define CODE_MAX 0x7fff
+#endif
+
+// symbols are kept small for the ESP8266, the name is an offset in the heap
+// and a function is an index, see call_function(). A number or the handle of
+// a string lives in the variable frame, arrays have blocks of their own
 struct symbol_def {
-    char *name;
-    int  (*func)(int n, struct urubasic_type *arg, void *user);
-    int  *value_ptr;
-    int16_t value_type;  // type of value (points to NUMBER or STRING)
+    int     *value_ptr;
+    smemblk_size_t name;            // offset of the name in the heap, -1 in std_symbols[]
+    smemblk_size_t array_base_size; // elements of a row, index of a DEF parameter, code offset of a DEF function (-1 until compiled)
+    int16_t value_type;  // type of value (points to NUMBER or STRING), parameters of a DEF function
     int16_t tok;
-    int16_t array_base_size;
-    int16_t reserved;
-    SYMIDX  next;
+    int16_t slot;        // index in slot_table, 0 when not used by the program
+    int16_t func;        // builtin or host function, 0 for a DEF function
+};
+
+typedef int (*urubasic_func)(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user);
+
+// a keyword or builtin function, which is the same for every context
+struct Std_symbol {
+    struct symbol_def sym;
+    const char *name;
+    urubasic_func func;  // compiles the statement of a keyword
 };
 
+// a function of the host, its symbols refer to it by STD_SYMBOLS + index
+struct Host_function {
+    urubasic_func func;
+    void    *user;
+};
+
+// chunk of names, the names follow the head
+struct Name_chunk {
+    struct Name_chunk *next;
+    int16_t len, max;
+};
+
+// a string starts with its length, the text follows. The value of a string is
+// the index of its handle, a constant is the complement of the offset of its
+// text in const_pool. Strings do not change once they are shared
+struct String {
+    smemblk_size_t len;  // -1 until the text of the host is counted
+    smemblk_size_t refs; // variables and values which hold the string, 0 for constants
+};
+
+// a view shows a part of another string instead of a text of its own
+struct String_view {
+    struct String head;  // refs has STRING_VIEW set
+    smemblk_size_t view; // the string with the text
+    smemblk_size_t start;
+};
+
+// strings are bump allocated in a heap of their own. When it is full the live
+// strings slide together, only their handles point at them
+struct String_block {
+    smemblk_size_t size;   // bytes with this header, 0 for a long string in a heap block
+    smemblk_size_t handle; // -1 when the string is freed
+};
+
+union String_handle {
+    struct String *head;
+    int     next;          // next free handle
+};
+
+#define STRING_VIEW ((smemblk_size_t) 1 << (8 * sizeof(smemblk_size_t) - 2))
+
 struct Insn_info {
-    char    *line;
-    int16_t label;
+    char    *line;      // the crunched tokens of the instruction
+    int     code;   // offset of the compiled instruction
+    code_t  label;
+    code_t  label_max;  // highest label up to this instruction, ascending for the binary search
+    code_t  next;       // next instruction which starts a new line
     int8_t  sep;
 };
 
-static int  token_value, current_char, previous_char, token_len;
-static char token_text[MAX_LINE_LEN];
-static int  pushed_token_stack[1+MAX_LOOKAHEAD];
-
-struct Insn_info *insn_info;
-static int16_t  insn_count, insn_max;
+// FOR and GOSUB frames share the same stack
+struct Frame {
+    SYMIDX  var;        // control variable of FOR, NULL for GOSUB
+    int     offset;     // code offset of the loop body or the return address
+    int     end;
+    int     step;
+};
 
-// symbols
-static smemblk_t *symbol_names;
-static int16_t  current_line;
-static SYMIDX *hashtab;
-static struct symbol_def *extra_table;
+#ifdef URUBASIC_JIT
+// a FOR loop translated to machine code, it runs from the loop body until
+// the loop ends or jumps out and returns the code offset to continue at
+#define JIT_FAILED  (-1)    // jit word of a loop which cannot be translated
+
+struct Jit_region {
+    int     start;          // code offset of the loop body
+    int     (*entry)(struct Frame *frame);
+    SYMIDX  *syms;          // variables which must be numbers to enter
+    int16_t sym_count;
+    int8_t  option_base;
+};
+#endif
 
-static int  for_loop_stack[1+3*FOR_LOOP_DEPTH];
-static int8_t option_base;
-static SYMIDX master_control;
+// all state of one interpreter, every function which needs it gets it as ctx
+struct urubasic_ctx {
+    // lexer
+    int     token_value, current_char, previous_char, token_len;
+    char    *token_text;    // grows for long strings and names
+    int     token_max;
+    int     pushed_token_stack[1+MAX_LOOKAHEAD];
+    int     (* lex_readchar)(void*);
+    void    *read_arg;
+    char    *lex_input_buffer;
+    const unsigned char *lex_tokens;    // crunched instruction being compiled
+    code_t  lex_insn;
+
+    struct Insn_info *insn_info;
+    code_t  insn_count, insn_max;
+
+    // symbols
+    smemblk_t *symbol_names;
+    code_t  current_line;
+    SYMIDX  *symtab;            // open addressing by hash of the name, allocated with the first symbol
+    int     symtab_size, symtab_count;
+    SYMIDX  *def_params;        // parameters of the DEF function being compiled
+    int16_t def_param_count, def_param_max;
+    struct Host_function *functions;
+    int16_t function_count;
+    struct Name_chunk *names;           // chunks with the names of symbols, they never move
+
+    struct Frame frame_stack[FOR_LOOP_DEPTH];
+    int16_t frame_count;
+    int8_t  option_base;
+
+    char    *data_buffer;       // DATA, a number is its size and big endian bytes, a string -1 and its offset in const_pool (see data_len), 0 ends a DATA instruction
+    int     data_buffer_index, data_buffer_max;
+
+    // compiled program
+    code_t  *code, *vm_pc;
+    int     code_len, code_max, error_count;
+    int16_t code_depth, code_max_depth, compile_failed;
+    code_t  for_chain;          // code offset of the innermost FOR without NEXT
+    int     code_op[2];         // offsets of the last two opcodes, for constant folding
+    code_t  code_target;        // instruction an IF of the current line skips to
+    int8_t  code_falls;         // the last instruction may continue with the next one
+    int8_t  optimize;           // optimization level, see urubasic_set_optimize()
+    struct urubasic_type *vm_stack, *vm_fp;
+    int16_t vm_stack_size;
+    int     *vm_vars;           // variables by slot, a string variable holds its handle, arrays have own blocks
+    int16_t vm_var_count;
+
+    // string constants of the program, the code refers to them by offset
+    char    *const_pool;
+    int     const_len, const_max;
+
+    // strings, the heap is allocated on first use
+    char    *string_heap;
+    int     string_top, string_max, string_garbage;
+    union String_handle *string_handles;
+    int     string_handle_count, string_handle_max, string_free;
+
+    // symbols used by the program, the code refers to them by index
+    SYMIDX  *slot_table;
+    int16_t slot_count, slot_max;
+
+    // pending output of PRINT
+    char    print_line[MAX_LINE_LEN];
+    int     print_line_len, print_column;
+
+    // output sink, PRINT output is collected and handed over in blocks
+    int     (*output_write)(void *arg, const char *buf, int len);
+    void    *output_arg;
+    char    output_buffer[OUTPUT_BUFFER_SIZE+1];
+    int     output_len;
+
+#ifdef URUBASIC_JIT
+    // machine code of hot loops, mapped on first use
+    unsigned char *jit_buffer;
+    int     jit_len;
+    struct Jit_region *jit_regions;
+    int16_t jit_count;
+#endif
+#ifdef URUBASIC_AOT
+    int16_t aot_ok;     // the compiled code is the one which was translated
+#endif
+};
 
-static int (* lex_readchar)(void*);
-static char *data_buffer;
-static int16_t data_buffer_index, data_buffer_max;
-static void *read_arg;
+#ifdef URUBASIC_AOT
+// a program translated by --emit-c defines aot_text, aot_code_hash and
+// aot_run() around this file, aot_run() executes the code like vm_run()
+static struct urubasic_type *aot_run(struct urubasic_ctx *ctx, code_t *pc, struct urubasic_type *sp);
+#endif
 
 static struct symbol_def *ICACHE_FLASH_ATTR get_symbol(SYMIDX symidx)
 {
     return symidx;
 }
 
-static int ICACHE_FLASH_ATTR hash(const char *s)
+static char * ICACHE_FLASH_ATTR symbol_name(struct urubasic_ctx *ctx, SYMIDX symidx)
+{
+    if (get_symbol(symidx)->name < 0)
+        return (char *) ((const struct Std_symbol *) symidx)->name;
+    return (char *) ctx->symbol_names + get_symbol(symidx)->name;
+}
+
+static unsigned int ICACHE_FLASH_ATTR hash(const char *s)
 {
-    int hashval;
+    // FNV-1a
+    unsigned int hashval = 2166136261u;
 
-    for (hashval = 0;  *s != '\0'; )
-        hashval += *s++;
-    return (hashval % HASHSIZE);
+    while (*s != '\0')
+        hashval = (hashval ^ (unsigned char) *s++) * 16777619u;
+    return hashval;
 }
 
-static char * ICACHE_FLASH_ATTR store_string(char *text)
+static int ICACHE_FLASH_ATTR keyword_index(int tok)
+{
+    // index of a keyword token in std_symbols[], -1 for other tokens
+    if (tok > 0 && tok < NUM_KEYWORDS)
+        return tok;
+    if (tok >= AND && tok <= NOT)
+        return NUM_KEYWORDS + tok - AND;
+    return -1;
+}
+
+static char * ICACHE_FLASH_ATTR store_string(struct urubasic_ctx *ctx, char *text)
 {
+    // the name is appended to the last chunk, symbols are not removed one by
+    // one, the chunks are freed when the context ends
+    struct Name_chunk *chunk = ctx->names;
+    int len = (int) strlen(text) + 1;
     char *id;
 
-    // store the string in the symbol_name_buffer
-    id = smemblk_alloc(symbol_names, (int16_t) (strlen(text) + 1));
-    if (id)
-        strcpy(id, text);
+    if (chunk == NULL || chunk->len + len > chunk->max) {
+        chunk = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (sizeof(struct Name_chunk) + (len > NAME_CHUNK ? len : NAME_CHUNK)));
+        if (chunk == NULL)
+            return NULL;
+        chunk->next = ctx->names;
+        chunk->len  = 0;
+        chunk->max  = (int16_t) (len > NAME_CHUNK ? len : NAME_CHUNK);
+        ctx->names  = chunk;
+    }
+    id = (char *) (chunk + 1) + chunk->len;
+    memcpy(id, text, (size_t) len);
+    chunk->len += (int16_t) len;
     return id;
 }
 
-static SYMIDX ICACHE_FLASH_ATTR new_symbol(char *name)
+static SYMIDX ICACHE_FLASH_ATTR new_symbol(struct urubasic_ctx *ctx, char *name)
 {
     SYMIDX symidx;
 
-    symidx = smemblk_zalloc(symbol_names, sizeof(*symidx));
+    symidx = smemblk_zalloc(ctx->symbol_names, sizeof(*symidx));
     if (symidx)
-        symidx->name = name;
+        symidx->name = (smemblk_size_t) (name - (char *) ctx->symbol_names);
     return symidx;
 }
 
-static SYMIDX ICACHE_FLASH_ATTR parse_add_extra_symbol(char *name)
+static SYMIDX ICACHE_FLASH_ATTR parse_add_extra_symbol(struct urubasic_ctx *ctx, char *name)
 {
-    SYMIDX symidx = new_symbol(name);
+    SYMIDX symidx, *p;
+
+    if (ctx->def_param_count >= ctx->def_param_max) {
+        p = NULL;
+        if (ctx->def_param_max + 4 < 0x7fff && (ctx->def_param_max + 4) * sizeof(SYMIDX) < SMEMBLK_MAX_SIZE)
+            p = smemblk_realloc(ctx->symbol_names, ctx->def_params, (smemblk_size_t) ((ctx->def_param_max + 4) * sizeof(SYMIDX)));
+        if (p == NULL)
+            return NULL;
+        ctx->def_params = p;
+        ctx->def_param_max += 4;
+    }
 
-    symidx->tok             = IDENTIFIER;
-    symidx->value_ptr       = NULL;
-    symidx->value_type      = NUMBER;
-    symidx->array_base_size = 0;
-    symidx->next            = extra_table;
-    extra_table = symidx;
+    symidx = new_symbol(ctx, name);
+    if (symidx) {
+        symidx->tok             = IDENTIFIER;
+        symidx->value_ptr       = NULL;
+        symidx->value_type      = NUMBER;
+        symidx->array_base_size = 0;
+        ctx->def_params[ctx->def_param_count++] = symidx;
+    }
     return symidx;
 }
 
-static SYMIDX ICACHE_FLASH_ATTR parse_add_symbol(char *name)
+static SYMIDX * ICACHE_FLASH_ATTR symtab_find(struct urubasic_ctx *ctx, const char *name)
+{
+    // the entry of the name or the empty one where it belongs, linear probing
+    // ends because the table is never full
+    unsigned int mask = (unsigned int) ctx->symtab_size - 1, i = hash(name) & mask;
+
+    while (ctx->symtab[i] != NULL && 0 != strcmp(symbol_name(ctx, ctx->symtab[i]), name))
+        i = (i + 1) & mask;
+    return &ctx->symtab[i];
+}
+
+static int ICACHE_FLASH_ATTR symtab_reserve(struct urubasic_ctx *ctx)
+{
+    // make room for one more symbol, the table doubles when it is 3/4 full
+    SYMIDX *old = ctx->symtab;
+    int i, old_size = ctx->symtab_size, size = old_size ? 2 * old_size : SYMTAB_INITIAL_SIZE;
+
+    if ((ctx->symtab_count + 1) * 4 <= old_size * 3)
+        return 1;
+    if (size * sizeof(SYMIDX) >= SMEMBLK_MAX_SIZE || (ctx->symtab = smemblk_zalloc(ctx->symbol_names, (smemblk_size_t) (size * sizeof(SYMIDX)))) == NULL) {
+        ctx->symtab = old;
+        return ctx->symtab_count + 1 < old_size;   // it gets slower, but still works
+    }
+    ctx->symtab_size = size;
+    for (i=0; i<old_size; ++i) {
+        if (old[i] != NULL)
+            *symtab_find(ctx, symbol_name(ctx, old[i])) = old[i];
+    }
+    smemblk_free(ctx->symbol_names, old);
+    return 1;
+}
+
+static SYMIDX ICACHE_FLASH_ATTR parse_add_symbol(struct urubasic_ctx *ctx, char *name)
 {
     // add a new symbol to the symbol table
     SYMIDX symidx;
-    int hval;
-
-    if (name == NULL)
-        return NULL;
-
-    hval = hash(name);
 
-    symidx = new_symbol(name);
+    if (name == NULL || !symtab_reserve(ctx))
+        return NULL;
+
+    symidx = new_symbol(ctx, name);
     if (symidx) {
         symidx->tok             = IDENTIFIER;
         symidx->value_ptr       = NULL;
-        symidx->value_type      = NUMBER | NAME_ALLOC;
+        symidx->value_type      = NUMBER;
         symidx->array_base_size = 0;
-        symidx->next = hashtab[hval];
-        hashtab[hval] = symidx;
-        if (name[1] == '\0' && name[0] >= 'A' && name[0] <= '_')
-            hashtab[HASHSIZE+name[0]-'A'] = hashtab[hval];  // store symidx for quick access, if name is single uppercase letter
+        *symtab_find(ctx, name) = symidx;
+        ++ctx->symtab_count;
+    }
+    return symidx;
+}
 
-        return hashtab[hval];
-    }
-    else
-        return NULL;
+static SYMIDX ICACHE_FLASH_ATTR parse_lookup_symbol(struct urubasic_ctx *ctx, char *name, int add_if_not_exist);
+static int ICACHE_FLASH_ATTR std_index(const char *name);
+static SYMIDX ICACHE_FLASH_ATTR std_symbol(int index);
+static int ICACHE_FLASH_ATTR compile_keyword(struct urubasic_ctx *ctx, int tok, int insn);
+static int ICACHE_FLASH_ATTR call_function(struct urubasic_ctx *ctx, SYMIDX symidx, int n, struct urubasic_type *arg);
+static void ICACHE_FLASH_ATTR string_release(struct urubasic_ctx *ctx, int value);
+
+static int ICACHE_FLASH_ATTR in_frame(struct urubasic_ctx *ctx, SYMIDX symidx)
+{
+    // whether the number of the variable is kept in the variable frame
+    int *value_ptr = get_symbol(symidx)->value_ptr;
+
+    return ctx->vm_var_count > 0 && value_ptr >= ctx->vm_vars && value_ptr < ctx->vm_vars + ctx->vm_var_count;
 }
 
-static void ICACHE_FLASH_ATTR add_symbol_intern(char *name, int tok, int (*func)(int n, struct urubasic_type *arg, void *user), void *user)
+static void ICACHE_FLASH_ATTR free_value(struct urubasic_ctx *ctx, SYMIDX symidx)
 {
-    SYMIDX symidx;
-    symidx = parse_add_symbol(name);
-    get_symbol(symidx)->tok             = tok;
-    get_symbol(symidx)->func            = func;
-    get_symbol(symidx)->value_ptr       = user;
-    get_symbol(symidx)->value_type      = NUMBER;
-    get_symbol(symidx)->array_base_size = 0;
+    // values in the variable frame are not blocks of their own, a string
+    // variable holds the value of its string like a number
+    struct symbol_def *sym = get_symbol(symidx);
+
+    if ((sym->value_type & 0xff) == STRING && sym->tok == IDENTIFIER && sym->value_ptr != NULL)
+        string_release(ctx, *sym->value_ptr);
+    if (!in_frame(ctx, symidx))
+        smemblk_free(ctx->symbol_names, sym->value_ptr);
+    get_symbol(symidx)->value_ptr = NULL;
 }
 
-void ICACHE_FLASH_ATTR urubasic_add_function(char *name, int (*func)(int n, struct urubasic_type *arg, void *user), void *user)
+void ICACHE_FLASH_ATTR urubasic_add_function(struct urubasic_ctx *ctx, char *name, int (*func)(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user), void *user)
 {
     SYMIDX symidx;
+    struct Host_function *p;
+    int i;
+
+    // the crunched program refers to the symbol of a name it uses already,
+    // keywords cannot be replaced
+    symidx = parse_lookup_symbol(ctx, name, 0);
+    if (symidx != NULL && (get_symbol(symidx)->tok == IDENTIFIER || get_symbol(symidx)->tok == FUNCTION)) {
+        if (get_symbol(symidx)->tok == IDENTIFIER && get_symbol(symidx)->value_ptr != NULL)
+            free_value(ctx, symidx);
+    }
+    else if (symidx != NULL)
+        return;
+    else {
+        symidx = parse_add_symbol(ctx, store_string(ctx, name));
+        if (symidx == NULL)
+            return;
+    }
 
-    symidx = parse_add_symbol(store_string(name));
+    // a function of the host which is added again keeps its index
+    i = get_symbol(symidx)->tok == FUNCTION ? get_symbol(symidx)->func - STD_SYMBOLS : -1;
+    if (i < 0) {
+        p = NULL;
+        if (ctx->function_count + STD_SYMBOLS < 0x7fff && (ctx->function_count + 1) * sizeof(struct Host_function) < SMEMBLK_MAX_SIZE)
+            p = smemblk_realloc(ctx->symbol_names, ctx->functions, (smemblk_size_t) ((ctx->function_count + 1) * sizeof(struct Host_function)));
+        if (p == NULL)
+            return;
+        ctx->functions = p;
+        i = ctx->function_count++;
+    }
+    ctx->functions[i].func = func;
+    ctx->functions[i].user = user;
     get_symbol(symidx)->tok             = FUNCTION;
-    get_symbol(symidx)->func            = func;
-    get_symbol(symidx)->value_ptr       = user;
-    get_symbol(symidx)->value_type      = NUMBER | NAME_ALLOC;
+    get_symbol(symidx)->func            = (int16_t) (STD_SYMBOLS + i);
+    get_symbol(symidx)->value_ptr       = NULL;
+    get_symbol(symidx)->value_type      = NUMBER;
     get_symbol(symidx)->array_base_size = 0;
 }
 
-static SYMIDX ICACHE_FLASH_ATTR parse_lookup_symbol(char *name, int add_if_not_exist)
+static SYMIDX ICACHE_FLASH_ATTR parse_lookup_symbol(struct urubasic_ctx *ctx, char *name, int add_if_not_exist)
 {
-    // lookup in extra space
-    int hval, idx;
+    // parameters of a DEF function first, then keywords and the symbol table
     SYMIDX symidx;
+    int i, std;
 
-    if (extra_table) {
-        symidx = extra_table;
-        while (symidx) {
-            if (0 == strcmp(get_symbol(symidx)->name, name))
-                return symidx;
-            symidx = symidx->next;
+    for (i=ctx->def_param_count; i-- > 0; ) {
+        if (0 == strcmp(symbol_name(ctx, ctx->def_params[i]), name))
+            return ctx->def_params[i];
+    }
+
+    std = std_index(name);
+    if (std > 0 && get_symbol(std_symbol(std))->tok != FUNCTION)
+        return std_symbol(std);
+    if (ctx->symtab != NULL && (symidx = *symtab_find(ctx, name)) != NULL)
+        return symidx;
+
+    if (std > 0) {
+        // a builtin function gets a symbol of its own when it is used, for its slot
+        symidx = parse_add_symbol(ctx, store_string(ctx, name));
+        if (symidx != NULL) {
+            symidx->tok  = FUNCTION;
+            symidx->func = (int16_t) std;
         }
     }
+    else if (add_if_not_exist)
+        symidx = parse_add_symbol(ctx, store_string(ctx, name));
+    else
+        symidx = 0;
+    return symidx;
+}
+
+static int ICACHE_FLASH_ATTR insn_from_code(struct urubasic_ctx *ctx, int offset)
+{
+    // binary search for the instruction the code offset belongs to
+    int lo = 0, hi = ctx->insn_count - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (ctx->insn_info[mid].code <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+static int ICACHE_FLASH_ATTR write_stdout(void *arg, const char *buf, int len)
+{
+#ifdef __ETS__
+    os_printf("%s", buf);
+    return len;
+#else
+    return (int) fwrite(buf, 1, len, stdout);
+#endif
+}
+
+static void ICACHE_FLASH_ATTR output_flush(struct urubasic_ctx *ctx)
+{
+    // hand the collected output to the sink
+    if (ctx->output_len > 0) {
+        ctx->output_buffer[ctx->output_len] = '\0';
+        ctx->output_write(ctx->output_arg, ctx->output_buffer, ctx->output_len);
+        ctx->output_len = 0;
+    }
+}
 
-    idx = HASHSIZE+name[0]-'A';
-    if (name[1] == '\0' && idx >= HASHSIZE && name[0] <= '_') {
-        // short cut when name is single uppercase letter
-        symidx = hashtab[idx];
-        if (symidx)
-            return symidx;
+static void ICACHE_FLASH_ATTR output_text(struct urubasic_ctx *ctx, const char *s, int len)
+{
+    int n;
+
+    while (len > 0) {
+        if (ctx->output_len == OUTPUT_BUFFER_SIZE)
+            output_flush(ctx);
+        n = OUTPUT_BUFFER_SIZE - ctx->output_len;
+        if (n > len)
+            n = len;
+        memcpy(&ctx->output_buffer[ctx->output_len], s, n);
+        ctx->output_len += n;
+        s += n;
+        len -= n;
     }
+}
+
+static int ICACHE_FLASH_ATTR format_number(char *buf, int value)
+{
+    // a number as PRINT shows it, " 12 " or "-12 ". Returns the length
+    unsigned int u = value < 0 ? 0u - (unsigned int) value : (unsigned int) value;
+    char digits[10];
+    int n = 0, len = 0;
+
+    do {
+        digits[n++] = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+
+    buf[len++] = value < 0 ? '-' : ' ';
+    while (n > 0)
+        buf[len++] = digits[--n];
+    buf[len++] = ' ';
+    buf[len] = '\0';
+    return len;
+}
 
-    hval = hash(name);
-    for (symidx=hashtab[hval]; symidx != 0; symidx = get_symbol(symidx)->next) {
-        if (get_symbol(symidx)->name == name || 0 == strcmp(get_symbol(symidx)->name, name))
-            return symidx;
+static int ICACHE_FLASH_ATTR list_put(struct urubasic_ctx *ctx, char *buf, int max, int len, const char *s, int n)
+{
+    // append n chars to buf, or to the output when there is no buffer
+    if (buf == NULL)
+        output_text(ctx, s, n);
+    else {
+        if (n > max - 1 - len)
+            n = max - 1 - len;
+        memcpy(buf + len, s, n);
+        buf[len + n] = '\0';
     }
+    return len + n;
+}
 
-    if (add_if_not_exist)
-        symidx = parse_add_symbol(store_string(name));
-    else
-        symidx = 0;
-    return symidx;
+static int ICACHE_FLASH_ATTR data_len(const char *data)
+{
+    // bytes of a record of data_buffer, the offset of a string is as wide as a code word
+    return data[0] == -1 ? 1 + (int) sizeof(code_t) : 1 + data[0];
+}
+
+static int ICACHE_FLASH_ATTR data_offset(const char *data)
+{
+    // big endian offset of a string in const_pool behind the -1
+    int v = 0, i;
+
+    for (i=1; i<=(int) sizeof(code_t); ++i)
+        v = v * 256 + (uint8_t) data[i];
+    return v;
+}
+
+static int ICACHE_FLASH_ATTR data_number(const char *data)
+{
+    // big endian number of 1, 2 or 4 bytes behind its size
+    int v = (int8_t) data[1], i;
+
+    for (i=2; i<=data[0]; ++i)
+        v = v * 256 + (uint8_t) data[i];
+    return v;
+}
+
+static int ICACHE_FLASH_ATTR list_data(struct urubasic_ctx *ctx, int insn, char *buf, int max, int len)
+{
+    // the constants of a DATA instruction follow the ones of the DATA before
+    const char *data = ctx->data_buffer, *s;
+    char temp[16];
+    int i, o = 0, n;
+
+    for (i=0; i<insn; ++i) {
+        if (ctx->insn_info[i].line != NULL && ctx->insn_info[i].line[0] == DATA) {
+            while (o < ctx->data_buffer_max && data[o] != 0)
+                o += data_len(&data[o]);
+            ++o;
+        }
+    }
+    for (i=0; o < ctx->data_buffer_max && data[o] != 0; ++i) {
+        len = list_put(ctx, buf, max, len, i == 0 ? " " : ",", 1);
+        if (data[o] == -1) {
+            s = ctx->const_pool + data_offset(&data[o]);
+            len = list_put(ctx, buf, max, len, "\"", 1);
+            len = list_put(ctx, buf, max, len, s, ((struct String *) s - 1)->len);
+            len = list_put(ctx, buf, max, len, "\"", 1);
+        }
+        else {
+            n = format_number(temp, data_number(&data[o]));
+            s = temp[0] == ' ' ? temp + 1 : temp;
+            len = list_put(ctx, buf, max, len, s, n - 1 - (int) (s - temp));
+        }
+        o += data_len(&data[o]);
+    }
+    return len;
+}
+
+static void ICACHE_FLASH_ATTR list_insn(struct urubasic_ctx *ctx, int insn, char *buf, int max)
+{
+    // detokenize a crunched instruction like LIST shows it
+    static const char *const operators[] = { "<", "<=", ">=", ">", "<<", ">>", "<>", "=", ",", ";", "(", ")", "^", "+", "-", "*", "/" };
+    const unsigned char *p = (const unsigned char *) ctx->insn_info[insn].line;
+    const char *s;
+    char temp[16];
+    int tok, n, len = 0, prev = 0, word, prev_word = 0;
+
+    if (buf != NULL)
+        buf[0] = '\0';
+    while ((tok = *p++) != 0 && tok != NEWLINE && tok != COLON) {
+        s = temp;
+        word = 1;
+        switch (tok) {
+            case NUMBER:
+                n = format_number(temp, (int) ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24));
+                s = temp[0] == ' ' ? temp + 1 : temp;
+                n -= 1 + (s - temp);
+                p += 4;
+                break;
+            case STRING:
+                s = (const char *) p;
+                n = strlen(s);
+                p += n + 1;
+                break;
+            case IDENTIFIER:
+                s = symbol_name(ctx, ctx->slot_table[p[0] | p[1] << 8]);
+                n = strlen(s);
+                p += 2;
+                break;
+            default:
+                if (keyword_index(tok) >= 0)
+                    s = symbol_name(ctx, std_symbol(keyword_index(tok)));
+                else if (tok >= LT && tok <= SOLIDUS)
+                    s = operators[tok - LT];
+                else
+                    temp[0] = (char) (tok == ILLEGAL ? *p++ : tok), temp[1] = '\0';
+                n = strlen(s);
+                word = keyword_index(tok) >= 0;
+                break;
+        }
+        if (prev != 0 && prev != TAB && (keyword_index(prev) >= 0 || keyword_index(tok) >= 0 || (prev_word && word)))
+            len = list_put(ctx, buf, max, len, " ", 1);
+        if (tok == STRING)
+            len = list_put(ctx, buf, max, len, "\"", 1);
+        len = list_put(ctx, buf, max, len, s, n);
+        if (tok == STRING)
+            len = list_put(ctx, buf, max, len, "\"", 1);
+        prev = tok;
+        prev_word = word;
+    }
+    if (prev == DATA)
+        list_data(ctx, insn, buf, max, len);
 }
 
 static void ICACHE_FLASH_ATTR error_msg(char *msg, int line, int err)
@@ -252,68 +835,342 @@ static void ICACHE_FLASH_ATTR error_msg(char *msg, int line, int err)
 #ifdef __ETS__
     os_printf(msg, line, err);
 #else
+    fflush(stdout);
     fprintf(stderr, msg, line, err);
 #endif
 }
 
-static void ICACHE_FLASH_ATTR parse_error(int error)
+static void ICACHE_FLASH_ATTR error_source(struct urubasic_ctx *ctx, int insn)
+{
+    // the instruction of an error as LIST shows it
+    char source[MAX_LINE_LEN];
+
+    list_insn(ctx, insn, source, sizeof(source));
+#ifdef __ETS__
+    os_printf("    %s\n", source);
+#else
+    fprintf(stderr, "    %s\n", source);
+#endif
+}
+
+static void ICACHE_FLASH_ATTR parse_error(struct urubasic_ctx *ctx, int error)
 {
+    int insn = -1;
+
+    ++ctx->error_count;
+    output_flush(ctx);  // keep the order of output and error messages
+    if (ctx->vm_pc != NULL) {
+        insn = insn_from_code(ctx, ctx->vm_pc - ctx->code);
+        ctx->current_line = ctx->insn_info[insn].label;
+    }
+    else if (ctx->lex_tokens != NULL)
+        insn = ctx->lex_insn;
+
     switch (error) {
-        case E_MISSING_TO:         error_msg("ERROR:%d: missing TO in FOR instruction (%d)\n", current_line, error); break;
-        case E_MISSING_THEN:       error_msg("ERROR:%d: missing THEN in IF instruction (%d)\n", current_line, error); break;
-        case E_MISSING_NUMBER:     error_msg("ERROR:%d: missing NUMBER in instruction (%d)\n", current_line, error); break;
-        case E_MISSING_EQUALSIGN:  error_msg("ERROR:%d: missing = in instruction (%d)\n", current_line, error); break;
-        case E_MISSING_IDENTIFIER: error_msg("ERROR:%d: missing IDENTIFIER in instruction (%d)\n", current_line, error); break;
-        case E_MISSING_LPAREN:     error_msg("ERROR:%d: missing ( in instruction (%d)\n", current_line, error); break;
-        case E_MISSING_RPAREN:     error_msg("ERROR:%d: missing ) in instruction (%d)\n", current_line, error); break;
-        case E_MISSING_DEF:        error_msg("ERROR:%d: user supplied function not defined in instruction (%d)\n", current_line, error); break;
-        case E_MISSING_GOTO:       error_msg("ERROR:%d: missing GOTO in instruction (%d)\n", current_line, error); break;
-        case E_MISSING_BASE:       error_msg("ERROR:%d: missing BASE in instruction (%d)\n", current_line, error); break;
-        case E_INVALID_OPTION_BASE:error_msg("ERROR:%d: invalid OPTION BASE (%d)\n", current_line, error); break;
-        case E_INVALID_DIM:        error_msg("ERROR:%d: invalid dimension specified (%d)\n", current_line, error); break;
-        case E_WRONG_TYPE:         error_msg("ERROR:%d: wrong type in assignment (%d)\n", current_line, error); break;
-        case E_INDEX_OUT_OF_BOUNDS:error_msg("ERROR:%d: array index is out of bounds (%d)\n", current_line, error); break;
-        case E_OUT_OF_MEMORY:      error_msg("ERROR:%d: out of memory (%d)\n", current_line, error); break;
-
-        default:                   error_msg("ERROR:%d: syntax error (%d)\n", current_line, error); break;
-    }
-}
-
-static char *lex_input_buffer;
+        case E_MISSING_TO:         error_msg("ERROR:%d: missing TO in FOR instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_THEN:       error_msg("ERROR:%d: missing THEN in IF instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_NUMBER:     error_msg("ERROR:%d: missing NUMBER in instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_EQUALSIGN:  error_msg("ERROR:%d: missing = in instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_IDENTIFIER: error_msg("ERROR:%d: missing IDENTIFIER in instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_LPAREN:     error_msg("ERROR:%d: missing ( in instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_RPAREN:     error_msg("ERROR:%d: missing ) in instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_DEF:        error_msg("ERROR:%d: user supplied function not defined in instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_GOTO:       error_msg("ERROR:%d: missing GOTO in instruction (%d)\n", ctx->current_line, error); break;
+        case E_MISSING_BASE:       error_msg("ERROR:%d: missing BASE in instruction (%d)\n", ctx->current_line, error); break;
+        case E_INVALID_OPTION_BASE:error_msg("ERROR:%d: invalid OPTION BASE (%d)\n", ctx->current_line, error); break;
+        case E_INVALID_DIM:        error_msg("ERROR:%d: invalid dimension specified (%d)\n", ctx->current_line, error); break;
+        case E_WRONG_TYPE:         error_msg("ERROR:%d: wrong type in assignment (%d)\n", ctx->current_line, error); break;
+        case E_INDEX_OUT_OF_BOUNDS:error_msg("ERROR:%d: array index is out of bounds (%d)\n", ctx->current_line, error); break;
+        case E_OUT_OF_MEMORY:      error_msg("ERROR:%d: out of memory (%d)\n", ctx->current_line, error); break;
+        case E_OUT_OF_DATA:        error_msg("ERROR:%d: out of DATA in READ instruction (%d)\n", ctx->current_line, error); break;
+        case E_NEXT_WITHOUT_FOR:   error_msg("ERROR:%d: NEXT without FOR (%d)\n", ctx->current_line, error); break;
+        case E_PROGRAM_TOO_LARGE:  error_msg("ERROR:%d: program too large (%d)\n", ctx->current_line, error); break;
+
+        default:                   error_msg("ERROR:%d: syntax error (%d)\n", ctx->current_line, error); break;
+    }
+    if (insn >= 0)
+        error_source(ctx, insn);
+}
+
+static struct String * ICACHE_FLASH_ATTR string_head(struct urubasic_ctx *ctx, int value)
+{
+    if (value < 0)
+        return (struct String *) (ctx->const_pool + ~value) - 1;
+    return ctx->string_handles[value].head;
+}
+
+static int ICACHE_FLASH_ATTR string_len(struct urubasic_ctx *ctx, int value)
+{
+    // the text a host function has written is counted once
+    struct String *s = string_head(ctx, value);
+
+    if (s->len < 0)
+        s->len = (smemblk_size_t) strlen((char *) (s + 1));
+    return s->len;
+}
+
+static char * ICACHE_FLASH_ATTR string_text(struct urubasic_ctx *ctx, int value)
+{
+    // the text is not NUL terminated in a view. It moves when a string is
+    // allocated, the callers look it up after allocating
+    struct String *s = string_head(ctx, value);
+
+    struct String_view *v = (struct String_view *) s;
+
+    return s->refs & STRING_VIEW ? (char *) (string_head(ctx, v->view) + 1) + v->start : (char *) (s + 1);
+}
+
+static void ICACHE_FLASH_ATTR string_retain(struct urubasic_ctx *ctx, int value)
+{
+    if (value >= 0)
+        ++ctx->string_handles[value].head->refs;
+}
+
+static int ICACHE_FLASH_ATTR string_size(int len)
+{
+    // bytes of a string with its header and NUL, rounded for the header behind
+    return (int) ((2 * sizeof(struct String) + len) / sizeof(struct String) * sizeof(struct String));
+}
+
+static int ICACHE_FLASH_ATTR string_block_size(int size)
+{
+    // bytes of a block for size bytes of string, rounded for the next block
+    return (int) ((2 * sizeof(struct String_block) - 1 + size) / sizeof(struct String_block) * sizeof(struct String_block));
+}
+
+static void ICACHE_FLASH_ATTR string_compact(struct urubasic_ctx *ctx)
+{
+    // the live strings slide to the start of the heap in their order
+    struct String_block *b;
+    int from, to, size;
+
+    for (from = to = 0; from < ctx->string_top; from += size) {
+        b = (struct String_block *) (ctx->string_heap + from);
+        size = b->size;
+        if (b->handle < 0)
+            continue;
+        if (to != from) {
+            memmove(ctx->string_heap + to, b, (size_t) size);
+            b = (struct String_block *) (ctx->string_heap + to);
+        }
+        ctx->string_handles[b->handle].head = (struct String *) (b + 1);
+        to += size;
+    }
+    ctx->string_top = to;
+    ctx->string_garbage = 0;
+}
+
+static int ICACHE_FLASH_ATTR string_room(struct urubasic_ctx *ctx, int need)
+{
+    // whether need bytes fit at the top of the heap after compacting it. The
+    // heap doubles when live strings fill half of it, so it is compacted
+    // after many allocations only
+    char *p;
+    int max;
+
+    if (ctx->string_garbage > 0 && ctx->string_garbage >= ctx->string_max / 8)
+        string_compact(ctx);
+    if (ctx->string_top + need > ctx->string_max / 2 && ctx->string_max < SMEMBLK_MAX_SIZE) {
+        if (ctx->string_max == 0)
+            max = STRING_HEAP_SIZE;
+        else
+            max = ctx->string_max < SMEMBLK_MAX_SIZE / 2 ? 2 * ctx->string_max : SMEMBLK_MAX_SIZE;
+        p = smemblk_realloc(ctx->symbol_names, ctx->string_heap, (smemblk_size_t) max);
+        if (p != NULL) {
+            ctx->string_max = max;
+            if (p != ctx->string_heap) {
+                // the handles follow the moved strings
+                ctx->string_heap = p;
+                string_compact(ctx);
+            }
+        }
+    }
+    if (ctx->string_top + need > ctx->string_max && ctx->string_garbage > 0)
+        string_compact(ctx);
+    return ctx->string_top + need <= ctx->string_max;
+}
+
+static struct String_block * ICACHE_FLASH_ATTR string_block_alloc(struct urubasic_ctx *ctx, int size)
+{
+    // a block for size bytes of string, long strings and strings which do not
+    // fit into the string heap get a heap block of their own
+    struct String_block *b = NULL;
+    int need = string_block_size(size);
+
+    if (need <= STRING_LONG && (ctx->string_top + need <= ctx->string_max || string_room(ctx, need))) {
+        b = (struct String_block *) (ctx->string_heap + ctx->string_top);
+        b->size = (smemblk_size_t) need;
+        ctx->string_top += need;
+    }
+    else if (size <= SMEMBLK_MAX_SIZE - (int) sizeof(*b)) {
+        b = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (sizeof(*b) + size));
+        if (b != NULL)
+            b->size = 0;
+    }
+    return b;
+}
+
+static void ICACHE_FLASH_ATTR string_block_free(struct urubasic_ctx *ctx, struct String_block *b)
+{
+    // the last block of the string heap is taken back at once, others when
+    // the heap is compacted
+    if (b->size == 0)
+        smemblk_free(ctx->symbol_names, b);
+    else if ((char *) b + b->size == ctx->string_heap + ctx->string_top)
+        ctx->string_top -= b->size;
+    else {
+        b->handle = -1;
+        ctx->string_garbage += b->size;
+    }
+}
+
+static int ICACHE_FLASH_ATTR string_new(struct urubasic_ctx *ctx, int size)
+{
+    // handle of a new string of size bytes with its header, -1 without memory
+    union String_handle *p;
+    struct String_block *b;
+    int handle = ctx->string_free;
+
+    if (handle < 0 && ctx->string_handle_count >= ctx->string_handle_max) {
+        p = NULL;
+        // handles have to fit into a view
+        if (ctx->string_handle_max < SMEMBLK_MAX_SIZE / 2 / (int) sizeof(*p) - 16)
+            p = smemblk_realloc(ctx->symbol_names, ctx->string_handles, (smemblk_size_t) ((2 * ctx->string_handle_max + 16) * sizeof(*p)));
+        if (p == NULL)
+            return -1;
+        ctx->string_handles = p;
+        ctx->string_handle_max = 2 * ctx->string_handle_max + 16;
+    }
+
+    b = string_block_alloc(ctx, size);
+    if (b == NULL)
+        return -1;
+    if (handle >= 0)
+        ctx->string_free = ctx->string_handles[handle].next;
+    else
+        handle = ctx->string_handle_count++;
+    b->handle = (smemblk_size_t) handle;
+    ctx->string_handles[handle].head = (struct String *) (b + 1);
+    return handle;
+}
+
+static int ICACHE_FLASH_ATTR string_capacity(struct urubasic_ctx *ctx, int handle)
+{
+    // characters the block of a string has room for
+    struct String_block *b = (struct String_block *) ctx->string_handles[handle].head - 1;
+
+    return (b->size != 0 ? b->size : smemblk_size(ctx->symbol_names, b)) - (int) (sizeof(*b) + sizeof(struct String)) - 1;
+}
+
+static int ICACHE_FLASH_ATTR string_resize(struct urubasic_ctx *ctx, int handle, int size)
+{
+    // the string gets a block of size bytes. The last block of the string
+    // heap and a block of its own grow in place, other strings are copied
+    struct String_block *b = (struct String_block *) ctx->string_handles[handle].head - 1, *n;
+    int need = string_block_size(size);
+
+    if (b->size == 0) {
+        n = smemblk_realloc(ctx->symbol_names, b, (smemblk_size_t) (sizeof(*b) + size));
+        if (n == NULL)
+            return 0;
+    }
+    else if ((char *) b + b->size == ctx->string_heap + ctx->string_top && need <= STRING_LONG
+             && ctx->string_top - b->size + need <= ctx->string_max) {
+        ctx->string_top += need - b->size;
+        b->size = (smemblk_size_t) need;
+        return 1;
+    }
+    else {
+        n = string_block_alloc(ctx, size);
+        if (n == NULL)
+            return 0;
+        // compacting may have moved the string
+        b = (struct String_block *) ctx->string_handles[handle].head - 1;
+        memcpy(n + 1, b + 1, sizeof(struct String) + (size_t) string_len(ctx, handle) + 1);
+        string_block_free(ctx, b);
+        n->handle = (smemblk_size_t) handle;
+    }
+    ctx->string_handles[handle].head = (struct String *) (n + 1);
+    return 1;
+}
+
+static void ICACHE_FLASH_ATTR string_release(struct urubasic_ctx *ctx, int value)
+{
+    // the last reference frees the string and its handle, a view the string
+    // it shows. Constants are not counted
+    struct String *s;
+
+    if (value < 0)
+        return;
+    s = ctx->string_handles[value].head;
+    if ((--s->refs & ~STRING_VIEW) == 0) {
+        if (s->refs & STRING_VIEW)
+            string_release(ctx, ((struct String_view *) s)->view);
+        string_block_free(ctx, (struct String_block *) s - 1);
+        ctx->string_handles[value].next = ctx->string_free;
+        ctx->string_free = value;
+    }
+}
+
+static char * ICACHE_FLASH_ATTR string_alloc(struct urubasic_ctx *ctx, struct urubasic_type *arg, int len)
+{
+    // a new string of len characters, the caller fills in the text
+    struct String *s;
+    int handle = -1;
+
+    if (len >= 0 && len < SMEMBLK_MAX_SIZE - 2 * (int) sizeof(struct String))
+        handle = string_new(ctx, (int) sizeof(struct String) + len + 1);
+    if (handle < 0) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        arg->type  = NUMBER;
+        arg->value = 0;
+        return NULL;
+    }
+    s = ctx->string_handles[handle].head;
+    s->len  = (smemblk_size_t) len;
+    s->refs = 1;
+    ((char *) (s + 1))[len] = '\0';
+    arg->type  = STRING|ALLOC;
+    arg->value = handle;
+    return (char *) (s + 1);
+}
+
 static int ICACHE_FLASH_ATTR read_from_buffer(void *arg)
 {
     // read one character from input buffer
-    return *(lex_input_buffer++);
+    struct urubasic_ctx *ctx = arg;
+
+    return *(ctx->lex_input_buffer++);
 }
 
-static int ICACHE_FLASH_ATTR lex_shift()
+static int ICACHE_FLASH_ATTR lex_shift(struct urubasic_ctx *ctx)
 {
     // shift one char back in input stream
-    if (NULL == lex_input_buffer) {
-        int ch = current_char;
-        if (previous_char != 0)
-            ch = previous_char;
+    if (NULL == ctx->lex_input_buffer) {
+        int ch = ctx->current_char;
+        if (ctx->previous_char != 0)
+            ch = ctx->previous_char;
 
-        previous_char = current_char;
-        current_char = 0;
+        ctx->previous_char = ctx->current_char;
+        ctx->current_char = 0;
         return ch;
     }
     else
-        return *--lex_input_buffer;
+        return *--ctx->lex_input_buffer;
 }
 
-static void ICACHE_FLASH_ATTR lex_clear(void) { lex_shift(); previous_char = 0; } // no memory of previous char
+static void ICACHE_FLASH_ATTR lex_clear(struct urubasic_ctx *ctx) { lex_shift(ctx); ctx->previous_char = 0; } // no memory of previous char
 static int ICACHE_FLASH_ATTR is_digit(int c) { return (c >= '0' && c <= '9'); }
 static int ICACHE_FLASH_ATTR is_blank(int c) { return (c == ' ' || c == '\t'); }
 
-static int ICACHE_FLASH_ATTR read_number(int base)
+static int ICACHE_FLASH_ATTR read_number(struct urubasic_ctx *ctx, int base)
 {
     // read a decimal number
     int number = 0;
-    while (is_digit(current_char)) {
+    while (is_digit(ctx->current_char)) {
         number *= base;
-        number += (current_char & 0xf) + (9 * (current_char >> 6));
-        current_char = lex_readchar(read_arg);
+        number += (ctx->current_char & 0xf) + (9 * (ctx->current_char >> 6));
+        ctx->current_char = ctx->lex_readchar(ctx->read_arg);
     }
 
     return number;
@@ -338,69 +1195,82 @@ static int ICACHE_FLASH_ATTR stack_top(int *stack, int pop)
     return retval;
 }
 
-static void ICACHE_FLASH_ATTR lex_push_token(int tok)
+static void ICACHE_FLASH_ATTR lex_store(struct urubasic_ctx *ctx, int i, int c)
+{
+    // store c at token_text[i], a token which does not fit into memory is cut
+    char *p;
+
+    if (i >= ctx->token_max) {
+        p = smemblk_realloc(ctx->symbol_names, ctx->token_text, (smemblk_size_t) ((i / MAX_LINE_LEN + 1) * MAX_LINE_LEN));
+        if (p == NULL) {
+            if (ctx->token_max > 0)
+                ctx->token_text[ctx->token_max-1] = '\0';
+            return;
+        }
+        ctx->token_text = p;
+        ctx->token_max = (i / MAX_LINE_LEN + 1) * MAX_LINE_LEN;
+    }
+    ctx->token_text[i] = (char) c;
+}
+
+static void ICACHE_FLASH_ATTR lex_push_token(struct urubasic_ctx *ctx, int tok)
 {
-    stack_push(pushed_token_stack, tok); // remember token for reading it again
+    stack_push(ctx->pushed_token_stack, tok); // remember token for reading it again
 }
 
-static int ICACHE_FLASH_ATTR lex_next_token(SYMIDX *symidx)
+static int ICACHE_FLASH_ATTR lex_scan(struct urubasic_ctx *ctx, SYMIDX *symidx)
 {
     // read one token from input stream
     *symidx = 0;
-    if (!stack_empty(pushed_token_stack)) {
-        int tok = stack_pop(pushed_token_stack);  // use tok stored on stack
-        return tok;
-    }
-
     do {
-        if (previous_char != 0)
-            current_char = lex_shift();
+        if (ctx->previous_char != 0)
+            ctx->current_char = lex_shift(ctx);
         else
-            current_char = lex_readchar(read_arg);
-    } while (is_blank(current_char));
+            ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+    } while (is_blank(ctx->current_char));
 
-    switch (current_char) {
+    switch (ctx->current_char) {
         case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-            token_value = read_number(10);
-            lex_shift();
+            ctx->token_value = read_number(ctx, 10);
+            lex_shift(ctx);
             return NUMBER;
 
         case '&':
-            current_char = lex_readchar(read_arg);
-            if (current_char ==  'H') {
-                current_char = lex_readchar(read_arg);
-                token_value = read_number(16);
-                lex_shift();
+            ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+            if (ctx->current_char ==  'H') {
+                ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+                ctx->token_value = read_number(ctx, 16);
+                lex_shift(ctx);
                 return NUMBER;
             }
-            else if (current_char ==  'B') {
-                current_char = lex_readchar(read_arg);
-                token_value = read_number(2);
-                lex_shift();
+            else if (ctx->current_char ==  'B') {
+                ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+                ctx->token_value = read_number(ctx, 2);
+                lex_shift(ctx);
                 return NUMBER;
             }
-            else if (current_char ==  'O') {
-                current_char = lex_readchar(read_arg);
-                token_value = read_number(8);
-                lex_shift();
+            else if (ctx->current_char ==  'O') {
+                ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+                ctx->token_value = read_number(ctx, 8);
+                lex_shift(ctx);
                 return NUMBER;
             }
-            lex_shift();
+            lex_shift(ctx);
             return '&';
 
         case '\r': case '\n':
-            while (current_char == '\r' || current_char == '\n')
-                current_char = lex_readchar(read_arg);
-            lex_shift();
+            while (ctx->current_char == '\r' || ctx->current_char == '\n')
+                ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+            lex_shift(ctx);
             return NEWLINE;
 
         case '\"':
-            token_len = 0;
+            ctx->token_len = 0;
             do {
-                current_char = lex_readchar(read_arg);
-                token_text[token_len++] = (char) current_char;
-            } while (current_char != '\0' && current_char != '\"');
-            token_text[--token_len] = '\0';
+                ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+                lex_store(ctx, ctx->token_len++, ctx->current_char);
+            } while (ctx->current_char != '\0' && ctx->current_char != '\"');
+            lex_store(ctx, --ctx->token_len, '\0');
             return STRING;
 
         case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j':
@@ -413,12 +1283,12 @@ static int ICACHE_FLASH_ATTR lex_next_token(SYMIDX *symidx)
             // keywords and identifiers
 
             do {
-                token_text[i++] = (char) current_char;
-                current_char = lex_readchar(read_arg);
-            } while ((current_char >= 'a' && current_char <= 'z') || (current_char >= 'A' && current_char <= 'Z') || (current_char == '_') || (current_char == '$') || is_digit(current_char));
-            token_text[i] = '\0';
-            lex_shift();
-            *symidx = parse_lookup_symbol(token_text, 0);
+                lex_store(ctx, i++, ctx->current_char);
+                ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+            } while ((ctx->current_char >= 'a' && ctx->current_char <= 'z') || (ctx->current_char >= 'A' && ctx->current_char <= 'Z') || (ctx->current_char == '_') || (ctx->current_char == '$') || is_digit(ctx->current_char));
+            lex_store(ctx, i, '\0');
+            lex_shift(ctx);
+            *symidx = parse_lookup_symbol(ctx, ctx->token_text, 0);
 
             if (*symidx != NULL)
                 return get_symbol(*symidx)->tok;
@@ -427,23 +1297,23 @@ static int ICACHE_FLASH_ATTR lex_next_token(SYMIDX *symidx)
         }
 
         case '<':
-            current_char = lex_readchar(read_arg);
-            if (current_char == '=')
+            ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+            if (ctx->current_char == '=')
                 return LE;
-            else if (current_char == '<')
+            else if (ctx->current_char == '<')
                 return LSH;
-            else if (current_char == '>')
+            else if (ctx->current_char == '>')
                 return NEQ;
-            lex_shift();
+            lex_shift(ctx);
             return LT;
 
         case '>':
-            current_char = lex_readchar(read_arg);
-            if (current_char == '=')
+            ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+            if (ctx->current_char == '=')
                 return GE;
-            else if (current_char == '>')
+            else if (ctx->current_char == '>')
                 return RSH;
-            lex_shift();
+            lex_shift(ctx);
             return GT;
 
         case '=': return EQ;
@@ -459,59 +1329,142 @@ static int ICACHE_FLASH_ATTR lex_next_token(SYMIDX *symidx)
         case ')': return RPAREN;
         case 0: return 0;
         default:
-                parse_error(E_SYNTAX_ERROR);
-                return 0;
+                ctx->token_value = ctx->current_char;
+                return ILLEGAL;
     }
 }
 
-static SYMIDX ICACHE_FLASH_ATTR assign(char *name, int value)
+static void ICACHE_FLASH_ATTR lex_store_text(struct urubasic_ctx *ctx, const unsigned char *s)
 {
-    // assign a value to a variable
-    SYMIDX symidx = parse_lookup_symbol(name, 1);
-    if (get_symbol(symidx)->value_ptr == NULL)
-        get_symbol(symidx)->value_ptr = smemblk_alloc(symbol_names, sizeof(int));
-    *get_symbol(symidx)->value_ptr = value;
-    return symidx;
+    int i;
+
+    for (i=0; s[i] != '\0'; ++i)
+        lex_store(ctx, i, s[i]);
+    lex_store(ctx, i, '\0');
+    ctx->token_len = i;
 }
 
-static int ICACHE_FLASH_ATTR find_insn(int label)
+static int ICACHE_FLASH_ATTR lex_uncrunch(struct urubasic_ctx *ctx, SYMIDX *symidx)
 {
-    // linear search
-    int i;
+    // read one token of a crunched instruction
+    const unsigned char *p = ctx->lex_tokens;
+    int tok = *p++;
 
-    for (i=0; i<insn_count; i++) {
-        if (insn_info[i].label >= label)
-            return i;
-    }
-    return -1;
-}
+    switch (tok) {
+        case 0:
+            return 0;   // stay at the end
 
-static int ICACHE_FLASH_ATTR check_token(int tok, SYMIDX symidx, int expect, int error)
-{
-    if (symidx) {
-        if (error > 0 && get_symbol(symidx)->tok != expect) {
-            parse_error(error);
-            return 0;
-        }
-        return get_symbol(symidx)->tok;
-    }
-    else if (tok != expect) {
+        case NUMBER:
+            ctx->token_value = (int) ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+            p += 4;
+            break;
+
+        case STRING:
+            lex_store_text(ctx, p);
+            p += ctx->token_len + 1;
+            break;
+
+        case IDENTIFIER:
+            *symidx = ctx->slot_table[p[0] | p[1] << 8];
+            p += 2;
+            if (ctx->def_param_count > 0)
+                *symidx = parse_lookup_symbol(ctx, symbol_name(ctx, *symidx), 0);   // parameter of a DEF function
+            lex_store_text(ctx, (const unsigned char *) symbol_name(ctx, *symidx));
+            tok = get_symbol(*symidx)->tok;
+            break;
+
+        case ILLEGAL:
+            ctx->token_value = *p++;
+            break;
+
+        default:
+            if (keyword_index(tok) >= 0)
+                *symidx = std_symbol(keyword_index(tok));
+            break;
+    }
+    ctx->lex_tokens = p;
+    return tok;
+}
+
+static int ICACHE_FLASH_ATTR lex_next_token(struct urubasic_ctx *ctx, SYMIDX *symidx)
+{
+    // read one token of the instruction being compiled or from input stream
+    int tok;
+
+    *symidx = 0;
+    if (!stack_empty(ctx->pushed_token_stack)) {
+        tok = stack_pop(ctx->pushed_token_stack);  // use tok stored on stack
+        return tok;
+    }
+
+    tok = ctx->lex_tokens != NULL ? lex_uncrunch(ctx, symidx) : lex_scan(ctx, symidx);
+    if (tok == ILLEGAL) {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return 0;
+    }
+    return tok;
+}
+
+static int ICACHE_FLASH_ATTR find_insn(struct urubasic_ctx *ctx, int label)
+{
+    // first instruction with a label >= label, binary search on label_max
+    int lo = 0, hi = ctx->insn_count, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (ctx->insn_info[mid].label_max >= label)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo < ctx->insn_count ? lo : -1;
+}
+
+static void ICACHE_FLASH_ATTR index_insns(struct urubasic_ctx *ctx)
+{
+    // build the control flow index of the loaded program
+    int insn, label_max = -CODE_MAX - 1;
+
+    for (insn=0; insn<ctx->insn_count; ++insn) {
+        if (ctx->insn_info[insn].label > label_max)
+            label_max = ctx->insn_info[insn].label;
+        ctx->insn_info[insn].label_max = (code_t) label_max;
+    }
+
+    for (insn=ctx->insn_count-1; insn>=0; --insn) {
+        if (insn+1 >= ctx->insn_count || ctx->insn_info[insn+1].sep != ':')
+            ctx->insn_info[insn].next = (code_t) (insn+1);
+        else
+            ctx->insn_info[insn].next = ctx->insn_info[insn+1].next;
+    }
+}
+
+static int ICACHE_FLASH_ATTR check_token(struct urubasic_ctx *ctx, int tok, SYMIDX symidx, int expect, int error)
+{
+    if (symidx) {
+        if (error > 0 && get_symbol(symidx)->tok != expect) {
+            parse_error(ctx, error);
+            return 0;
+        }
+        return get_symbol(symidx)->tok;
+    }
+    else if (tok != expect) {
         if (error > 0)
-            parse_error(error);
+            parse_error(ctx, error);
         return 0;
     }
     else
         return tok;
 }
 
-static int ICACHE_FLASH_ATTR parse_check_unary(int c, int last)
+static int ICACHE_FLASH_ATTR parse_check_unary(struct urubasic_ctx *ctx, int c, int last)
 {
     if (c == MINUS || c == PLUS) {
-        if (check_token(last, NULL, NUMBER, 0) == NUMBER
-            || check_token(last, NULL, STRING, 0) == STRING
-            || check_token(last, NULL, IDENTIFIER, 0) == IDENTIFIER
-            || check_token(last, NULL, FUNCTION, 0) == FUNCTION
-            || check_token(last, NULL, RPAREN, 0) == RPAREN)
+        if (check_token(ctx, last, NULL, NUMBER, 0) == NUMBER
+            || check_token(ctx, last, NULL, STRING, 0) == STRING
+            || check_token(ctx, last, NULL, IDENTIFIER, 0) == IDENTIFIER
+            || check_token(ctx, last, NULL, FUNCTION, 0) == FUNCTION
+            || check_token(ctx, last, NULL, RPAREN, 0) == RPAREN)
             return 0;
 
         return UNARY;
@@ -552,183 +1505,336 @@ static int ICACHE_FLASH_ATTR power(int base, int exp)
     return res;
 }
 
-static void ICACHE_FLASH_ATTR reduce(int *arg_stack, int *operator_stack)
+static int ICACHE_FLASH_ATTR code_eval(int opcode, int a, int b, int *result)
 {
-    int v1 = 0, v2 = 0, type1, type2 = 0;
-    int op = stack_pop(operator_stack);
+    // the VM operation on numbers, 0 if it has to be left to run time
+    unsigned int x = (unsigned int) a, y = (unsigned int) b;
+
+    switch (opcode) {
+        case OP_NEG: *result = (int) (0u - x); break;
+        case OP_NOT: *result = ~a; break;
+        case OP_ADD: *result = (int) (x + y); break;
+        case OP_SUB: *result = (int) (x - y); break;
+        case OP_MUL: *result = (int) (x * y); break;
+        case OP_DIV:
+            if (b == 0 || (a == INT_MIN && b == -1))
+                return 0;
+            *result = a / b;
+            break;
+        case OP_POW:
+            if (b > 32)     // power() loops b times
+                return 0;
+            *result = power(a, b);
+            break;
+        case OP_LT:  *result = a < b ? -1 : 0; break;
+        case OP_LE:  *result = a <= b ? -1 : 0; break;
+        case OP_GT:  *result = a > b ? -1 : 0; break;
+        case OP_GE:  *result = a >= b ? -1 : 0; break;
+        case OP_EQ:  *result = a == b ? -1 : 0; break;
+        case OP_NEQ: *result = a != b ? -1 : 0; break;
+        case OP_AND: *result = a & b; break;
+        case OP_OR:  *result = a | b; break;
+        default:     return 0;
+    }
+    return 1;
+}
 
-    if (!(op & UNARY)) {
-        type2 = stack_pop(arg_stack);  // type
-        v2 = stack_empty(arg_stack) ? 0 : stack_pop(arg_stack);
+static void ICACHE_FLASH_ATTR code_emit(struct urubasic_ctx *ctx, int c)
+{
+    // append one word to the compiled program
+    if (ctx->code_len >= ctx->code_max) {
+        code_t *p = NULL;
+
+        // the loop chain keeps code offsets in code words
+        if (!ctx->compile_failed && (ctx->code_max + CODE_CHUNK >= CODE_MAX || (ctx->code_max + CODE_CHUNK) * sizeof(code_t) >= SMEMBLK_MAX_SIZE))
+            parse_error(ctx, E_PROGRAM_TOO_LARGE);
+        else if (!ctx->compile_failed && (p = smemblk_realloc(ctx->symbol_names, ctx->code, (smemblk_size_t) ((ctx->code_max + CODE_CHUNK) * sizeof(code_t)))) == NULL)
+            parse_error(ctx, E_OUT_OF_MEMORY);
+        if (p == NULL) {
+            ctx->compile_failed = 1;
+            return;
+        }
+        ctx->code = p;
+        ctx->code_max += CODE_CHUNK;
     }
+    ctx->code[ctx->code_len++] = (code_t) c;
+}
 
-    type1 = stack_pop(arg_stack);  // type
-    v1 = stack_empty(arg_stack) ? 0 : stack_pop(arg_stack);
+static void ICACHE_FLASH_ATTR code_emit_op(struct urubasic_ctx *ctx, int op, int stack_effect)
+{
+    // append an opcode and keep track of the stack depth
+    ctx->code_op[0] = ctx->code_op[1];
+    ctx->code_op[1] = ctx->code_len;
+    code_emit(ctx, op);
+    ctx->code_depth += stack_effect;
+    if (ctx->code_depth > ctx->code_max_depth)
+        ctx->code_max_depth = ctx->code_depth;
+}
 
-    if (type1 == NUMBER && (type2 == NUMBER || type2 == 0)) {
-        switch (op) {
-            case MULT:            stack_push(arg_stack, v1*v2); break;
-            case CIRCUMFLEX:      stack_push(arg_stack, power(v1, v2)); break;
-            case PLUS:            stack_push(arg_stack, v1+v2); break;
-            case MINUS:           stack_push(arg_stack, v1-v2); break;
-            case SOLIDUS:         stack_push(arg_stack, v1/v2); break;
-            case (UNARY | MINUS): stack_push(arg_stack, -v1); break;
-            case (UNARY | PLUS):  stack_push(arg_stack, v1); break;
-            case GT:              stack_push(arg_stack, v1>v2 ? -1 : 0); break;
-            case LT:              stack_push(arg_stack, v1<v2 ? -1 : 0); break;
-            case LE:              stack_push(arg_stack, v1<=v2 ? -1 : 0); break;
-            case GE:              stack_push(arg_stack, v1>=v2 ? -1 : 0); break;
-            case EQ:              stack_push(arg_stack, v1==v2 ? -1 : 0); break;
-            case NEQ:             stack_push(arg_stack, v1!=v2 ? -1 : 0); break;
-            case AND:             stack_push(arg_stack, v1&v2); break;
-            case NOT:
-            case (UNARY|NOT):     stack_push(arg_stack, ~v1); break;
-            case OR:              stack_push(arg_stack, v1|v2); break;
-            default: stack_push(arg_stack, 0); break;
-        }
-        stack_push(arg_stack, NUMBER);
+static void ICACHE_FLASH_ATTR code_emit32(struct urubasic_ctx *ctx, int value)
+{
+    code_emit(ctx, value & 0xffff);
+    code_emit(ctx, (value >> 16) & 0xffff);
+}
+
+static void ICACHE_FLASH_ATTR code_set32(struct urubasic_ctx *ctx, int offset, int value)
+{
+    if (!ctx->compile_failed) {
+        ctx->code[offset]   = (code_t) (value & 0xffff);
+        ctx->code[offset+1] = (code_t) ((value >> 16) & 0xffff);
     }
-    else if ((type1 & 0xff) == STRING && (type2 & 0xff) == STRING) {
-        if (op == PLUS) {
-            char *string = smemblk_alloc(symbol_names, (int16_t) (1 + strlen((char*)symbol_names+v1) + strlen((char*)symbol_names+v2)));
-            if (string != NULL) {
-                strcpy(string, (char*)symbol_names+v1);
-                strcat(string, (char*)symbol_names+v2);
-            }
+}
 
-            if (ALLOC & type1) smemblk_free(symbol_names, (char*)symbol_names+v1);
-            if (ALLOC & type2) smemblk_free(symbol_names, (char*)symbol_names+v2);
-            stack_push(arg_stack, string-(char*)symbol_names);
-            stack_push(arg_stack, STRING|ALLOC);
-        }
-        else if (op == EQ) {
-            stack_push(arg_stack, 0 == strcmp((char*)symbol_names+v1, (char*)symbol_names+v2));
-            stack_push(arg_stack, NUMBER);
-            if (ALLOC & type1) smemblk_free(symbol_names, (char*)symbol_names+v1);
-            if (ALLOC & type2) smemblk_free(symbol_names, (char*)symbol_names+v2);
-        }
-        else if (op == NEQ) {
-            stack_push(arg_stack, 0 != strcmp((char*)symbol_names+v1, (char*)symbol_names+v2));
-            stack_push(arg_stack, NUMBER);
-            if (ALLOC & type1) smemblk_free(symbol_names, (char*)symbol_names+v1);
-            if (ALLOC & type2) smemblk_free(symbol_names, (char*)symbol_names+v2);
+static int ICACHE_FLASH_ATTR code_get32(code_t *p)
+{
+    return (int) ((uint32_t) (uint16_t) p[0] | ((uint32_t) (uint16_t) p[1] << 16));
+}
+
+static void ICACHE_FLASH_ATTR code_insert(struct urubasic_ctx *ctx, int offset, int n)
+{
+    // make room for n words at offset, the code behind moves
+    int i;
+
+    for (i=0; i<n; ++i)
+        code_emit(ctx, OP_STOP);
+    if (!ctx->compile_failed)
+        memmove(&ctx->code[offset+n], &ctx->code[offset], (ctx->code_len - n - offset) * sizeof(code_t));
+}
+
+static int ICACHE_FLASH_ATTR code_is_var_op_number(struct urubasic_ctx *ctx, int start)
+{
+    // whether the code from start is "variable op number", returns op
+    if (ctx->compile_failed || ctx->code_len < start + 6 || ctx->code[start] != OP_LOADVAR || ctx->code[start+2] != OP_PUSHNUM)
+        return -1;
+    return ctx->code[start+5];
+}
+
+static int ICACHE_FLASH_ATTR code_op_len(code_t *p);
+static int ICACHE_FLASH_ATTR code_op_stack(code_t *p, int *pops);
+
+static int ICACHE_FLASH_ATTR code_is_append(struct urubasic_ctx *ctx, int start, int slot)
+{
+    // whether the code from start is "variable + expression" of the variable in slot
+    int o, n, pops, depth = 0;
+
+    if (ctx->compile_failed || ctx->code_len < start + 4 || ctx->code[start] != OP_LOADVAR || ctx->code[start+1] != slot
+        || ctx->code_op[1] != ctx->code_len - 1 || ctx->code[ctx->code_len-1] != OP_ADD)
+        return 0;
+
+    // the expression leaves one value and does not take the variable
+    for (o=start+2; o<ctx->code_len-1; o+=code_op_len(ctx->code + o)) {
+        n = code_op_stack(ctx->code + o, &pops);
+        if (depth < pops)
+            return 0;
+        depth += n - pops;
+    }
+    return depth == 1 && o == ctx->code_len - 1;
+}
+
+static int ICACHE_FLASH_ATTR code_slot(struct urubasic_ctx *ctx, SYMIDX symidx)
+{
+    // the slot of a symbol is assigned on first reference, keywords in
+    // std_symbols[] are read-only and never get one
+    if (get_symbol(symidx)->name < 0)
+        return 0;
+    if (symidx->slot == 0) {
+        if (ctx->slot_count + 1 >= ctx->slot_max) {
+            SYMIDX *p = NULL;
+
+            // a slot is a 16-bit index in the symbol and in the crunched program
+            if (!ctx->compile_failed && (ctx->slot_max + SLOT_CHUNK >= 0x7fff || (ctx->slot_max + SLOT_CHUNK) * sizeof(SYMIDX) >= SMEMBLK_MAX_SIZE))
+                parse_error(ctx, E_PROGRAM_TOO_LARGE);
+            else if (!ctx->compile_failed && (p = smemblk_realloc(ctx->symbol_names, ctx->slot_table, (smemblk_size_t) ((ctx->slot_max + SLOT_CHUNK) * sizeof(SYMIDX)))) == NULL)
+                parse_error(ctx, E_OUT_OF_MEMORY);
+            if (p == NULL) {
+                ctx->compile_failed = 1;
+                return 0;
+            }
+            ctx->slot_table = p;
+            ctx->slot_max += SLOT_CHUNK;
         }
+        ctx->slot_table[++ctx->slot_count] = symidx;
+        symidx->slot = ctx->slot_count;
     }
-    else
-        parse_error(E_SYNTAX_ERROR);
+    return symidx->slot;
+}
+
+static void ICACHE_FLASH_ATTR code_emit_symbol(struct urubasic_ctx *ctx, SYMIDX symidx)
+{
+    code_emit(ctx, code_slot(ctx, symidx));
+}
+
+static SYMIDX ICACHE_FLASH_ATTR code_symbol(struct urubasic_ctx *ctx, code_t c)
+{
+    return ctx->slot_table[c];
+}
+
+static int ICACHE_FLASH_ATTR const_string(struct urubasic_ctx *ctx, const char *text, int len)
+{
+    // store the text in the constant pool once and return its offset, the
+    // entries have the header of a string. E_OUT_OF_MEMORY or
+    // E_PROGRAM_TOO_LARGE negated when the pool cannot grow
+    int size = string_size(len), offset;
+    struct String *s;
+    char *p;
+
+    for (offset=0; offset<ctx->const_len; offset += string_size(s->len)) {
+        s = (struct String *) &ctx->const_pool[offset];
+        if (s->len == len && 0 == memcmp(s + 1, text, (size_t) len))
+            return offset + (int) sizeof(struct String);
+    }
+
+    if (ctx->const_len + size > ctx->const_max) {
+        // offsets in the pool have to fit into a code word
+        if (ctx->const_len + size + CONST_CHUNK >= CODE_MAX || ctx->const_len + size + CONST_CHUNK >= SMEMBLK_MAX_SIZE)
+            return -E_PROGRAM_TOO_LARGE;
+        p = smemblk_realloc(ctx->symbol_names, ctx->const_pool, (smemblk_size_t) (ctx->const_len + size + CONST_CHUNK));
+        if (p == NULL)
+            return -E_OUT_OF_MEMORY;
+        ctx->const_pool = p;
+        ctx->const_max = ctx->const_len + size + CONST_CHUNK;
+    }
+    s = (struct String *) &ctx->const_pool[ctx->const_len];
+    s->len  = (smemblk_size_t) len;
+    s->refs = 0;
+    memcpy(s + 1, text, (size_t) len);
+    ((char *) (s + 1))[len] = '\0';
+    ctx->const_len += size;
+    return (int) ((char *) (s + 1) - ctx->const_pool);
+}
+
+static void ICACHE_FLASH_ATTR code_emit_string(struct urubasic_ctx *ctx, char *text)
+{
+    // the code refers to the text in the constant pool by its offset
+    int offset = const_string(ctx, text, (int) strlen(text));
+
+    if (offset < 0) {
+        if (!ctx->compile_failed)
+            parse_error(ctx, -offset);
+        ctx->compile_failed = 1;
+        return;
+    }
+    code_emit(ctx, offset);
+}
+
+static int ICACHE_FLASH_ATTR code_fold(struct urubasic_ctx *ctx, int opcode, int unary)
+{
+    // an operator on numbers which were just pushed is evaluated now, the
+    // result replaces the numbers. returns 1 if it is folded
+    int last = ctx->code_op[1], prev = ctx->code_op[0], a, b;
+
+    if (ctx->optimize < 1 || ctx->compile_failed || last + 3 != ctx->code_len || ctx->code[last] != OP_PUSHNUM)
+        return 0;
+    if (!unary && (prev + 3 != last || ctx->code[prev] != OP_PUSHNUM))
+        return 0;
+    b = code_get32(&ctx->code[last+1]);
+    a = unary ? b : code_get32(&ctx->code[prev+1]);
+    if (!code_eval(opcode, a, b, &a))
+        return 0;
+    if (!unary) {
+        ctx->code_len   = last;
+        ctx->code_op[1] = prev;
+        ctx->code_op[0] = -1;
+        ctx->code_depth -= 1;
+    }
+    code_set32(ctx, ctx->code_len - 2, a);
+    return 1;
+}
+
+static int ICACHE_FLASH_ATTR compile_operator(struct urubasic_ctx *ctx, int op, int values)
+{
+    // emit the code of an operator, returns the number of values left on the stack
+    int opcode, unary = 0;
+
+    switch (op) {
+        case (UNARY | PLUS):  opcode = -1; unary = 1; break;
+        case (UNARY | MINUS): opcode = OP_NEG; unary = 1; break;
+        case NOT:
+        case (UNARY | NOT):   opcode = OP_NOT; unary = 1; break;
+        case MULT:            opcode = OP_MUL; break;
+        case CIRCUMFLEX:      opcode = OP_POW; break;
+        case PLUS:            opcode = OP_ADD; break;
+        case MINUS:           opcode = OP_SUB; break;
+        case SOLIDUS:         opcode = OP_DIV; break;
+        case GT:              opcode = OP_GT; break;
+        case LT:              opcode = OP_LT; break;
+        case LE:              opcode = OP_LE; break;
+        case GE:              opcode = OP_GE; break;
+        case EQ:              opcode = OP_EQ; break;
+        case NEQ:             opcode = OP_NEQ; break;
+        case AND:             opcode = OP_AND; break;
+        case OR:              opcode = OP_OR; break;
+        default:
+            parse_error(ctx, E_SYNTAX_ERROR);
+            return values;
+    }
+
+    if (values < 2 - unary) {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return values;
+    }
+
+    if (opcode >= 0 && !code_fold(ctx, opcode, unary))
+        code_emit_op(ctx, opcode, unary - 1);
+    return values + unary - 1;
 }
 
-static int ICACHE_FLASH_ATTR expr(struct urubasic_type *tval);
+static int ICACHE_FLASH_ATTR compile_expr(struct urubasic_ctx *ctx);
 
-static int ICACHE_FLASH_ATTR function_call(SYMIDX symidx, int paren_optional, struct urubasic_type *retval)
+static int ICACHE_FLASH_ATTR compile_function_call(struct urubasic_ctx *ctx, SYMIDX symidx, int paren_optional)
 {
-    int tok, i, n = 1, val, to_be_pushed = 0;
+    // arguments are pushed on the stack, builtin functions get an extra slot for the return value
+    int tok, n = 0, errors = ctx->error_count;
     SYMIDX dummy;
     int endtok = RPAREN;
-    struct urubasic_type tval = { 0, }, arg[MAX_FUNCTION_ARGS+1];
 
-    tok = lex_next_token(&dummy);
-    if (LPAREN != check_token(tok, NULL, LPAREN, 0) && paren_optional)
-        endtok = NEWLINE;
+    if (get_symbol(symidx)->func != 0)
+        code_emit_op(ctx, OP_PUSHNIL, 1);
 
-    arg[0].type = arg[0].value = 0;  // return value
+    tok = lex_next_token(ctx, &dummy);
+    if (LPAREN != check_token(ctx, tok, NULL, LPAREN, 0) && paren_optional)
+        endtok = NEWLINE;
 
-    if (endtok == NEWLINE || LPAREN == check_token(tok, NULL, LPAREN, 0)) {
+    if (endtok == NEWLINE || LPAREN == check_token(ctx, tok, NULL, LPAREN, 0)) {
         if (endtok != NEWLINE)
-            tok = lex_next_token(&dummy);
-        while (endtok != check_token(tok, NULL, endtok, 0)) {
-            lex_push_token(tok);
-            if (tok == COLON)
+            tok = lex_next_token(ctx, &dummy);
+        while (endtok != check_token(ctx, tok, NULL, endtok, 0)) {
+            lex_push_token(ctx, tok);
+            if (tok == COLON || tok == NEWLINE || tok == 0) {
+                if (endtok == RPAREN)
+                    parse_error(ctx, E_MISSING_RPAREN);
+                break;
+            }
+            compile_expr(ctx);
+            ++n;
+            if (errors != ctx->error_count)
                 break;
-            expr(&tval);
-            if (n < MAX_FUNCTION_ARGS)
-                arg[n++] = tval;
-            tok = lex_next_token(&dummy);
-            if (COMMA == check_token(tok, NULL, COMMA, 0))
-                tok = lex_next_token(&dummy);
+            tok = lex_next_token(ctx, &dummy);
+            if (COMMA == check_token(ctx, tok, NULL, COMMA, 0))
+                tok = lex_next_token(ctx, &dummy);
         }
     }
     else
-        to_be_pushed = tok;
-
-    if (get_symbol(symidx)->func == NULL) {
-        // user supplied function
-        char *old_input_buffer = lex_input_buffer, var[MAX_LINE_LEN];
-        SYMIDX old_extra = extra_table;
-
-        // setup up lexer to read the DEF statement
-        lex_clear();
-        pushed_token_stack[0] = 0;
-        if (get_symbol(symidx)->value_ptr == NULL)
-            parse_error(E_SYNTAX_ERROR);
-        else
-            lex_input_buffer = insn_info[*get_symbol(symidx)->value_ptr].line;
-        tok = lex_next_token(&dummy);
-        check_token(tok, dummy, DEF, E_MISSING_DEF);
-        tok = lex_next_token(&dummy);
-        check_token(tok, dummy, FUNCTION, E_MISSING_IDENTIFIER);
-
-        tok = lex_next_token(&dummy);
-        if (LPAREN == check_token(tok, dummy, LPAREN, 0)) {
-            tok = lex_next_token(&dummy);
-            while (RPAREN != check_token(tok, dummy, RPAREN, 0)) {
-                check_token(tok, dummy, IDENTIFIER, E_MISSING_IDENTIFIER);
-                strcpy(var, token_text);
-                tok = lex_next_token(&dummy);
-                if (COMMA == check_token(tok, dummy, COMMA, 0))
-                    tok = lex_next_token(&dummy);
-            }
-        }
-        else
-            lex_push_token(tok);
-
-        tok = lex_next_token(&dummy);
-        check_token(tok, NULL, EQ, E_MISSING_EQUALSIGN);
-        symidx = parse_add_extra_symbol(var);
-        if (get_symbol(symidx)->value_ptr == NULL)
-            get_symbol(symidx)->value_ptr = smemblk_alloc(symbol_names, sizeof(int));
-        *get_symbol(symidx)->value_ptr = arg[1].value;  // add the actual parameter as a symbol
-        expr(retval); // evaluate the def statement
-        val = retval->value;
-
-        // revert the lexer back to original input stream
-        lex_clear();
-        pushed_token_stack[0] = 0;
-        lex_input_buffer = old_input_buffer;
-        smemblk_free(symbol_names, get_symbol(symidx)->value_ptr);
-        get_symbol(symidx)->value_ptr = NULL;
-
-        // remove actual parameter from symbol table
-        while (extra_table != old_extra) {
-            SYMIDX p = extra_table;;
-            extra_table = p->next;
-            smemblk_free(symbol_names, p);
-        }
+        lex_push_token(ctx, tok);
 
-        if (to_be_pushed)
-            lex_push_token(to_be_pushed);
+    if (get_symbol(symidx)->func != 0) {
+        code_emit_op(ctx, OP_CALL, -n);
+        code_emit_symbol(ctx, symidx);
+        code_emit(ctx, n);
     }
     else {
-        // builtin function
-        if (to_be_pushed)
-            lex_push_token(to_be_pushed);
-        val = get_symbol(symidx)->func(n, arg, (void *) get_symbol(symidx)->value_ptr);
-
-        for (i=1; i<n; i++) {
-            if (arg[i].type == (STRING|ALLOC))
-                smemblk_free(symbol_names, (char *) symbol_names + arg[i].value);
-        }
-        retval->type  = arg[0].type;
-        retval->value = arg[0].value;
+        code_emit_op(ctx, OP_CALLDEF, 1 - n);
+        code_emit_symbol(ctx, symidx);
+        code_emit(ctx, n);
     }
 
-    return val;
+    return n;
 }
 
-static void ICACHE_FLASH_ATTR lex_next_token_expr(int *tok, int *last, int *paren_depth, SYMIDX *symidx)
+static void ICACHE_FLASH_ATTR lex_next_token_expr(struct urubasic_ctx *ctx, int *tok, int *last, int *paren_depth, SYMIDX *symidx)
 {
     if (last) *last = *tok;
-    *tok = lex_next_token(symidx);
+    *tok = lex_next_token(ctx, symidx);
     if (*tok != 0 && *symidx != NULL && (is_logop(get_symbol(*symidx)->tok)))
         *tok = get_symbol(*symidx)->tok;
     if (paren_depth) {
@@ -737,321 +1843,355 @@ static void ICACHE_FLASH_ATTR lex_next_token_expr(int *tok, int *last, int *pare
     }
 }
 
-static int * ICACHE_FLASH_ATTR parse_subscript(SYMIDX symidx)
+static int ICACHE_FLASH_ATTR compile_param(struct urubasic_ctx *ctx, SYMIDX symidx)
 {
-    int tok, x = option_base, y = option_base, size = 1, array_base_size = 0;
-    SYMIDX dummy;
-    struct urubasic_type tval = { 0, };
-
-    tok = lex_next_token(&dummy);
-    if (LPAREN == check_token(tok, dummy, LPAREN, 0)) {
-        expr(&tval);
-        x = tval.value;
-        array_base_size = size = 11 - option_base;
-        tok = lex_next_token(&dummy);
-        if (COMMA == check_token(tok, dummy, COMMA, 0)) {
-            expr(&tval);
-            y = tval.value;
-            size *= 11 - option_base;
-            tok = lex_next_token(&dummy);
-        }
-        check_token(tok, dummy, RPAREN, E_MISSING_RPAREN);
-    }
-    else
-        lex_push_token(tok);
+    // check whether symidx is a parameter of the DEF function being compiled
+    int i;
 
-    if (symidx && get_symbol(symidx)->value_ptr == NULL) {
-        if ((y - option_base) + (x - option_base) >= size) {
-            parse_error(E_INDEX_OUT_OF_BOUNDS);
-            return NULL;
-        }
-
-        get_symbol(symidx)->value_ptr = smemblk_zalloc(symbol_names, (int16_t) (size * sizeof(int)));
-        get_symbol(symidx)->array_base_size = array_base_size;
+    for (i=0; i<ctx->def_param_count; ++i) {
+        if (ctx->def_params[i] == symidx)
+            return 1;
     }
+    return 0;
+}
 
-    if (symidx)
-        return get_symbol(symidx)->value_ptr + get_symbol(symidx)->array_base_size * (y - option_base) + (x - option_base);
+static int ICACHE_FLASH_ATTR compile_subscript(struct urubasic_ctx *ctx)
+{
+    // compile the optional subscripts of a variable, returns the number of dimensions
+    int tok, dims = 0;
+    SYMIDX dummy;
+
+    tok = lex_next_token(ctx, &dummy);
+    if (LPAREN == check_token(ctx, tok, dummy, LPAREN, 0)) {
+        compile_expr(ctx);
+        dims = 1;
+        tok = lex_next_token(ctx, &dummy);
+        if (COMMA == check_token(ctx, tok, dummy, COMMA, 0)) {
+            compile_expr(ctx);
+            dims = 2;
+            tok = lex_next_token(ctx, &dummy);
+        }
+        check_token(ctx, tok, dummy, RPAREN, E_MISSING_RPAREN);
+    }
     else
-        return NULL;
+        lex_push_token(ctx, tok);
+
+    return dims;
 }
 
-static int ICACHE_FLASH_ATTR expr(struct urubasic_type *tval)
+static int ICACHE_FLASH_ATTR compile_expr(struct urubasic_ctx *ctx)
 {
-    int tok, arg_stack[1+2*EXPR_STACK_SIZE], operator_stack[1+EXPR_STACK_SIZE];
-    int last_sym, paren_depth;
+    // shunting yard: operands are emitted immediately, operators by precedence
+    int tok, *operator_stack, stack_max = EXPR_STACK_SIZE;
+    int last_sym, paren_depth, values, errors = ctx->error_count;
     SYMIDX symidx;
 
-    last_sym = paren_depth = tok = 0;
-    arg_stack[0] = 0;           // stack empty
+    operator_stack = smemblk_alloc(ctx->symbol_names, (1 + stack_max) * sizeof(int));
+    if (operator_stack == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return 0;
+    }
+
+    last_sym = paren_depth = tok = values = 0;
     operator_stack[0] = 0;      // stack_empty
 
-	lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
+	lex_next_token_expr(ctx, &tok, &last_sym, &paren_depth, &symidx);
     while ((tok != RPAREN || paren_depth >= 0) && tok != NEWLINE && tok != 0 && tok != THEN && tok != COMMA && tok != COLON && tok != SEMICOLON && !(tok < NUM_KEYWORDS || is_keyword(symidx))) {
-        if (IDENTIFIER == check_token(tok, symidx, IDENTIFIER, 0)) {
-            int *value_ptr;
+        if (IDENTIFIER == check_token(ctx, tok, symidx, IDENTIFIER, 0)) {
+            int dims;
             if (symidx == 0)
-                symidx = parse_lookup_symbol(token_text, 1);
-            if (symidx != NULL) {
-                if ((get_symbol(symidx)->value_type & 0xff) == STRING) {
-                    char *string = (char *) get_symbol(symidx)->value_ptr;
-                    stack_push(arg_stack, string-(char *)symbol_names);
-                    stack_push(arg_stack, STRING);
-                }
-                else {
-                    value_ptr = parse_subscript(symidx);
-                    if (value_ptr != NULL) {
-                        stack_push(arg_stack, *value_ptr);
-                        stack_push(arg_stack, NUMBER);
-                    }
-                }
+                symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+            if (symidx != NULL && compile_param(ctx, symidx)) {
+                code_emit_op(ctx, OP_LOADPARAM, 1);
+                code_emit(ctx, get_symbol(symidx)->array_base_size);
             }
-            lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
+            else if (symidx != NULL) {
+                dims = compile_subscript(ctx);
+                code_emit_op(ctx, dims == 0 ? OP_LOADVAR : (dims == 1 ? OP_LOADARR1 : OP_LOADARR2), 1 - dims);
+                code_emit_symbol(ctx, symidx);
+            }
+            else
+                parse_error(ctx, E_OUT_OF_MEMORY);
+            ++values;
+            lex_next_token_expr(ctx, &tok, &last_sym, &paren_depth, &symidx);
         }
-        else if (FUNCTION == check_token(tok, symidx, FUNCTION, 0)) {
-            struct urubasic_type tval;
+        else if (FUNCTION == check_token(ctx, tok, symidx, FUNCTION, 0)) {
             if (symidx == 0)
-                symidx = parse_lookup_symbol(token_text, 1);
-            function_call(symidx, 0, &tval);
-            stack_push(arg_stack, tval.value);
-            stack_push(arg_stack, tval.type);
-            lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
-        }
-        else if (NUMBER == check_token(tok, symidx, NUMBER, 0)) {
-            stack_push(arg_stack, token_value);
-            stack_push(arg_stack, NUMBER);
-            lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
-        }
-        else if (STRING == check_token(tok, symidx, STRING, 0)) {
-            char *string = smemblk_alloc(symbol_names, (int16_t) (strlen(token_text)+1));
-            if (string != NULL) {
-                strcpy(string, token_text);
-                stack_push(arg_stack, string-(char *)symbol_names);
-                stack_push(arg_stack, STRING|ALLOC);  // mark constant string as allocated
-            }
-            lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
+                symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+            compile_function_call(ctx, symidx, 0);
+            ++values;
+            lex_next_token_expr(ctx, &tok, &last_sym, &paren_depth, &symidx);
+        }
+        else if (NUMBER == check_token(ctx, tok, symidx, NUMBER, 0)) {
+            code_emit_op(ctx, OP_PUSHNUM, 1);
+            code_emit32(ctx, ctx->token_value);
+            ++values;
+            lex_next_token_expr(ctx, &tok, &last_sym, &paren_depth, &symidx);
+        }
+        else if (STRING == check_token(ctx, tok, symidx, STRING, 0)) {
+            code_emit_op(ctx, OP_PUSHSTR, 1);
+            code_emit_string(ctx, ctx->token_text);
+            ++values;
+            lex_next_token_expr(ctx, &tok, &last_sym, &paren_depth, &symidx);
+        }
+        else if (tok == RPAREN && LPAREN == stack_top(operator_stack, 0)) {
+            // all operators inside of the parentheses are reduced
+            stack_pop(operator_stack);
+            lex_next_token_expr(ctx, &tok, &last_sym, &paren_depth, &symidx);
         }
         else {
+            int prec_top, prec_cur, assoc, dummy, shift = 1;
+
             if (tok != LPAREN && !stack_empty(operator_stack)) {
-                int prec_top, prec_cur, assoc, dummy;
                 prec_top = parse_precedence(stack_top(operator_stack, 0), &assoc);
-                prec_cur = parse_precedence(tok | parse_check_unary(tok, last_sym), &dummy);
+                prec_cur = parse_precedence(tok | parse_check_unary(ctx, tok, last_sym), &dummy);
+                shift = prec_top > prec_cur || (prec_top == prec_cur && assoc == 1);
+            }
 
-                if (prec_top > prec_cur || (prec_top == prec_cur && assoc == 1)) {
-                    // shift
-                    tok |= parse_check_unary(tok, last_sym);
-                    stack_push(operator_stack, tok);
-                    lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
-                }
+            if (!shift)
+                values = compile_operator(ctx, stack_pop(operator_stack), values);
+            else if (operator_stack[0] >= stack_max) {
+                // the operator stack grows with the nesting of the expression
+                int *p = NULL;
+
+                if ((1 + stack_max + EXPR_STACK_SIZE) * sizeof(int) < SMEMBLK_MAX_SIZE)
+                    p = smemblk_realloc(ctx->symbol_names, operator_stack, (smemblk_size_t) ((1 + stack_max + EXPR_STACK_SIZE) * sizeof(int)));
+                if (p == NULL)
+                    parse_error(ctx, E_OUT_OF_MEMORY);
                 else {
-                    reduce(arg_stack, operator_stack);
-                    if (tok == RPAREN && LPAREN == stack_top(operator_stack, 0)) {
-                        stack_pop(operator_stack);
-                        lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
-                    }
+                    operator_stack = p;
+                    stack_max += EXPR_STACK_SIZE;
                 }
             }
             else {
-                // shift
-                tok |= parse_check_unary(tok, last_sym);
+                tok |= parse_check_unary(ctx, tok, last_sym);
                 stack_push(operator_stack, tok);
-                lex_next_token_expr(&tok, &last_sym, &paren_depth, &symidx);
+                lex_next_token_expr(ctx, &tok, &last_sym, &paren_depth, &symidx);
             }
         }
+        if (errors != ctx->error_count)
+            break;
     }
 
-    while (!stack_empty(operator_stack)) {
-        reduce(arg_stack, operator_stack);
-    }
-    lex_push_token(tok);
-    tval->type     = stack_pop(arg_stack);
-    tval->value    = stack_pop(arg_stack);
-    return tval->type;
+    while (!stack_empty(operator_stack) && errors == ctx->error_count)
+        values = compile_operator(ctx, stack_pop(operator_stack), values);
+    smemblk_free(ctx->symbol_names, operator_stack);
+    lex_push_token(ctx, tok);
+    if (values != 1 && errors == ctx->error_count)
+        parse_error(ctx, E_SYNTAX_ERROR);
+    return values;
 }
 
-static int ICACHE_FLASH_ATTR stmt(int insn);
-
-static int ICACHE_FLASH_ATTR func_abs(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_abs(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     arg[0].type = NUMBER;
     arg[0].value = arg[1].value >= 0 ? arg[1].value : -arg[1].value;
     return arg[0].value;
 }
 
-static int ICACHE_FLASH_ATTR func_sgn(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_sgn(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     arg[0].type = NUMBER;
     arg[0].value = arg[1].value > 0 ? 1 : (arg[1].value < 0 ? -1 : 0);
     return arg[0].value;
 }
 
-static int ICACHE_FLASH_ATTR stmt_rem(int insn, struct urubasic_type *arg, void *user)  { return ++insn; }
-static int ICACHE_FLASH_ATTR stmt_stop(int insn, struct urubasic_type *arg, void *user) { return -1; }
-
-static int ICACHE_FLASH_ATTR func_len(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_len(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     int result;
 
-    if (n < 2 || (arg[1].type & 0xff) != STRING)
-        parse_error(E_SYNTAX_ERROR);
+    if (n < 2 || (arg[1].type & 0xff) != STRING) {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return urubasic_set_number(&arg[0], 0);
+    }
 
-    result = strlen((char *) symbol_names + arg[1].value);
+    result = string_len(ctx, arg[1].value);
     arg[0].value = result;
     arg[0].type = NUMBER;
     return result;
 }
 
-static int ICACHE_FLASH_ATTR func_chrS(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_chrS(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     char *string;
 
     if (n < 2 || (arg[1].type & 0xff) != NUMBER)
-        parse_error(E_SYNTAX_ERROR);
+        parse_error(ctx, E_SYNTAX_ERROR);
 
-    string = smemblk_alloc(symbol_names, 2);
-    string[0] = arg[1].value & 0xff;
-    string[1] = '\0';
-    arg[0].type = STRING|ALLOC;
-    arg[0].value = string-(char *)symbol_names;
+    // a NUL ends the text, CHR$(0) is empty
+    string = string_alloc(ctx, &arg[0], (arg[1].value & 0xff) != 0);
+    if (string != NULL)
+        string[0] = (char) (arg[1].value & 0xff);
     return 0;
 }
 
-static int ICACHE_FLASH_ATTR func_asc(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_asc(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     char *string;
 
-    if (n < 2 || (arg[1].type & 0xff) != STRING)
-        parse_error(E_SYNTAX_ERROR);
+    if (n < 2 || (arg[1].type & 0xff) != STRING) {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return urubasic_set_number(&arg[0], 0);
+    }
 
-    string = (char *)symbol_names+arg[1].value;
+    string = string_text(ctx, arg[1].value);
     arg[0].type = NUMBER;
-    arg[0].value = string[0];
+    arg[0].value = string_len(ctx, arg[1].value) > 0 ? string[0] : 0;
     return 0;
 }
 
-static int ICACHE_FLASH_ATTR func_midintern(int n, struct urubasic_type *arg, int start, int len)
+static int ICACHE_FLASH_ATTR func_midintern(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, int start, int len)
 {
-    char *dst, *src;
-    int  i;
-
-    dst = smemblk_alloc(symbol_names, (int16_t) (len+1));
-    src = (char*)symbol_names+arg[1].value;
-
-    for (i=0; i<start && src && *src; ++i)
-        src++;
-
-    for (i=0; i<len && src && *src; ++i)
-        dst[i] = *src++;
-    dst[i] = '\0';
-
-    arg[0].type = STRING|ALLOC;
-    arg[0].value = dst-(char *)symbol_names;
+    struct String_view *v, *src;
+    char *dst;
+    int  size = string_len(ctx, arg[1].value), handle;
 
+    // the part of the text from start on with at most len characters
+    if (start < 0)
+        start = 0;
+    if (start > size)
+        start = size;
+    if (len > size - start)
+        len = size - start;
+
+    if (start == 0 && len == size) {
+        // the whole string is shared
+        string_retain(ctx, arg[1].value);
+        arg[0].type  = STRING|ALLOC;
+        arg[0].value = arg[1].value;
+    }
+    else if (len < (int) sizeof(struct String)) {
+        // a short part costs no more than a view
+        dst = string_alloc(ctx, &arg[0], len);
+        if (dst != NULL)
+            memcpy(dst, string_text(ctx, arg[1].value) + start, (size_t) len);
+    }
+    else {
+        // a view of the string with the text, the part is not copied
+        handle = string_new(ctx, sizeof(struct String_view));
+        if (handle < 0) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            return urubasic_set_number(&arg[0], 0);
+        }
+        v   = (struct String_view *) string_head(ctx, handle);
+        src = (struct String_view *) string_head(ctx, arg[1].value);
+        v->head.len  = (smemblk_size_t) len;
+        v->head.refs = STRING_VIEW | 1;
+        if (src->head.refs & STRING_VIEW) {
+            v->view  = src->view;
+            v->start = (smemblk_size_t) (src->start + start);
+        }
+        else {
+            v->view  = (smemblk_size_t) arg[1].value;
+            v->start = (smemblk_size_t) start;
+        }
+        string_retain(ctx, v->view);
+        arg[0].type  = STRING|ALLOC;
+        arg[0].value = handle;
+    }
     return 0;
 }
 
-static int ICACHE_FLASH_ATTR func_leftS(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_leftS(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     int  len;
 
-    if (n < 3 || (arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER)
-        parse_error(E_SYNTAX_ERROR);
+    if (n < 3 || (arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER) {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return urubasic_set_number(&arg[0], 0);
+    }
 
     len = arg[2].value;
     if (len < 0)
         len = 0;
 
-    return func_midintern(n, arg, 0, len);
+    return func_midintern(ctx, n, arg, 0, len);
 }
 
-static int ICACHE_FLASH_ATTR func_midS(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_midS(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     int  len = 0;
 
     if (n == 3) {
-        if ((arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER)
-            parse_error(E_SYNTAX_ERROR);
-        len = strlen((char *) symbol_names+arg[1].value);
+        if ((arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER) {
+            parse_error(ctx, E_SYNTAX_ERROR);
+            return urubasic_set_number(&arg[0], 0);
+        }
+        len = string_len(ctx, arg[1].value);
     }
     else if (n == 4) {
-        if ((arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER || (arg[3].type & 0xff) != NUMBER)
-            parse_error(E_SYNTAX_ERROR);
+        if ((arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER || (arg[3].type & 0xff) != NUMBER) {
+            parse_error(ctx, E_SYNTAX_ERROR);
+            return urubasic_set_number(&arg[0], 0);
+        }
         len = arg[3].value;
     }
+    else {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return urubasic_set_number(&arg[0], 0);
+    }
     if (len < 0)
         len = 0;
 
-    return func_midintern(n, arg, arg[2].value-1, len);
+    return func_midintern(ctx, n, arg, arg[2].value-1, len);
 }
 
-static int ICACHE_FLASH_ATTR func_rightS(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_rightS(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
-    char *src;
     int  len, start;
 
-    if (n < 3 || (arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER)
-        parse_error(E_SYNTAX_ERROR);
+    if (n < 3 || (arg[1].type & 0xff) != STRING || (arg[2].type & 0xff) != NUMBER) {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return urubasic_set_number(&arg[0], 0);
+    }
 
     len = arg[2].value;
     if (len < 0)
         len = 0;
 
-    src = (char*)symbol_names+arg[1].value;
-    start = strlen(src) - len;
+    start = string_len(ctx, arg[1].value) - len;
     if (start < 0) {
         len += start;
         start = 0;
     }
 
-    return func_midintern(n, arg, start, len);
+    return func_midintern(ctx, n, arg, start, len);
 }
 
-static int ICACHE_FLASH_ATTR func_strS(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_strS(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     char *dst;
 
     if (n < 2 || (arg[1].type & 0xff) != NUMBER)
-        parse_error(E_SYNTAX_ERROR);
+        parse_error(ctx, E_SYNTAX_ERROR);
 
-    dst = smemblk_alloc(symbol_names, 12);
-    sprintf(dst, "%s%d ", arg[1].value < 0 ? "" : " ", arg[1].value);
-    arg[0].type = STRING|ALLOC;
-    arg[0].value = dst-(char *)symbol_names;
+    dst = string_alloc(ctx, &arg[0], 13);
+    if (dst != NULL)
+        string_head(ctx, arg[0].value)->len = (smemblk_size_t) format_number(dst, arg[1].value);
     return 0;
 }
 
-static int ICACHE_FLASH_ATTR func_stringS(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_stringS(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     if (n == 3 && urubasic_is_number(&arg[1])) {
         int len, ch, i;
         char *s;
 
         len = urubasic_get_number(&arg[1]);
-        if (urubasic_is_string(&arg[2])) {
-            s = urubasic_get_string(&arg[2]);
-            ch = s[0];
-        }
+        if (urubasic_is_string(&arg[2]))
+            ch = string_len(ctx, arg[2].value) > 0 ? string_text(ctx, arg[2].value)[0] : 0;
         else
             ch = urubasic_get_number(&arg[2]);
 
-        urubasic_alloc_string(&arg[0], len+1);
-        s = urubasic_get_string(&arg[0]);
-        for (i=0; i<len; i++)
-            s[i] = ch;
-        s[i] = '\0';
+        s = string_alloc(ctx, &arg[0], len > 0 && (ch & 0xff) != 0 ? len : 0);
+        for (i=0; i<len && s != NULL; i++)
+            s[i] = (char) ch;
     }
 
     return 0;
 }
 
-static int ICACHE_FLASH_ATTR stmt_goto(int insn, struct urubasic_type *arg, void *user)
-{
-    struct urubasic_type tval = { 0, };
-    expr (&tval);
-    return find_insn(tval.value);
-}
-
-static int ICACHE_FLASH_ATTR func_min(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_min(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     int m = INT_MAX, i;
     for (i=1; i<n; ++i) {
@@ -1063,7 +2203,7 @@ static int ICACHE_FLASH_ATTR func_min(int n, struct urubasic_type *arg, void *us
     return m;
 }
 
-static int ICACHE_FLASH_ATTR func_max(int n, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR func_max(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user)
 {
     int m = INT_MIN, i;
     for (i=1; i<n; ++i) {
@@ -1075,724 +2215,3972 @@ static int ICACHE_FLASH_ATTR func_max(int n, struct urubasic_type *arg, void *us
     return m;
 }
 
-static int ICACHE_FLASH_ATTR stmt_next(int insn, struct urubasic_type *arg, void *user)
+static void ICACHE_FLASH_ATTR print_flush(struct urubasic_ctx *ctx, int newline)
 {
-    int max_val, val, step, tok;
-    SYMIDX symidx;
-    tok = lex_next_token(&symidx);
-    check_token(tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER);
-
-    if (symidx == 0)
-        symidx = parse_lookup_symbol(token_text, 0);
-    if (!is_keyword(symidx) && (master_control == 0 || master_control == symidx)) {
-        master_control = 0;
-        step           = stack_pop(for_loop_stack);
-        max_val        = stack_pop(for_loop_stack);
-        if (get_symbol(symidx)->value_ptr == NULL)
-            get_symbol(symidx)->value_ptr = smemblk_alloc(symbol_names, sizeof(int));
-        *get_symbol(symidx)->value_ptr = val = *get_symbol(symidx)->value_ptr+step;
-        if ((step > 0 && val > max_val) || (step < 0 && val < max_val)) {
-            // loop finished
-            stack_pop(for_loop_stack);
-            ++insn;
-        }
-        else {
-            // continue loop
-            insn = stack_pop(for_loop_stack);
-            stack_push(for_loop_stack, insn);
-            stack_push(for_loop_stack, max_val);
-            stack_push(for_loop_stack, step);
-        }
+    // write the pending output, only a newline trims it and resets the column
+    int len = ctx->print_line_len;
+
+    if (newline) {
+        while (len > 0 && is_blank(ctx->print_line[len-1]))
+            --len;
+        output_text(ctx, ctx->print_line, len);
+        output_text(ctx, "\n", 1);
+        ctx->print_column = 0;
     }
     else
-        ++insn;
-
-    return insn;
+        output_text(ctx, ctx->print_line, len);
+    ctx->print_line_len = 0;
 }
 
-static char * ICACHE_FLASH_ATTR trimright(char *s)
+static void ICACHE_FLASH_ATTR print_tab(struct urubasic_ctx *ctx, int n)
 {
-    int len = strlen(s);
-    while (len > 0 && is_blank(s[len-1]))
-        s[--len] = '\0';
-
-    return s;
+    if (n < 1) n = 1;
+    n -= MAX_LINE_LEN * ((n-1) / MAX_LINE_LEN);
+    if (ctx->print_column > n)
+        print_flush(ctx, 1);
+
+    if (ctx->print_column < n) {
+        memset(&ctx->print_line[ctx->print_line_len], ' ', n - ctx->print_column);
+        ctx->print_line_len += n - ctx->print_column;
+        ctx->print_column = n;
+    }
 }
 
-static int ICACHE_FLASH_ATTR stmt_print(int insn, struct urubasic_type *arg, void *user)
+static void ICACHE_FLASH_ATTR print_text(struct urubasic_ctx *ctx, const char *s, int len)
 {
-    int tok, ends_with_separator, nargs;
-    SYMIDX dummy;
-    struct urubasic_type tval = { 0, };
-    static char line[MAX_LINE_LEN];
-    static int line_len = 0;
-
-    ends_with_separator = nargs = 0;
-    while (1) {
-        tok = lex_next_token(&dummy);
-        if (TAB == check_token(tok, dummy, TAB, 0) || COMMA == check_token(tok, dummy, COMMA, 0)) {
-            int n;
-
-            ++nargs;
-            if (TAB == check_token(tok, dummy, TAB, 0)) {
-                tok = lex_next_token(&dummy);
-                check_token(tok, dummy, LPAREN, E_MISSING_LPAREN);
-                expr(&tval);
-                n = tval.value;
-                tok = lex_next_token(&dummy);
-                check_token(tok, dummy, RPAREN, E_MISSING_RPAREN);
-                ends_with_separator = 0;
-            }
-            else {
-                n = line_len + (PRINT_ZONE_LEN - (line_len % PRINT_ZONE_LEN));
-                ends_with_separator = 1;
-            }
-
-            if (n < 1) n = 1;
-            n -= MAX_LINE_LEN * ((n-1) / MAX_LINE_LEN);
-            if (line_len > n) {
-                printf("%s\n", trimright(line));
-                line[0] = '\0';
-                line_len = 0;
-            }
+    if (PRINT_ZONE_LEN + ctx->print_column > PRINT_ZONE_LEN * MAX_PRINT_ZONES)
+        print_flush(ctx, 1);
+    if (ctx->print_line_len + len > MAX_LINE_LEN)
+        print_flush(ctx, 0);
 
-            while (line_len < n) {
-                strcat(line, " ");
-                line_len++;
-            }
-        }
-        else if (SEMICOLON == check_token(tok, dummy, SEMICOLON, 0)) {
-            ++nargs;
-            ends_with_separator = 1;
-        }
-        else if (tok == NEWLINE || tok == 0 || tok == COLON) {
-            break;
-        }
-        else {
-            char temp[MAX_LINE_LEN], *s;
-            int len;
-
-            ++nargs;
-            if (tok != STRING) {
-                int val;
-                lex_push_token(tok);
-                expr(&tval);
-                if (tval.type == NUMBER) {
-                    val = tval.value;
-                    sprintf(temp, "%s%d ", val < 0 ? "" : " ", val);
-                }
-                else {
-                    sprintf(temp, "%s", (char *)symbol_names+tval.value);
-                    if (tval.type & ALLOC)
-                        smemblk_free(symbol_names, (char *)symbol_names+tval.value);
-                }
-
-                s = temp;
-            }
-            else
-                s = token_text;
-
-            len = strlen(s);
-            if (PRINT_ZONE_LEN + line_len > PRINT_ZONE_LEN * MAX_PRINT_ZONES) {
-                printf("%s\n", trimright(line));
-                line[0] = '\0';
-                line_len = 0;
-            }
-            strcat(line, s);
-            line_len += len;
-            ends_with_separator = 0;
-        }
-    }
-
-    if (ends_with_separator && line_len < PRINT_ZONE_LEN * MAX_PRINT_ZONES) {
-        printf("%s", line);
-    }
+    if (len > MAX_LINE_LEN)
+        output_text(ctx, s, len);
     else {
-        printf("%s\n", trimright(line));
-        line_len = 0;
+        memcpy(&ctx->print_line[ctx->print_line_len], s, len);
+        ctx->print_line_len += len;
     }
-    line[0] = '\0';
-    return insn+1;
+    ctx->print_column += len;
+}
+
+static void ICACHE_FLASH_ATTR print_end(struct urubasic_ctx *ctx, int ends_with_separator)
+{
+    print_flush(ctx, !ends_with_separator || ctx->print_column >= PRINT_ZONE_LEN * MAX_PRINT_ZONES);
 }
 
 static void ICACHE_FLASH_ATTR set_value_type(SYMIDX symidx, int16_t type)
 {
-    int16_t alloc = get_symbol(symidx)->value_type & (NAME_ALLOC | ALLOC);
+    int16_t alloc = get_symbol(symidx)->value_type & ALLOC;
     get_symbol(symidx)->value_type = type | alloc;
 }
 
-static int ICACHE_FLASH_ATTR stmt_read(int insn, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR compile_stmt(struct urubasic_ctx *ctx, int insn);
+
+static int ICACHE_FLASH_ATTR compile_rem(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)  { return 0; }
+static int ICACHE_FLASH_ATTR compile_stop(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user) { code_emit_op(ctx, OP_STOP, 0); return 0; }
+static int ICACHE_FLASH_ATTR compile_return(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user) { code_emit_op(ctx, OP_RETURN, 0); return 0; }
+static int ICACHE_FLASH_ATTR compile_restore(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user) { code_emit_op(ctx, OP_RESTORE, 0); return 0; }
+
+static int ICACHE_FLASH_ATTR compile_constant(struct urubasic_ctx *ctx, int start, int *value)
 {
-    int tok, *value_ptr;
-    SYMIDX symidx;
+    // check whether the code emitted since start pushes a constant number
+    if (ctx->compile_failed || ctx->code_len != start + 3 || ctx->code[start] != OP_PUSHNUM)
+        return 0;
+    *value = code_get32(&ctx->code[start+1]);
+    return 1;
+}
 
-    do {
-        tok = lex_next_token(&symidx);
-        check_token(tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER);
-        if (symidx == 0)
-            symidx = parse_lookup_symbol(token_text, 1);
-        value_ptr = parse_subscript(symidx);
-        if (value_ptr != NULL) {
-            if (data_buffer[data_buffer_index] == -1) {
-                char *string;
-                ++data_buffer_index;
-                set_value_type(symidx, STRING);
-                string = smemblk_realloc(symbol_names, get_symbol(symidx)->value_ptr, data_buffer[data_buffer_index]);
-                get_symbol(symidx)->value_ptr = (int *) string;
-                strcpy(string, &data_buffer[data_buffer_index+1]);
-                data_buffer_index += data_buffer[data_buffer_index]+1;
+static void ICACHE_FLASH_ATTR compile_jump(struct urubasic_ctx *ctx, int gosub)
+{
+    // the target of a constant line number is resolved now
+    int start = ctx->code_len, label;
+
+    compile_expr(ctx);
+    if (compile_constant(ctx, start, &label)) {
+        ctx->code_len = start;
+        ctx->code_depth -= 1;
+        code_emit_op(ctx, gosub ? OP_GOSUBINSN : OP_GOTOINSN, 0);
+        code_emit(ctx, find_insn(ctx, label));
+    }
+    else
+        code_emit_op(ctx, gosub ? OP_GOSUB : OP_GOTO, -1);
+}
+
+static int ICACHE_FLASH_ATTR compile_goto(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    compile_jump(ctx, 0);
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_gosub(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    compile_jump(ctx, 1);
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_print(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok, ends_with_separator = 0;
+    SYMIDX dummy;
+
+    while (1) {
+        tok = lex_next_token(ctx, &dummy);
+        if (TAB == check_token(ctx, tok, dummy, TAB, 0)) {
+            tok = lex_next_token(ctx, &dummy);
+            check_token(ctx, tok, dummy, LPAREN, E_MISSING_LPAREN);
+            compile_expr(ctx);
+            tok = lex_next_token(ctx, &dummy);
+            check_token(ctx, tok, dummy, RPAREN, E_MISSING_RPAREN);
+            code_emit_op(ctx, OP_PRINTTAB, -1);
+            ends_with_separator = 0;
+        }
+        else if (COMMA == check_token(ctx, tok, dummy, COMMA, 0)) {
+            code_emit_op(ctx, OP_PRINTCOMMA, 0);
+            ends_with_separator = 1;
+        }
+        else if (SEMICOLON == check_token(ctx, tok, dummy, SEMICOLON, 0)) {
+            ends_with_separator = 1;
+        }
+        else if (tok == NEWLINE || tok == 0 || tok == COLON) {
+            break;
+        }
+        else {
+            if (tok == STRING) {
+                code_emit_op(ctx, OP_PRINTSTR, 0);
+                code_emit_string(ctx, ctx->token_text);
+            }
+            else {
+                int errors = ctx->error_count;
+                lex_push_token(ctx, tok);
+                compile_expr(ctx);
+                code_emit_op(ctx, OP_PRINTVAL, -1);
+                if (errors != ctx->error_count)
+                    break;
+            }
+            ends_with_separator = 0;
+        }
+    }
+
+    code_emit_op(ctx, OP_PRINTEND, 0);
+    code_emit(ctx, ends_with_separator);
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_read(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok, dims;
+    SYMIDX symidx;
+
+    do {
+        tok = lex_next_token(ctx, &symidx);
+        if (IDENTIFIER != check_token(ctx, tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER))
+            return -1;
+        if (symidx == 0)
+            symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+        if (symidx == NULL) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            return -1;
+        }
+        dims = compile_subscript(ctx);
+        code_emit_op(ctx, OP_READ, -dims);
+        code_emit_symbol(ctx, symidx);
+        code_emit(ctx, dims);
+        tok = lex_next_token(ctx, &symidx);
+    } while (COMMA == check_token(ctx, tok, symidx, COMMA, 0));
+    return 0;
+}
+
+static void ICACHE_FLASH_ATTR free_def_params(struct urubasic_ctx *ctx, int end)
+{
+    // remove the parameters of a DEF function from def_params
+    while (ctx->def_param_count > end)
+        smemblk_free(ctx->symbol_names, ctx->def_params[--ctx->def_param_count]);
+}
+
+static int ICACHE_FLASH_ATTR compile_def(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    // the function body is compiled in place and skipped by a jump
+    int tok, skip, body, errors = ctx->error_count, n = 0, end = ctx->def_param_count;
+    SYMIDX symidx, dummy, param;
+    char *name;
+
+    tok = lex_next_token(ctx, &symidx);
+    if (FUNCTION != check_token(ctx, tok, symidx, FUNCTION, E_MISSING_IDENTIFIER))
+        return -1;
+    if (get_symbol(symidx)->func != 0) {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        return -1;
+    }
+
+    // the parameters are symbols, which are visible inside of the function only
+    tok = lex_next_token(ctx, &dummy);
+    if (LPAREN == check_token(ctx, tok, dummy, LPAREN, 0)) {
+        tok = lex_next_token(ctx, &dummy);
+        while (RPAREN != check_token(ctx, tok, dummy, RPAREN, 0)) {
+            if (IDENTIFIER != check_token(ctx, tok, dummy, IDENTIFIER, E_MISSING_IDENTIFIER)) {
+                free_def_params(ctx, end);
+                return -1;
+            }
+            param = NULL;
+            name = store_string(ctx, ctx->token_text);
+            if (name != NULL)
+                param = parse_add_extra_symbol(ctx, name);
+            if (param == NULL) {
+                free_def_params(ctx, end);
+                parse_error(ctx, E_OUT_OF_MEMORY);
+                return -1;
+            }
+            param->array_base_size = (smemblk_size_t) n++;   // index of the argument
+            tok = lex_next_token(ctx, &dummy);
+            if (COMMA == check_token(ctx, tok, dummy, COMMA, 0))
+                tok = lex_next_token(ctx, &dummy);
+        }
+    }
+    else
+        lex_push_token(ctx, tok);
+
+    tok = lex_next_token(ctx, &dummy);
+    check_token(ctx, tok, NULL, EQ, E_MISSING_EQUALSIGN);
+
+    code_emit_op(ctx, OP_JUMP, 0);
+    skip = ctx->code_len;
+    code_emit32(ctx, 0);
+    body = ctx->code_len;
+    compile_expr(ctx);
+    code_emit_op(ctx, OP_RETDEF, -1);
+    code_set32(ctx, skip, ctx->code_len);
+    free_def_params(ctx, end);
+
+    if (errors != ctx->error_count)
+        return -1;
+
+    get_symbol(symidx)->array_base_size = (smemblk_size_t) body;
+    get_symbol(symidx)->value_type      = (int16_t) n;
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_for(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok;
+    SYMIDX dummy, symidx;
+
+    tok = lex_next_token(ctx, &dummy);
+    if (IDENTIFIER != check_token(ctx, tok, dummy, IDENTIFIER, E_MISSING_IDENTIFIER))
+        return -1;
+    symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+    if (symidx == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return -1;
+    }
+
+    tok = lex_next_token(ctx, &dummy);
+    check_token(ctx, tok, dummy, EQ, E_MISSING_EQUALSIGN);
+    compile_expr(ctx);
+    code_emit_op(ctx, OP_ASSIGN, -1);
+    code_emit_symbol(ctx, symidx);
+    tok = lex_next_token(ctx, &dummy);
+    check_token(ctx, tok, dummy, TO, E_MISSING_TO);
+    compile_expr(ctx);
+
+    tok = lex_next_token(ctx, &dummy);
+    if (STEP == check_token(ctx, tok, dummy, STEP, 0))
+        compile_expr(ctx);
+    else {
+        lex_push_token(ctx, tok);
+        code_emit_op(ctx, OP_PUSHNUM, 1);
+        code_emit32(ctx, 1);
+    }
+
+    // the exit is linked to the pending FOR loops until the NEXT is compiled
+    code_emit_op(ctx, OP_FOR, -2);
+    code_emit_symbol(ctx, symidx);
+    code_emit(ctx, ctx->for_chain);
+    if (!ctx->compile_failed)
+        ctx->for_chain = (code_t) (ctx->code_len - 1);
+    code_emit(ctx, 0);
+    return 0;
+}
+
+static void ICACHE_FLASH_ATTR compile_loop_exit(struct urubasic_ctx *ctx, SYMIDX symidx, int insn)
+{
+    // all pending FOR loops of symidx exit to insn
+    int p = ctx->for_chain, prev = -1, next;
+
+    while (p >= 0 && !ctx->compile_failed) {
+        next = ctx->code[p];
+        if (symidx == NULL || ctx->code[p-1] == symidx->slot) {
+            ctx->code[p] = (code_t) insn;
+            if (prev < 0)
+                ctx->for_chain = (code_t) next;
+            else
+                ctx->code[prev] = (code_t) next;
+        }
+        else
+            prev = p;
+        p = next;
+    }
+}
+
+static int ICACHE_FLASH_ATTR compile_next(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok;
+    SYMIDX symidx;
+
+    tok = lex_next_token(ctx, &symidx);
+    if (IDENTIFIER != check_token(ctx, tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER))
+        return -1;
+    if (symidx == 0)
+        symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+    if (symidx == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return -1;
+    }
+
+    // a NEXT at the start of an instruction ends the loop
+    if (ctx->code_len == ctx->insn_info[insn].code)
+        compile_loop_exit(ctx, symidx, insn + 1);
+    code_emit_op(ctx, OP_NEXT, 0);
+    code_emit_symbol(ctx, symidx);
+#ifdef URUBASIC_JIT
+    code_emit(ctx, ctx->optimize > 0 ? 0 : JIT_FAILED);
+#else
+    code_emit(ctx, 0);
+#endif
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_on(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int n = 0, i, tok, gosub = 0, start, constant = 1, label;
+    SYMIDX dummy;
+
+    compile_expr(ctx);
+
+    tok = lex_next_token(ctx, &dummy);
+    if (GOSUB == check_token(ctx, tok, dummy, GOSUB, 0))
+        gosub = 1;
+    else
+        check_token(ctx, tok, dummy, GOTO, E_MISSING_GOTO);
+
+    start = ctx->code_len;
+    do {
+        i = ctx->code_len;
+        compile_expr(ctx);
+        constant = constant && compile_constant(ctx, i, &label);
+        code_emit_op(ctx, OP_ONTARGET, -1);
+        code_emit(ctx, ++n);
+        code_emit(ctx, gosub);
+        code_emit(ctx, insn);
+        tok = lex_next_token(ctx, &dummy);
+    } while (COMMA == check_token(ctx, tok, dummy, COMMA, 0));
+    lex_push_token(ctx, tok);
+
+    if (constant && !ctx->compile_failed) {
+        // all targets are line numbers: replace the tests by a jump table,
+        // the instruction of target i is kept in the last word of its test
+        for (i=0; i<n; ++i)
+            ctx->code[start + 7*i + 6] = (code_t) find_insn(ctx, code_get32(&ctx->code[start + 7*i + 1]));
+        ctx->code_len = start;
+        code_emit_op(ctx, OP_ONTABLE, -1);
+        code_emit(ctx, n);
+        code_emit(ctx, gosub);
+        code_emit(ctx, insn);
+        for (i=0; i<n; ++i)
+            code_emit(ctx, ctx->code[start + 7*i + 6]);
+    }
+    else
+        code_emit_op(ctx, OP_POP, -1);
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_let(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok, dims, start, op, value;
+    SYMIDX symidx, dummy;
+
+    tok = lex_next_token(ctx, &symidx);
+    if (IDENTIFIER != check_token(ctx, tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER))
+        return -1;
+    if (symidx == 0)
+        symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+    if (symidx == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return -1;
+    }
+
+    dims = compile_subscript(ctx);
+    tok = lex_next_token(ctx, &dummy);
+    check_token(ctx, tok, dummy, EQ, E_MISSING_EQUALSIGN);
+    start = ctx->code_len;
+    compile_expr(ctx);
+    if (dims == 1) {
+        code_emit_op(ctx, OP_LETARR1, -2);
+        code_emit_symbol(ctx, symidx);
+        return 0;
+    }
+
+    // X = X + expression, unless it is X = X + number
+    if (ctx->optimize > 0 && dims == 0 && (ctx->code_len != start + 6 || ctx->code[start+2] != OP_PUSHNUM)
+        && code_is_append(ctx, start, symidx->slot)) {
+        ctx->code[ctx->code_len-1] = OP_APPEND;
+        --ctx->code_depth;
+        code_emit_symbol(ctx, symidx);
+        code_emit(ctx, 0);
+        code_emit(ctx, 0);
+        return 0;
+    }
+    code_emit_op(ctx, OP_LET, -1 - dims);
+    code_emit_symbol(ctx, symidx);
+    code_emit(ctx, dims);
+
+    // X = X + number
+    op = code_is_var_op_number(ctx, start);
+    if (ctx->optimize > 0 && dims == 0 && (op == OP_ADD || op == OP_SUB) && ctx->code_len == start + 9 && ctx->code[start+1] == symidx->slot) {
+        value = code_get32(&ctx->code[start+3]);
+        if (op == OP_ADD || value != INT_MIN) {
+            code_insert(ctx, start, 4);
+            code_set32(ctx, start+2, op == OP_ADD ? value : -value);
+            ctx->code[start]   = OP_ADDVAR;
+            ctx->code[start+1] = symidx->slot;
+        }
+    }
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_if(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok, start = ctx->code_len, op;
+    SYMIDX dummy;
+
+    compile_expr(ctx);
+    tok = lex_next_token(ctx, &dummy);
+    check_token(ctx, tok, dummy, THEN, E_MISSING_THEN);
+
+    // IF X relop number
+    op = code_is_var_op_number(ctx, start);
+    if (ctx->optimize > 0 && op >= OP_LT && op <= OP_NEQ && ctx->code_len == start + 6) {
+        code_insert(ctx, start, 5);
+        code_set32(ctx, start+3, code_get32(&ctx->code[start+8]));
+        ctx->code[start]   = OP_IFVAR;
+        ctx->code[start+1] = ctx->code[start+6];
+        ctx->code[start+2] = (code_t) op;
+    }
+
+    // else: continue with the next \n seperated line
+    code_emit_op(ctx, OP_IFFALSE, -1);
+    code_emit(ctx, ctx->insn_info[insn].next);
+    ctx->code_target = ctx->insn_info[insn].next;
+
+    return compile_stmt(ctx, insn);
+}
+
+static int ICACHE_FLASH_ATTR compile_option(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok;
+    SYMIDX dummy;
+
+    tok = lex_next_token(ctx, &dummy);
+    check_token(ctx, tok, dummy, BASE, E_MISSING_BASE);
+    compile_expr(ctx);
+    code_emit_op(ctx, OP_OPTIONBASE, -1);
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_dim(struct urubasic_ctx *ctx, int insn, struct urubasic_type *arg, void *user)
+{
+    int tok, dims;
+    SYMIDX symidx, dummy;
+
+    do {
+        tok = lex_next_token(ctx, &symidx);
+        if (IDENTIFIER != check_token(ctx, tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER))
+            return -1;
+        if (symidx == 0)
+            symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+        if (symidx == NULL) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            return -1;
+        }
+
+        dims = compile_subscript(ctx);
+        code_emit_op(ctx, OP_DIM, -dims);
+        code_emit_symbol(ctx, symidx);
+        code_emit(ctx, dims);
+        tok = lex_next_token(ctx, &dummy);
+    } while (COMMA == check_token(ctx, tok, dummy, COMMA, 0));
+
+    lex_push_token(ctx, tok);
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR compile_stmt(struct urubasic_ctx *ctx, int insn)
+{
+    int tok;
+    SYMIDX symidx;
+
+    tok = lex_next_token(ctx, &symidx);
+    if (tok == 0)
+        code_emit_op(ctx, OP_STOP, 0);
+    else if (tok == NEWLINE || tok == COLON)
+        ;   // empty instruction, e.g. a line with a label only
+    else if (tok == NUMBER) {
+        lex_push_token(ctx, tok);
+        compile_jump(ctx, 0);
+    }
+    else if (is_keyword(symidx)) {
+        if (!compile_keyword(ctx, tok, insn))
+            parse_error(ctx, E_SYNTAX_ERROR);
+    }
+    else if (IDENTIFIER == check_token(ctx, tok, symidx, IDENTIFIER, 0)) {
+        lex_push_token(ctx, tok);
+        compile_let(ctx, insn, NULL, NULL);
+    }
+    else if (FUNCTION == check_token(ctx, tok, symidx, FUNCTION, 0)) {
+        compile_function_call(ctx, symidx, 1);
+        code_emit_op(ctx, OP_POP, -1);
+    }
+    else
+        parse_error(ctx, E_SYNTAX_ERROR);
+
+    return 0;
+}
+
+static int ICACHE_FLASH_ATTR insn_code(struct urubasic_ctx *ctx, int insn)
+{
+    // code offset of an instruction, the final STOP if there is no such instruction
+    if (insn >= 0 && insn < ctx->insn_count)
+        return ctx->insn_info[insn].code;
+    return ctx->code_len - 1;
+}
+
+static void ICACHE_FLASH_ATTR vm_error(struct urubasic_ctx *ctx, code_t *pc, int error)
+{
+    ctx->vm_pc = pc;
+    parse_error(ctx, error);
+}
+
+static void ICACHE_FLASH_ATTR vm_release(struct urubasic_ctx *ctx, struct urubasic_type *arg, int n)
+{
+    // free strings which were allocated while evaluating an expression
+    int i;
+
+    for (i=0; i<n; i++) {
+        if (arg[i].type == (STRING|ALLOC))
+            string_release(ctx, arg[i].value);
+    }
+}
+
+static void ICACHE_FLASH_ATTR vm_string(struct urubasic_ctx *ctx, struct urubasic_type *arg, int v1, int v2)
+{
+    // push a new string, the concatenation of v1 and v2
+    int len1 = string_len(ctx, v1), len2 = string_len(ctx, v2);
+    char *string = string_alloc(ctx, arg, len2 < SMEMBLK_MAX_SIZE - len1 ? len1 + len2 : -1);
+
+    if (string != NULL) {
+        memcpy(string, string_text(ctx, v1), (size_t) len1);
+        memcpy(string + len1, string_text(ctx, v2), (size_t) len2);
+    }
+}
+
+static void ICACHE_FLASH_ATTR vm_operator(struct urubasic_ctx *ctx, int op, struct urubasic_type *a, struct urubasic_type *b)
+{
+    // evaluate an operator, the result replaces the first operand
+    int v1 = a->value, v2 = 0, type1 = a->type, type2 = 0;
+
+    if (b != NULL) {
+        type2 = b->type;
+        v2 = b->value;
+    }
+
+    if (type1 == NUMBER && (type2 == NUMBER || type2 == 0)) {
+        switch (op) {
+            case MULT:            v1 = v1*v2; break;
+            case CIRCUMFLEX:      v1 = power(v1, v2); break;
+            case PLUS:            v1 = v1+v2; break;
+            case MINUS:           v1 = v1-v2; break;
+            case SOLIDUS:         v1 = v1/v2; break;
+            case (UNARY | MINUS): v1 = -v1; break;
+            case GT:              v1 = v1>v2 ? -1 : 0; break;
+            case LT:              v1 = v1<v2 ? -1 : 0; break;
+            case LE:              v1 = v1<=v2 ? -1 : 0; break;
+            case GE:              v1 = v1>=v2 ? -1 : 0; break;
+            case EQ:              v1 = v1==v2 ? -1 : 0; break;
+            case NEQ:             v1 = v1!=v2 ? -1 : 0; break;
+            case AND:             v1 = v1&v2; break;
+            case (UNARY | NOT):   v1 = ~v1; break;
+            case OR:              v1 = v1|v2; break;
+            default:              v1 = 0; break;
+        }
+        a->type  = NUMBER;
+        a->value = v1;
+    }
+    else if ((type1 & 0xff) == STRING && (type2 & 0xff) == STRING) {
+        char *s1, *s2;
+
+        if (op == PLUS)
+            vm_string(ctx, a, v1, v2);
+        else {
+            s1 = string_text(ctx, v1);
+            s2 = string_text(ctx, v2);
+            a->type  = NUMBER;
+            if (op == EQ)
+                a->value = string_len(ctx, v1) == string_len(ctx, v2) && 0 == memcmp(s1, s2, (size_t) string_len(ctx, v1));
+            else if (op == NEQ)
+                a->value = string_len(ctx, v1) != string_len(ctx, v2) || 0 != memcmp(s1, s2, (size_t) string_len(ctx, v1));
+            else {
+                a->value = 0;
+                parse_error(ctx, E_SYNTAX_ERROR);
+            }
+        }
+        if (ALLOC & type1) string_release(ctx, v1);
+        if (ALLOC & type2) string_release(ctx, v2);
+    }
+    else {
+        parse_error(ctx, E_SYNTAX_ERROR);
+        vm_release(ctx, a, 1);
+        if (b != NULL)
+            vm_release(ctx, b, 1);
+        a->type  = NUMBER;
+        a->value = 0;
+    }
+}
+
+static int * ICACHE_FLASH_ATTR vm_element(struct urubasic_ctx *ctx, SYMIDX symidx, int dims, struct urubasic_type *sub)
+{
+    // address of variable(x, y), the variable is allocated on first use
+    int x = ctx->option_base, y = ctx->option_base, size = 1, array_base_size = 0;
+    struct symbol_def *sym = get_symbol(symidx);
+
+    if (dims > 0) x = sub[0].value;
+    if (dims > 1) y = sub[1].value;
+
+    if (sym->value_ptr == NULL && dims == 0 && sym->slot > 0 && sym->slot < ctx->vm_var_count) {
+        // a number gets its place in the variable frame
+        sym->value_ptr = &ctx->vm_vars[sym->slot];
+        *sym->value_ptr = 0;
+        sym->array_base_size = 0;
+    }
+    else if (sym->value_ptr == NULL) {
+        if (dims > 0) array_base_size = size = 11 - ctx->option_base;
+        if (dims > 1) size *= 11 - ctx->option_base;
+        if ((y - ctx->option_base) + (x - ctx->option_base) >= size) {
+            parse_error(ctx, E_INDEX_OUT_OF_BOUNDS);
+            return NULL;
+        }
+
+        sym->value_ptr = smemblk_zalloc(ctx->symbol_names, (smemblk_size_t) (size * sizeof(int)));
+        if (sym->value_ptr == NULL) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            return NULL;
+        }
+        sym->array_base_size = array_base_size;
+    }
+
+    return sym->value_ptr + sym->array_base_size * (y - ctx->option_base) + (x - ctx->option_base);
+}
+
+static int * ICACHE_FLASH_ATTR vm_number(struct urubasic_ctx *ctx, SYMIDX symidx, int dims, struct urubasic_type *sub)
+{
+    // address of a numeric variable, a string variable becomes numeric
+    if ((get_symbol(symidx)->value_type & 0xff) == STRING) {
+        free_value(ctx, symidx);
+        set_value_type(symidx, NUMBER);
+    }
+    return vm_element(ctx, symidx, dims, sub);
+}
+
+static void ICACHE_FLASH_ATTR vm_let(struct urubasic_ctx *ctx, SYMIDX symidx, int dims, struct urubasic_type *sub)
+{
+    // assign sub[dims] to variable(sub[0], sub[1])
+    int *value_ptr;
+
+    if ((sub[dims].type & 0xff) == STRING) {
+        // the variable shares a constant or the string of another variable
+        if (!(sub[dims].type & ALLOC))
+            string_retain(ctx, sub[dims].value);
+        if (get_symbol(symidx)->array_base_size != 0)
+            parse_error(ctx, E_WRONG_TYPE);
+        free_value(ctx, symidx);
+        set_value_type(symidx, STRING);
+        value_ptr = vm_element(ctx, symidx, 0, sub);
+        if (value_ptr != NULL)
+            *value_ptr = sub[dims].value;
+        else {
+            string_release(ctx, sub[dims].value);
+            set_value_type(symidx, NUMBER);
+        }
+    }
+    else {
+        value_ptr = vm_number(ctx, symidx, dims, sub);
+        if (value_ptr != NULL)
+            *value_ptr = sub[dims].value;
+    }
+}
+
+static void ICACHE_FLASH_ATTR vm_append(struct urubasic_ctx *ctx, SYMIDX symidx, struct urubasic_type *sub)
+{
+    // X = X + sub[1] where sub[0] is X, the string of X grows in place
+    struct symbol_def *sym = get_symbol(symidx);
+    struct String *s;
+    int len, add, cap;
+
+    // only a string with text which X alone holds may change
+    if (sub[0].type != STRING || (sub[1].type & 0xff) != STRING || (sym->value_type & 0xff) != STRING || *sym->value_ptr != sub[0].value
+        || string_head(ctx, sub[0].value)->refs != 1) {
+        vm_operator(ctx, PLUS, sub, sub + 1);
+        vm_let(ctx, symidx, 0, sub);
+        return;
+    }
+
+    len = string_len(ctx, sub[0].value);
+    add = string_len(ctx, sub[1].value);
+    if (add > string_capacity(ctx, sub[0].value) - len) {
+        // the room doubles, a string built by appending is copied a few times only
+        if (add >= SMEMBLK_MAX_SIZE - 2 * (int) sizeof(struct String) - len) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            vm_release(ctx, sub + 1, 1);
+            return;
+        }
+        cap = len + add < (SMEMBLK_MAX_SIZE - 2 * (int) sizeof(struct String)) / 2 ? 2 * (len + add) : len + add;
+        if (!string_resize(ctx, sub[0].value, (int) sizeof(struct String) + cap + 1)) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            vm_release(ctx, sub + 1, 1);
+            return;
+        }
+    }
+    // X = X + X appends the text of the moved string
+    s = string_head(ctx, sub[0].value);
+    memcpy((char *) (s + 1) + len, string_text(ctx, sub[1].value), (size_t) add);
+    ((char *) (s + 1))[len + add] = '\0';
+    s->len = (smemblk_size_t) (len + add);
+    vm_release(ctx, sub + 1, 1);
+}
+
+static void ICACHE_FLASH_ATTR vm_read(struct urubasic_ctx *ctx, SYMIDX symidx, int dims, struct urubasic_type *sub)
+{
+    int *value_ptr, v;
+
+    // READ goes on with the next DATA instruction
+    while (ctx->data_buffer_index < ctx->data_buffer_max && ctx->data_buffer[ctx->data_buffer_index] == 0)
+        ++ctx->data_buffer_index;
+    if (ctx->data_buffer_index >= ctx->data_buffer_max) {
+        parse_error(ctx, E_OUT_OF_DATA);
+        return;
+    }
+
+    if (ctx->data_buffer[ctx->data_buffer_index] == -1) {
+        struct urubasic_type value;
+
+        // the variable shares the constant
+        value.type  = STRING;
+        value.value = ~data_offset(&ctx->data_buffer[ctx->data_buffer_index]);
+        ctx->data_buffer_index += data_len(&ctx->data_buffer[ctx->data_buffer_index]);
+        vm_let(ctx, symidx, 0, &value);
+    }
+    else {
+        v = data_number(&ctx->data_buffer[ctx->data_buffer_index]);
+        ctx->data_buffer_index += data_len(&ctx->data_buffer[ctx->data_buffer_index]);
+
+        value_ptr = vm_number(ctx, symidx, dims, sub);
+        if (value_ptr != NULL)
+            *value_ptr = v;
+    }
+}
+
+static void ICACHE_FLASH_ATTR vm_dim(struct urubasic_ctx *ctx, SYMIDX symidx, int dims, struct urubasic_type *sub)
+{
+    int x = 0, y = ctx->option_base, size;
+    int *value_ptr;
+
+    if (dims > 0) x = sub[0].value;
+    if (dims > 1) y = sub[1].value;
+
+    if (x < ctx->option_base || (dims > 1 && y < ctx->option_base)) {
+        parse_error(ctx, E_INVALID_DIM);
+        return;
+    }
+
+    if (x - ctx->option_base >= SMEMBLK_MAX_SIZE / (int) sizeof(int) || y - ctx->option_base >= SMEMBLK_MAX_SIZE / (int) sizeof(int)
+        || x - ctx->option_base + 1 > SMEMBLK_MAX_SIZE / (int) sizeof(int) / (y - ctx->option_base + 1)) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return;
+    }
+    size = (x - ctx->option_base + 1) * (y - ctx->option_base + 1) * sizeof(int);
+
+    if ((get_symbol(symidx)->value_type & 0xff) == STRING) {
+        free_value(ctx, symidx);
+        set_value_type(symidx, NUMBER);
+    }
+    if (in_frame(ctx, symidx)) {
+        // the scalar in the frame becomes element 0, like a block grown by realloc
+        value_ptr = smemblk_zalloc(ctx->symbol_names, (smemblk_size_t) size);
+        if (value_ptr != NULL)
+            value_ptr[0] = *get_symbol(symidx)->value_ptr;
+    }
+    else if (get_symbol(symidx)->value_ptr == NULL)
+        value_ptr = smemblk_zalloc(ctx->symbol_names, (smemblk_size_t) size);
+    else
+        value_ptr = smemblk_realloc(ctx->symbol_names, get_symbol(symidx)->value_ptr, (smemblk_size_t) size);
+    if (value_ptr == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return;
+    }
+    get_symbol(symidx)->value_ptr = value_ptr;
+    get_symbol(symidx)->array_base_size = x - ctx->option_base + 1;
+}
+
+static void ICACHE_FLASH_ATTR vm_print(struct urubasic_ctx *ctx, struct urubasic_type *arg)
+{
+    char temp[16];
+    char *s;
+
+    if (arg->type == NUMBER)
+        print_text(ctx, temp, format_number(temp, arg->value));
+    else {
+        s = string_text(ctx, arg->value);
+        print_text(ctx, s, string_len(ctx, arg->value));
+        vm_release(ctx, arg, 1);
+    }
+}
+
+static int ICACHE_FLASH_ATTR vm_push_frame(struct urubasic_ctx *ctx, SYMIDX var, int offset, int end, int step)
+{
+    struct Frame *frame;
+
+    if (ctx->frame_count >= FOR_LOOP_DEPTH) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return 0;
+    }
+
+    frame = &ctx->frame_stack[ctx->frame_count++];
+    frame->var    = var;
+    frame->offset = offset;
+    frame->end    = end;
+    frame->step   = step;
+    return 1;
+}
+
+static int ICACHE_FLASH_ATTR vm_numbers(struct urubasic_type *sp)
+{
+    return sp[-1].type == NUMBER && sp[0].type == NUMBER;
+}
+
+#ifdef URUBASIC_JIT
+// translation of a loop body with number variables only. The machine code
+// keeps the VM stack on the native stack, rdi points to the FOR frame
+struct Jit {
+    struct urubasic_ctx *ctx;
+    unsigned char *base, *p, *end;
+    int     start, stop;    // code offsets of the loop body and its NEXT
+    int     *native;        // machine code offset of each code word, -1 inside an instruction
+    int     *fixup;         // pairs of rel32 position and code offset of a jump
+    int     fixup_count, failed;
+    SYMIDX  *syms;
+    int16_t sym_count;
+};
+
+static const unsigned char jit_setcc[] = { 0x9c, 0x9e, 0x9f, 0x9d, 0x94, 0x95 };   // OP_LT .. OP_NEQ
+static const unsigned char jit_jfalse[] = { 0x8d, 0x8f, 0x8e, 0x8c, 0x85, 0x84 };  // jcc when not OP_LT .. OP_NEQ
+
+static void ICACHE_FLASH_ATTR jit_emit(struct Jit *j, int n, ...)
+{
+    // append n bytes of machine code
+    va_list ap;
+
+    va_start(ap, n);
+    while (n-- > 0) {
+        int b = va_arg(ap, int);
+        if (j->p < j->end)
+            *j->p++ = (unsigned char) b;
+        else
+            j->failed = 1;
+    }
+    va_end(ap);
+}
+
+static void ICACHE_FLASH_ATTR jit_emit32(struct Jit *j, int v)
+{
+    jit_emit(j, 4, v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff);
+}
+
+static void ICACHE_FLASH_ATTR jit_emit_ptr(struct Jit *j, int reg, const void *ptr)
+{
+    // movabs reg, ptr
+    unsigned long a = (unsigned long) ptr;
+
+    jit_emit(j, 2, 0x48, 0xb8 + reg);
+    jit_emit32(j, (int) (a & 0xffffffff));
+    jit_emit32(j, (int) (a >> 32));
+}
+
+static void ICACHE_FLASH_ATTR jit_jump(struct Jit *j, int cc, int target)
+{
+    // jmp or jcc to a code offset, resolved by jit_link
+    if (cc)
+        jit_emit(j, 2, 0x0f, cc);
+    else
+        jit_emit(j, 1, 0xe9);
+    j->fixup[j->fixup_count++] = j->p - j->base;
+    j->fixup[j->fixup_count++] = target;
+    jit_emit32(j, 0);
+}
+
+static SYMIDX ICACHE_FLASH_ATTR jit_symbol(struct Jit *j, code_t c)
+{
+    // the variable is checked on entry of the loop
+    SYMIDX sym = code_symbol(j->ctx, c);
+    int i;
+
+    for (i=0; i<j->sym_count && j->syms[i] != sym; ++i)
+        ;
+    if (i == j->sym_count)
+        j->syms[j->sym_count++] = sym;
+    return sym;
+}
+
+static void ICACHE_FLASH_ATTR jit_load_value_ptr(struct Jit *j, SYMIDX sym)
+{
+    // rax = sym->value_ptr
+    jit_emit_ptr(j, 1, &sym->value_ptr);
+    jit_emit(j, 3, 0x48, 0x8b, 0x01);
+}
+
+static void ICACHE_FLASH_ATTR jit_element(struct Jit *j, SYMIDX sym, int dims)
+{
+    // rcx = address of the element, x is in eax and y in edx
+    int base = j->ctx->option_base;
+
+    if (dims > 1) {
+        jit_emit(j, 2, 0x81, 0xea);                 // sub edx, base
+        jit_emit32(j, base);
+        jit_emit_ptr(j, 1, &sym->array_base_size);
+#ifdef SMEMBLK_32BIT
+        jit_emit(j, 2, 0x8b, 0x09);                 // mov ecx, [rcx]
+#else
+        jit_emit(j, 3, 0x0f, 0xbf, 0x09);           // movsx ecx, word [rcx]
+#endif
+        jit_emit(j, 3, 0x0f, 0xaf, 0xd1);           // imul edx, ecx
+    }
+    jit_emit(j, 1, 0x2d);                           // sub eax, base
+    jit_emit32(j, base);
+    if (dims > 1)
+        jit_emit(j, 2, 0x01, 0xd0);                 // add eax, edx
+    jit_emit(j, 3, 0x48, 0x63, 0xc0);               // movsxd rax, eax
+    jit_emit_ptr(j, 1, &sym->value_ptr);
+    jit_emit(j, 3, 0x48, 0x8b, 0x09);               // mov rcx, [rcx]
+    jit_emit(j, 4, 0x48, 0x8d, 0x0c, 0x81);         // lea rcx, [rcx+rax*4]
+}
+
+static void ICACHE_FLASH_ATTR jit_next(struct Jit *j, SYMIDX sym)
+{
+    // add step to the variable, jump back to the body or leave the loop
+    jit_load_value_ptr(j, sym);
+    jit_emit(j, 2, 0x8b, 0x08);                     // mov ecx, [rax]
+    jit_emit(j, 3, 0x8b, 0x57, (int) offsetof(struct Frame, step));  // mov edx, [rdi+step]
+    jit_emit(j, 2, 0x01, 0xd1);                     // add ecx, edx
+    jit_emit(j, 2, 0x89, 0x08);                     // mov [rax], ecx
+    jit_emit(j, 2, 0x85, 0xd2);                     // test edx, edx
+    jit_emit(j, 2, 0x7f, 16);                       // jg positive
+    jit_jump(j, 0x84, j->start);                    // step 0 loops forever
+    jit_emit(j, 3, 0x3b, 0x4f, (int) offsetof(struct Frame, end));   // cmp ecx, [rdi+end]
+    jit_emit(j, 2, 0x7c, 15);                       // jl done
+    jit_jump(j, 0, j->start);
+    jit_emit(j, 3, 0x3b, 0x4f, (int) offsetof(struct Frame, end));   // positive: cmp ecx, [rdi+end]
+    jit_emit(j, 2, 0x7f, 5);                        // jg done
+    jit_jump(j, 0, j->start);
+    jit_emit_ptr(j, 0, &j->ctx->frame_count);       // done: the frame is popped
+    jit_emit(j, 3, 0x66, 0xff, 0x08);               // dec word [rax]
+    jit_emit(j, 1, 0xb8);                           // mov eax, code behind NEXT
+    jit_emit32(j, j->stop + 3);
+    jit_emit(j, 1, 0xc3);
+}
+
+static int ICACHE_FLASH_ATTR jit_translate(struct Jit *j)
+{
+    // machine code for the instructions of the loop, 0 if one is not supported
+    struct urubasic_ctx *ctx = j->ctx;
+    code_t *code = ctx->code;
+    SYMIDX sym;
+    int o = j->start, op, n;
+
+    while (o <= j->stop && !j->failed) {
+        j->native[o - j->start] = j->p - j->base;
+        op = code[o];
+
+        // the variants without type checks are translated alike
+        if (op == OP_LOADNUM)
+            op = OP_LOADVAR;
+        else if (op == OP_LETNUM)
+            op = OP_LET;
+        else if (op >= OP_NEGN)
+            op += OP_NEG - OP_NEGN;
+        switch (op) {
+            case OP_PUSHNUM:
+                jit_emit(j, 1, 0xb8);               // mov eax, number
+                jit_emit32(j, code_get32(&code[o+1]));
+                jit_emit(j, 1, 0x50);               // push rax
+                o += 3;
+                break;
+
+            case OP_LOADVAR:
+                jit_load_value_ptr(j, jit_symbol(j, code[o+1]));
+                jit_emit(j, 3, 0x8b, 0x00, 0x50);   // mov eax, [rax]; push rax
+                o += 2;
+                break;
+
+            case OP_LOADARR1:
+            case OP_LOADARR2:
+                sym = jit_symbol(j, code[o+1]);
+                if (op == OP_LOADARR2)
+                    jit_emit(j, 1, 0x5a);           // pop rdx
+                jit_emit(j, 1, 0x58);               // pop rax
+                jit_element(j, sym, op == OP_LOADARR1 ? 1 : 2);
+                jit_emit(j, 3, 0x8b, 0x01, 0x50);   // mov eax, [rcx]; push rax
+                o += 2;
+                break;
+
+            case OP_LET:
+            case OP_LETARR1:
+                sym = jit_symbol(j, code[o+1]);
+                n = op == OP_LETARR1 ? 1 : code[o+2];
+                jit_emit(j, 1, 0x5e);               // pop rsi
+                if (n == 0) {
+                    jit_load_value_ptr(j, sym);
+                    jit_emit(j, 2, 0x89, 0x30);     // mov [rax], esi
+                }
+                else {
+                    if (n > 1)
+                        jit_emit(j, 1, 0x5a);       // pop rdx
+                    jit_emit(j, 1, 0x58);           // pop rax
+                    jit_element(j, sym, n);
+                    jit_emit(j, 2, 0x89, 0x31);     // mov [rcx], esi
+                }
+                o += op == OP_LETARR1 ? 2 : 3;
+                break;
+
+            case OP_NEG:
+            case OP_NOT:
+                jit_emit(j, 4, 0x58, 0xf7, op == OP_NEG ? 0xd8 : 0xd0, 0x50);
+                ++o;
+                break;
+
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_AND: case OP_OR:
+            case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NEQ:
+                jit_emit(j, 2, 0x59, 0x58);         // pop rcx; pop rax
+                if (op == OP_ADD)      jit_emit(j, 2, 0x01, 0xc8);
+                else if (op == OP_SUB) jit_emit(j, 2, 0x29, 0xc8);
+                else if (op == OP_MUL) jit_emit(j, 3, 0x0f, 0xaf, 0xc1);
+                else if (op == OP_DIV) jit_emit(j, 3, 0x99, 0xf7, 0xf9);   // cdq; idiv ecx
+                else if (op == OP_AND) jit_emit(j, 2, 0x21, 0xc8);
+                else if (op == OP_OR)  jit_emit(j, 2, 0x09, 0xc8);
+                else                                // cmp; setcc; movzx; neg gives -1 or 0
+                    jit_emit(j, 10, 0x39, 0xc8, 0x0f, jit_setcc[op - OP_LT], 0xc0, 0x0f, 0xb6, 0xc0, 0xf7, 0xd8);
+                jit_emit(j, 1, 0x50);
+                ++o;
+                break;
+
+            case OP_IFFALSE:
+                jit_emit(j, 3, 0x58, 0x85, 0xc0);   // pop rax; test eax, eax
+                jit_jump(j, 0x84, insn_code(ctx, code[o+1]));
+                o += 2;
+                break;
+
+            case OP_GOTOINSN:
+                jit_jump(j, 0, insn_code(ctx, code[o+1]));
+                o += 2;
+                break;
+
+            case OP_JUMP:
+                jit_jump(j, 0, code_get32(&code[o+1]));
+                o += 3;
+                break;
+
+            case OP_APPEND:
+                // the variable is a number, X = X + value
+                jit_emit(j, 6, 0x59, 0x58, 0x01, 0xc8, 0x89, 0xc6);   // pop rcx; pop rax; add eax, ecx; mov esi, eax
+                jit_load_value_ptr(j, jit_symbol(j, code[o+1]));
+                jit_emit(j, 2, 0x89, 0x30);         // mov [rax], esi
+                o += 4;
+                break;
+
+            case OP_ADDVAR:
+                // the generic code behind is not needed, the variable is a number
+                jit_load_value_ptr(j, jit_symbol(j, code[o+1]));
+                jit_emit(j, 2, 0x81, 0x00);         // add dword [rax], number
+                jit_emit32(j, code_get32(&code[o+2]));
+                o += 4 + 9;
+                break;
+
+            case OP_IFVAR:
+                if (code[o+11] != OP_IFFALSE)
+                    return 0;
+                jit_load_value_ptr(j, jit_symbol(j, code[o+1]));
+                jit_emit(j, 3, 0x8b, 0x00, 0x3d);   // mov eax, [rax]; cmp eax, number
+                jit_emit32(j, code_get32(&code[o+3]));
+                jit_jump(j, jit_jfalse[code[o+2] - OP_LT], insn_code(ctx, code[o+12]));
+                o += 5 + 6 + 2;
+                break;
+
+            case OP_NEXT:
+                if (o != j->stop)
+                    return 0;
+                jit_next(j, jit_symbol(j, code[o+1]));
+                o += 3;
+                break;
+
+            default:
+                return 0;
+        }
+    }
+    return !j->failed;
+}
+
+static int ICACHE_FLASH_ATTR jit_link(struct Jit *j)
+{
+    // resolve the jumps, those out of the loop return the code offset
+    int i, pos, target, to;
+
+    for (i=0; i<j->fixup_count; i+=2) {
+        pos    = j->fixup[i];
+        target = j->fixup[i+1];
+        if (target >= j->start && target <= j->stop && j->native[target - j->start] >= 0)
+            to = j->native[target - j->start];
+        else {
+            to = j->p - j->base;
+            jit_emit(j, 1, 0xb8);                   // mov eax, target; ret
+            jit_emit32(j, target);
+            jit_emit(j, 1, 0xc3);
+        }
+        if (j->failed)
+            return 0;
+        to -= pos + 4;
+        memcpy(j->base + pos, &to, 4);
+    }
+    return 1;
+}
+
+static int ICACHE_FLASH_ATTR jit_compile(struct urubasic_ctx *ctx, code_t *next, struct Frame *frame)
+{
+    // translate the loop which ends with next, returns its jit word
+    struct Jit j;
+    struct Jit_region *regions, *region;
+    int words = next - ctx->code - frame->offset + 3, i, ok = 0;
+
+    if (words < 3 || words > 0x7fff || ctx->jit_count >= 0x7ff0)
+        return JIT_FAILED;
+    if (ctx->jit_buffer == NULL) {
+        ctx->jit_buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ctx->jit_buffer == MAP_FAILED) {
+            ctx->jit_buffer = NULL;
+            return JIT_FAILED;
+        }
+    }
+    else if (mprotect(ctx->jit_buffer, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0)
+        return JIT_FAILED;
+
+    memset(&j, 0, sizeof(j));
+    j.ctx    = ctx;
+    j.base   = ctx->jit_buffer;
+    j.p      = j.base + ctx->jit_len;
+    j.end    = j.base + JIT_BUFFER_SIZE;
+    j.start  = frame->offset;
+    j.stop   = next - ctx->code;
+    j.native = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (words * sizeof(int)));
+    j.fixup  = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) ((words + 4) * 2 * sizeof(int)));
+    j.syms   = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (words * sizeof(SYMIDX)));
+    regions  = smemblk_realloc(ctx->symbol_names, ctx->jit_regions, (smemblk_size_t) ((ctx->jit_count + 1) * sizeof(*regions)));
+    if (regions != NULL)
+        ctx->jit_regions = regions;
+
+    if (j.native != NULL && j.fixup != NULL && j.syms != NULL && regions != NULL) {
+        for (i=0; i<words; ++i)
+            j.native[i] = -1;
+        ok = jit_translate(&j) && jit_link(&j);
+    }
+    mprotect(ctx->jit_buffer, JIT_BUFFER_SIZE, PROT_READ | PROT_EXEC);
+    smemblk_free(ctx->symbol_names, j.native);
+    smemblk_free(ctx->symbol_names, j.fixup);
+    if (!ok) {
+        smemblk_free(ctx->symbol_names, j.syms);
+        return JIT_FAILED;
+    }
+
+    region = &ctx->jit_regions[ctx->jit_count];
+    region->start       = j.start;
+    region->entry       = (int (*)(struct Frame *)) (void *) (j.base + ctx->jit_len);
+    region->syms        = smemblk_realloc(ctx->symbol_names, j.syms, (smemblk_size_t) (j.sym_count * sizeof(SYMIDX)));
+    region->sym_count   = j.sym_count;
+    region->option_base = ctx->option_base;
+    if (region->syms == NULL)
+        region->syms = j.syms;
+    ctx->jit_len = (j.p - j.base + 15) & ~15;
+    return -2 - ctx->jit_count++;
+}
+
+static int ICACHE_FLASH_ATTR jit_loop(struct urubasic_ctx *ctx, code_t *next, struct Frame *frame)
+{
+    // NEXT loops back: run the loop as machine code when it is hot, returns
+    // the code offset to continue at, or -1 to continue in the VM
+    struct Jit_region *region;
+    struct symbol_def *sym;
+    int i;
+
+    if (next[2] >= 0) {
+        if (++next[2] < JIT_THRESHOLD)
+            return -1;
+        next[2] = (code_t) jit_compile(ctx, next, frame);
+        if (next[2] == JIT_FAILED)
+            return -1;
+    }
+
+    region = &ctx->jit_regions[-2 - next[2]];
+    if (frame->var == NULL || frame->offset != region->start || ctx->option_base != region->option_base)
+        return -1;
+    for (i=0; i<region->sym_count; ++i) {
+        sym = get_symbol(region->syms[i]);
+        if (sym->value_ptr == NULL || (sym->value_type & 0xff) != NUMBER)
+            return -1;
+    }
+    return region->entry(frame);
+}
+#endif
+
+static struct urubasic_type * ICACHE_FLASH_ATTR vm_run(struct urubasic_ctx *ctx, code_t *pc, struct urubasic_type *sp)
+{
+    // execute the compiled program until STOP or the end of a DEF function
+    struct urubasic_type *arg, result;
+    struct symbol_def *sym;
+    struct Frame *frame;
+    int *value_ptr, n, v, end, step;
+#ifdef VM_THREADED
+    static const void *const dispatch[] = {
+        [OP_STOP] = &&L_OP_STOP,
+        [OP_JUMP] = &&L_OP_JUMP,
+        [OP_PUSHNUM] = &&L_OP_PUSHNUM,
+        [OP_PUSHSTR] = &&L_OP_PUSHSTR,
+        [OP_PUSHNIL] = &&L_OP_PUSHNIL,
+        [OP_LOADVAR] = &&L_OP_LOADVAR,
+        [OP_LOADARR1] = &&L_OP_LOADARR1,
+        [OP_LOADARR2] = &&L_OP_LOADARR2,
+        [OP_LOADPARAM] = &&L_OP_LOADPARAM,
+        [OP_LET] = &&L_OP_LET,
+        [OP_ASSIGN] = &&L_OP_ASSIGN,
+        [OP_NEG] = &&L_OP_NEG,
+        [OP_NOT] = &&L_OP_NOT,
+        [OP_ADD] = &&L_OP_ADD,
+        [OP_SUB] = &&L_OP_SUB,
+        [OP_MUL] = &&L_OP_MUL,
+        [OP_DIV] = &&L_OP_DIV,
+        [OP_POW] = &&L_OP_POW,
+        [OP_LT] = &&L_OP_LT,
+        [OP_LE] = &&L_OP_LE,
+        [OP_GT] = &&L_OP_GT,
+        [OP_GE] = &&L_OP_GE,
+        [OP_EQ] = &&L_OP_EQ,
+        [OP_NEQ] = &&L_OP_NEQ,
+        [OP_AND] = &&L_OP_AND,
+        [OP_OR] = &&L_OP_OR,
+        [OP_CALL] = &&L_OP_CALL,
+        [OP_CALLDEF] = &&L_OP_CALLDEF,
+        [OP_RETDEF] = &&L_OP_RETDEF,
+        [OP_POP] = &&L_OP_POP,
+        [OP_IFFALSE] = &&L_OP_IFFALSE,
+        [OP_GOTO] = &&L_OP_GOTO,
+        [OP_GOSUB] = &&L_OP_GOSUB,
+        [OP_GOTOINSN] = &&L_OP_GOTOINSN,
+        [OP_GOSUBINSN] = &&L_OP_GOSUBINSN,
+        [OP_RETURN] = &&L_OP_RETURN,
+        [OP_ONTARGET] = &&L_OP_ONTARGET,
+        [OP_ONTABLE] = &&L_OP_ONTABLE,
+        [OP_FOR] = &&L_OP_FOR,
+        [OP_NEXT] = &&L_OP_NEXT,
+        [OP_PRINTVAL] = &&L_OP_PRINTVAL,
+        [OP_PRINTSTR] = &&L_OP_PRINTSTR,
+        [OP_PRINTTAB] = &&L_OP_PRINTTAB,
+        [OP_PRINTCOMMA] = &&L_OP_PRINTCOMMA,
+        [OP_PRINTEND] = &&L_OP_PRINTEND,
+        [OP_READ] = &&L_OP_READ,
+        [OP_RESTORE] = &&L_OP_RESTORE,
+        [OP_OPTIONBASE] = &&L_OP_OPTIONBASE,
+        [OP_DIM] = &&L_OP_DIM,
+        [OP_ADDVAR] = &&L_OP_ADDVAR,
+        [OP_IFVAR] = &&L_OP_IFVAR,
+        [OP_LETARR1] = &&L_OP_LETARR1,
+        [OP_APPEND] = &&L_OP_APPEND,
+        [OP_LOADNUM] = &&L_OP_LOADNUM,
+        [OP_LETNUM] = &&L_OP_LETNUM,
+        [OP_NEGN] = &&L_OP_NEGN,
+        [OP_NOTN] = &&L_OP_NOTN,
+        [OP_ADDN] = &&L_OP_ADDN,
+        [OP_SUBN] = &&L_OP_SUBN,
+        [OP_MULN] = &&L_OP_MULN,
+        [OP_DIVN] = &&L_OP_DIVN,
+        [OP_POWN] = &&L_OP_POWN,
+        [OP_LTN] = &&L_OP_LTN,
+        [OP_LEN] = &&L_OP_LEN,
+        [OP_GTN] = &&L_OP_GTN,
+        [OP_GEN] = &&L_OP_GEN,
+        [OP_EQN] = &&L_OP_EQN,
+        [OP_NEQN] = &&L_OP_NEQN,
+        [OP_ANDN] = &&L_OP_ANDN,
+        [OP_ORN] = &&L_OP_ORN,
+    };
+#endif
+
+    while (1) {
+        switch (*pc++) {
+            VM_CASE(OP_STOP):
+                return NULL;
+
+            VM_CASE(OP_JUMP):
+                pc = ctx->code + code_get32(pc);
+                VM_NEXT;
+
+            VM_CASE(OP_PUSHNUM):
+                sp->type  = NUMBER;
+                sp->value = code_get32(pc);
+                ++sp;
+                pc += 2;
+                VM_NEXT;
+
+            VM_CASE(OP_PUSHSTR):
+                sp->type  = STRING;
+                sp->value = ~*pc++;
+                ++sp;
+                VM_NEXT;
+
+            VM_CASE(OP_PUSHNIL):
+                sp->type  = 0;
+                sp->value = 0;
+                ++sp;
+                VM_NEXT;
+
+            VM_CASE(OP_LOADVAR):
+                sym = get_symbol(code_symbol(ctx, *pc++));
+                if ((sym->value_type & 0xff) == STRING) {
+                    sp->type  = STRING;
+                    sp->value = *sym->value_ptr;
+                }
+                else {
+                    value_ptr = sym->value_ptr;
+                    if (value_ptr == NULL) {
+                        ctx->vm_pc = pc;
+                        value_ptr = vm_element(ctx, sym, 0, sp);
+                    }
+                    sp->type  = NUMBER;
+                    sp->value = value_ptr != NULL ? *value_ptr : 0;
+                }
+                ++sp;
+                VM_NEXT;
+
+            VM_CASE(OP_LOADPARAM):
+                arg = &ctx->vm_fp[*pc++];
+                *sp = *arg;
+                if (arg->type != NUMBER) {
+                    // the parameter shares its string
+                    string_retain(ctx, arg->value);
+                    sp->type = STRING|ALLOC;
+                }
+                ++sp;
+                VM_NEXT;
+
+            VM_CASE(OP_LOADARR1):
+            VM_CASE(OP_LOADARR2):
+                n = pc[-1] == OP_LOADARR1 ? 1 : 2;
+                sym = get_symbol(code_symbol(ctx, *pc++));
+                sp -= n;
+                if ((sym->value_type & 0xff) == STRING) {
+                    vm_release(ctx, sp, n);
+                    sp->type  = STRING;
+                    sp->value = *sym->value_ptr;
+                }
+                else {
+                    if (sym->value_ptr != NULL && n == 1)
+                        value_ptr = sym->value_ptr + (sp[0].value - ctx->option_base);
+                    else if (sym->value_ptr != NULL)
+                        value_ptr = sym->value_ptr + sym->array_base_size * (sp[1].value - ctx->option_base) + (sp[0].value - ctx->option_base);
+                    else {
+                        ctx->vm_pc = pc;
+                        value_ptr = vm_element(ctx, sym, n, sp);
+                    }
+                    sp->type  = NUMBER;
+                    sp->value = value_ptr != NULL ? *value_ptr : 0;
+                }
+                ++sp;
+                VM_NEXT;
+
+            VM_CASE(OP_LET):
+                // pc moves on after the assignment, an error shows the line of the LET
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                n = pc[1];
+                sp -= n + 1;
+                if (n == 0 && sp->type == NUMBER && sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER)
+                    *sym->value_ptr = sp->value;
+                else {
+                    ctx->vm_pc = pc;
+                    vm_let(ctx, sym, n, sp);
+                }
+                pc += 2;
+                VM_NEXT;
+
+            VM_CASE(OP_ASSIGN):
+                sym = get_symbol(code_symbol(ctx, *pc++));
+                --sp;
+                ctx->vm_pc = pc;
+                value_ptr = vm_number(ctx, sym, 0, sp);
+                if (value_ptr != NULL)
+                    *value_ptr = sp->value;
+                vm_release(ctx, sp, 1);
+                VM_NEXT;
+
+            VM_CASE(OP_NEG):
+                if (sp[-1].type == NUMBER)
+                    sp[-1].value = -sp[-1].value;
+                else
+                    vm_error(ctx, pc, E_SYNTAX_ERROR);
+                VM_NEXT;
+
+            VM_CASE(OP_NOT):
+                if (sp[-1].type == NUMBER)
+                    sp[-1].value = ~sp[-1].value;
+                else
+                    vm_error(ctx, pc, E_SYNTAX_ERROR);
+                VM_NEXT;
+
+            VM_CASE(OP_ADD):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value += sp->value; else { ctx->vm_pc = pc; vm_operator(ctx, PLUS, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_SUB):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value -= sp->value; else { ctx->vm_pc = pc; vm_operator(ctx, MINUS, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_MUL):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value *= sp->value; else { ctx->vm_pc = pc; vm_operator(ctx, MULT, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_DIV):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value /= sp->value; else { ctx->vm_pc = pc; vm_operator(ctx, SOLIDUS, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_POW):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value = power(sp[-1].value, sp->value); else { ctx->vm_pc = pc; vm_operator(ctx, CIRCUMFLEX, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_LT):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value = sp[-1].value < sp->value ? -1 : 0; else { ctx->vm_pc = pc; vm_operator(ctx, LT, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_LE):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value = sp[-1].value <= sp->value ? -1 : 0; else { ctx->vm_pc = pc; vm_operator(ctx, LE, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_GT):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value = sp[-1].value > sp->value ? -1 : 0; else { ctx->vm_pc = pc; vm_operator(ctx, GT, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_GE):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value = sp[-1].value >= sp->value ? -1 : 0; else { ctx->vm_pc = pc; vm_operator(ctx, GE, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_EQ):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value = sp[-1].value == sp->value ? -1 : 0; else { ctx->vm_pc = pc; vm_operator(ctx, EQ, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_NEQ):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value = sp[-1].value != sp->value ? -1 : 0; else { ctx->vm_pc = pc; vm_operator(ctx, NEQ, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_AND):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value &= sp->value; else { ctx->vm_pc = pc; vm_operator(ctx, AND, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_OR):
+                --sp;
+                if (vm_numbers(sp)) sp[-1].value |= sp->value; else { ctx->vm_pc = pc; vm_operator(ctx, OR, sp-1, sp); }
+                VM_NEXT;
+
+            VM_CASE(OP_CALL):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                n = pc[1];
+                pc += 2;
+                arg = sp - n - 1;
+                ctx->vm_pc = pc;
+                call_function(ctx, sym, n + 1, arg);
+                vm_release(ctx, arg + 1, n);
+                sp = arg + 1;
+                VM_NEXT;
+
+            VM_CASE(OP_CALLDEF):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                n = pc[1];
+                pc += 2;
+                arg = sp - n;
+                result.type  = NUMBER;
+                result.value = 0;
+                if (sym->array_base_size < 0)
+                    vm_error(ctx, pc, E_MISSING_DEF);
+                else if (sp + sym->value_type + ctx->code_max_depth > ctx->vm_stack + ctx->vm_stack_size)
+                    vm_error(ctx, pc, E_OUT_OF_MEMORY);
+                else {
+                    // the arguments on the stack are the frame of the function
+                    struct urubasic_type *fp = ctx->vm_fp;
+
+                    for ( ; n < sym->value_type; ++n, ++sp) {
+                        sp->type  = NUMBER;
+                        sp->value = 0;
+                    }
+                    ctx->vm_fp = arg;
+                    result = vm_run(ctx, ctx->code + sym->array_base_size, sp)[-1];
+                    ctx->vm_fp = fp;
+                }
+                vm_release(ctx, arg, n);
+                *arg = result;
+                sp = arg + 1;
+                VM_NEXT;
+
+            VM_CASE(OP_RETDEF):
+                return sp;
+
+            VM_CASE(OP_POP):
+                --sp;
+                vm_release(ctx, sp, 1);
+                VM_NEXT;
+
+            VM_CASE(OP_IFFALSE):
+                --sp;
+                v = sp->value;
+                vm_release(ctx, sp, 1);
+                if (v == 0)
+                    pc = ctx->code + insn_code(ctx, *pc);
+                else
+                    ++pc;
+                VM_NEXT;
+
+            VM_CASE(OP_GOTO):
+                --sp;
+                vm_release(ctx, sp, 1);
+                pc = ctx->code + insn_code(ctx, find_insn(ctx, sp->value));
+                VM_NEXT;
+
+            VM_CASE(OP_GOSUB):
+                --sp;
+                vm_release(ctx, sp, 1);
+                if (!vm_push_frame(ctx, NULL, pc - ctx->code, -1, 0)) {
+                    ctx->vm_pc = pc;
+                    return NULL;
+                }
+                pc = ctx->code + insn_code(ctx, find_insn(ctx, sp->value));
+                VM_NEXT;
+
+            VM_CASE(OP_GOTOINSN):
+                pc = ctx->code + insn_code(ctx, *pc);
+                VM_NEXT;
+
+            VM_CASE(OP_GOSUBINSN):
+                if (!vm_push_frame(ctx, NULL, pc + 1 - ctx->code, -1, 0)) {
+                    ctx->vm_pc = pc;
+                    return NULL;
+                }
+                pc = ctx->code + insn_code(ctx, *pc);
+                VM_NEXT;
+
+            VM_CASE(OP_RETURN):
+                do {
+                    // pop stack until we find a GOSUB
+                    if (ctx->frame_count == 0)
+                        return NULL;
+                    frame = &ctx->frame_stack[--ctx->frame_count];
+                } while (frame->var != NULL);
+                pc = ctx->code + frame->offset;
+                VM_NEXT;
+
+            VM_CASE(OP_ONTARGET):
+                --sp;
+                if (sp[-1].value != pc[0]) {
+                    vm_release(ctx, sp, 1);
+                    pc += 3;
+                }
+                else {
+                    v = sp->value;
+                    vm_release(ctx, sp, 1);
+                    --sp;
+                    if (pc[1] && !vm_push_frame(ctx, NULL, insn_code(ctx, pc[2]+1), -1, 0)) {
+                        ctx->vm_pc = pc;
+                        return NULL;
+                    }
+                    pc = ctx->code + insn_code(ctx, find_insn(ctx, v));
+                }
+                VM_NEXT;
+
+            VM_CASE(OP_ONTABLE):
+                --sp;
+                v = sp->value;
+                vm_release(ctx, sp, 1);
+                if (v < 1 || v > pc[0])
+                    pc += 3 + pc[0];
+                else {
+                    if (pc[1] && !vm_push_frame(ctx, NULL, insn_code(ctx, pc[2]+1), -1, 0)) {
+                        ctx->vm_pc = pc;
+                        return NULL;
+                    }
+                    pc = ctx->code + insn_code(ctx, pc[2+v]);
+                }
+                VM_NEXT;
+
+            VM_CASE(OP_FOR):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                sp -= 2;
+                end  = sp[0].value;
+                step = sp[1].value;
+                v    = pc + 3 - ctx->code;
+
+                // the same loop entered again replaces its frame and all frames above
+                n = pc[2];
+                if (n > 0 && n <= ctx->frame_count && ctx->frame_stack[n-1].offset == v)
+                    ctx->frame_count = n - 1;
+
+                ctx->vm_pc = pc;
+                value_ptr = vm_number(ctx, sym, 0, sp);
+                if (value_ptr != NULL && ((step > 0 && *value_ptr > end) || (step < 0 && *value_ptr < end))) {
+                    // the loop is not executed at all: continue behind the matching NEXT
+                    *value_ptr += step;
+                    pc = ctx->code + insn_code(ctx, pc[1]);
+                }
+                else {
+                    if (!vm_push_frame(ctx, sym, v, end, step))
+                        return NULL;
+                    pc[2] = ctx->frame_count;
+                    pc += 3;
+                }
+                VM_NEXT;
+
+            VM_CASE(OP_NEXT):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                pc += 2;
+                if (ctx->frame_count > 0) {
+                    frame = &ctx->frame_stack[ctx->frame_count-1];
+                    value_ptr = sym->value_ptr;
+                    if (value_ptr == NULL || (sym->value_type & 0xff) != NUMBER) {
+                        ctx->vm_pc = pc - 2;
+                        value_ptr = vm_number(ctx, sym, 0, sp);
+                        if (value_ptr == NULL)
+                            VM_NEXT;
+                    }
+                    v = *value_ptr += frame->step;
+                    if ((frame->step > 0 && v > frame->end) || (frame->step < 0 && v < frame->end))
+                        --ctx->frame_count;  // loop finished
+                    else {
+#ifdef URUBASIC_JIT
+                        if (pc[-1] != JIT_FAILED && (v = jit_loop(ctx, pc - 3, frame)) >= 0) {
+                            pc = ctx->code + v;
+                            VM_NEXT;
+                        }
+#endif
+                        pc = ctx->code + frame->offset;
+                    }
+                }
+                else
+                    vm_error(ctx, pc - 2, E_NEXT_WITHOUT_FOR);
+                VM_NEXT;
+
+            VM_CASE(OP_PRINTVAL):
+                vm_print(ctx, --sp);
+                VM_NEXT;
+
+            VM_CASE(OP_PRINTSTR):
+                print_text(ctx, ctx->const_pool + *pc, ((struct String *) (ctx->const_pool + *pc) - 1)->len);
+                ++pc;
+                VM_NEXT;
+
+            VM_CASE(OP_PRINTTAB):
+                --sp;
+                print_tab(ctx, sp->value);
+                VM_NEXT;
+
+            VM_CASE(OP_PRINTCOMMA):
+                print_tab(ctx, ctx->print_column + (PRINT_ZONE_LEN - (ctx->print_column % PRINT_ZONE_LEN)));
+                VM_NEXT;
+
+            VM_CASE(OP_PRINTEND):
+                print_end(ctx, *pc++);
+                VM_NEXT;
+
+            VM_CASE(OP_READ):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                n = pc[1];
+                sp -= n;
+                ctx->vm_pc = pc;
+                vm_read(ctx, sym, n, sp);
+                pc += 2;
+                VM_NEXT;
+
+            VM_CASE(OP_RESTORE):
+                ctx->data_buffer_index = 0;
+                VM_NEXT;
+
+            VM_CASE(OP_OPTIONBASE):
+                --sp;
+                if (sp->value == 0 || sp->value == 1)
+                    ctx->option_base = sp->value;
+                else
+                    vm_error(ctx, pc - 1, E_INVALID_OPTION_BASE);
+                VM_NEXT;
+
+            VM_CASE(OP_DIM):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                n = pc[1];
+                sp -= n;
+                ctx->vm_pc = pc;
+                vm_dim(ctx, sym, n, sp);
+                pc += 2;
+                VM_NEXT;
+
+            VM_CASE(OP_ADDVAR):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                if (sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER) {
+                    *sym->value_ptr += code_get32(pc + 1);
+                    pc += 3 + 9;
+                }
+                else
+                    pc += 3;
+                VM_NEXT;
+
+            VM_CASE(OP_IFVAR):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                if (sym->value_ptr == NULL || (sym->value_type & 0xff) != NUMBER) {
+                    pc += 4;
+                    VM_NEXT;
+                }
+                v = *sym->value_ptr;
+                n = code_get32(pc + 2);
+                if (pc[1] == OP_LT)      v = v < n;
+                else if (pc[1] == OP_LE) v = v <= n;
+                else if (pc[1] == OP_GT) v = v > n;
+                else if (pc[1] == OP_GE) v = v >= n;
+                else if (pc[1] == OP_EQ) v = v == n;
+                else                     v = v != n;
+                pc += 4 + 6;    // OP_IFFALSE of the generic code
+                pc = v ? pc + 2 : ctx->code + insn_code(ctx, pc[1]);
+                VM_NEXT;
+
+            VM_CASE(OP_LETARR1):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                sp -= 2;
+                if (sp[1].type == NUMBER && sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER)
+                    sym->value_ptr[sp[0].value - ctx->option_base] = sp[1].value;
+                else {
+                    ctx->vm_pc = pc;
+                    vm_let(ctx, sym, 1, sp);
+                }
+                ++pc;
+                VM_NEXT;
+
+            VM_CASE(OP_APPEND):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                sp -= 2;
+                if (vm_numbers(sp + 1) && sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER)
+                    *sym->value_ptr = sp[0].value + sp[1].value;
+                else {
+                    ctx->vm_pc = pc;
+                    vm_append(ctx, sym, sp);
+                }
+                pc += 3;
+                VM_NEXT;
+
+            VM_CASE(OP_LOADNUM):
+                sym = get_symbol(code_symbol(ctx, *pc++));
+                value_ptr = sym->value_ptr;
+                if (value_ptr == NULL) {
+                    ctx->vm_pc = pc;
+                    value_ptr = vm_element(ctx, sym, 0, sp);
+                }
+                sp->type  = NUMBER;
+                sp->value = value_ptr != NULL ? *value_ptr : 0;
+                ++sp;
+                VM_NEXT;
+
+            VM_CASE(OP_LETNUM):
+                sym = get_symbol(code_symbol(ctx, pc[0]));
+                --sp;
+                if (sym->value_ptr != NULL)
+                    *sym->value_ptr = sp->value;
+                else {
+                    ctx->vm_pc = pc;
+                    vm_let(ctx, sym, 0, sp);
+                }
+                pc += 2;
+                VM_NEXT;
+
+            VM_CASE(OP_NEGN):
+                sp[-1].value = -sp[-1].value;
+                VM_NEXT;
+
+            VM_CASE(OP_NOTN):
+                sp[-1].value = ~sp[-1].value;
+                VM_NEXT;
+
+            VM_CASE(OP_ADDN):
+                --sp;
+                sp[-1].value += sp->value;
+                VM_NEXT;
+
+            VM_CASE(OP_SUBN):
+                --sp;
+                sp[-1].value -= sp->value;
+                VM_NEXT;
+
+            VM_CASE(OP_MULN):
+                --sp;
+                sp[-1].value *= sp->value;
+                VM_NEXT;
+
+            VM_CASE(OP_DIVN):
+                --sp;
+                sp[-1].value /= sp->value;
+                VM_NEXT;
+
+            VM_CASE(OP_POWN):
+                --sp;
+                sp[-1].value = power(sp[-1].value, sp->value);
+                VM_NEXT;
+
+            VM_CASE(OP_LTN):
+                --sp;
+                sp[-1].value = sp[-1].value < sp->value ? -1 : 0;
+                VM_NEXT;
+
+            VM_CASE(OP_LEN):
+                --sp;
+                sp[-1].value = sp[-1].value <= sp->value ? -1 : 0;
+                VM_NEXT;
+
+            VM_CASE(OP_GTN):
+                --sp;
+                sp[-1].value = sp[-1].value > sp->value ? -1 : 0;
+                VM_NEXT;
+
+            VM_CASE(OP_GEN):
+                --sp;
+                sp[-1].value = sp[-1].value >= sp->value ? -1 : 0;
+                VM_NEXT;
+
+            VM_CASE(OP_EQN):
+                --sp;
+                sp[-1].value = sp[-1].value == sp->value ? -1 : 0;
+                VM_NEXT;
+
+            VM_CASE(OP_NEQN):
+                --sp;
+                sp[-1].value = sp[-1].value != sp->value ? -1 : 0;
+                VM_NEXT;
+
+            VM_CASE(OP_ANDN):
+                --sp;
+                sp[-1].value &= sp->value;
+                VM_NEXT;
+
+            VM_CASE(OP_ORN):
+                --sp;
+                sp[-1].value |= sp->value;
+                VM_NEXT;
+
+            default:
+                vm_error(ctx, pc, E_SYNTAX_ERROR);
+                return NULL;
+        }
+    }
+}
+
+static void ICACHE_FLASH_ATTR lex_setup(struct urubasic_ctx *ctx, int insn)
+{
+    // setup the lexer to read a crunched instruction
+    ctx->pushed_token_stack[0] = 0;
+    ctx->lex_tokens = (const unsigned char *) ctx->insn_info[insn].line;
+    ctx->lex_insn = insn;
+    ctx->current_line = ctx->insn_info[insn].label;
+}
+
+static int ICACHE_FLASH_ATTR code_op_len(code_t *p)
+{
+    // number of words of the instruction at p
+    switch (p[0]) {
+        case OP_JUMP: case OP_PUSHNUM: case OP_LET: case OP_CALL: case OP_CALLDEF:
+        case OP_NEXT: case OP_READ: case OP_DIM: case OP_LETNUM:
+            return 3;
+        case OP_PUSHSTR: case OP_LOADVAR: case OP_LOADARR1: case OP_LOADARR2: case OP_LOADPARAM:
+        case OP_ASSIGN: case OP_IFFALSE: case OP_GOTOINSN: case OP_GOSUBINSN: case OP_PRINTSTR:
+        case OP_PRINTEND: case OP_LETARR1: case OP_LOADNUM:
+            return 2;
+        case OP_ONTARGET: case OP_FOR: case OP_ADDVAR: case OP_APPEND:
+            return 4;
+        case OP_ONTABLE:
+            return 4 + p[1];
+        case OP_IFVAR:
+            return 5;
+        default:
+            return 1;
+    }
+}
+
+// what a variable, a DEF function or a value on the stack may hold
+enum Types {
+    MAY_NUMBER = 1,
+    MAY_STRING = 2,
+    MAY_ANY    = 3,
+};
+
+struct Type_info {
+    uint8_t var;        // variable or array
+    uint8_t param;      // arguments of a DEF function
+    uint8_t result;     // result of a DEF function
+};
+
+static int ICACHE_FLASH_ATTR may_hold(int types)
+{
+    // a variable which is never assigned holds 0
+    return types != 0 ? types : MAY_NUMBER;
+}
+
+static int ICACHE_FLASH_ATTR merge_types(uint8_t *types, int t)
+{
+    // 1 if the types have grown
+    if ((*types | t) == *types)
+        return 0;
+    *types |= (uint8_t) t;
+    return 1;
+}
+
+static int ICACHE_FLASH_ATTR infer_walk(struct urubasic_ctx *ctx, struct Type_info *info, uint8_t *stack, int data, int rewrite)
+{
+    // one pass over the code with the types of the values on the stack, the types
+    // of the assignments are merged into info. 1 is returned when a type has grown,
+    // -1 when the stack does not fit the code. rewrite replaces the operations
+    // which only see numbers
+    code_t *code = ctx->code;
+    struct symbol_def *sym;
+    int o, op, i, n, depth = 0, def = 0, grown = 0;
+
+    for (o=0; o<ctx->code_len; o+=code_op_len(code + o)) {
+        switch (op = code[o]) {
+            case OP_PUSHNUM:
+                stack[depth++] = MAY_NUMBER;
+                break;
+
+            case OP_PUSHSTR:
+                stack[depth++] = MAY_STRING;
+                break;
+
+            case OP_PUSHNIL:
+                stack[depth++] = MAY_ANY;
+                break;
+
+            case OP_LOADVAR:
+                stack[depth] = (uint8_t) may_hold(info[code[o+1]].var);
+                if (rewrite && stack[depth] == MAY_NUMBER)
+                    code[o] = OP_LOADNUM;
+                ++depth;
+                break;
+
+            case OP_LOADARR1:
+            case OP_LOADARR2:
+                depth -= op == OP_LOADARR1 ? 1 : 2;
+                stack[depth++] = (uint8_t) may_hold(info[code[o+1]].var);
+                break;
+
+            case OP_LOADPARAM:
+                stack[depth++] = (uint8_t) (def != 0 ? may_hold(info[def].param) : MAY_ANY);
+                break;
+
+            case OP_LET:
+            case OP_LETARR1:
+                n = op == OP_LETARR1 ? 1 : code[o+2];
+                depth -= n + 1;
+                grown |= merge_types(&info[code[o+1]].var, stack[depth+n]);
+                if (rewrite && n == 0 && stack[depth] == MAY_NUMBER && may_hold(info[code[o+1]].var) == MAY_NUMBER)
+                    code[o] = OP_LETNUM;
+                break;
+
+            case OP_ASSIGN:
+                --depth;
+                grown |= merge_types(&info[code[o+1]].var, MAY_NUMBER);
+                break;
+
+            case OP_APPEND:
+                // the sum of two numbers is assigned without checks
+                depth -= 2;
+                grown |= merge_types(&info[code[o+1]].var, stack[depth] == MAY_NUMBER && stack[depth+1] == MAY_NUMBER ? MAY_NUMBER : MAY_ANY);
+                if (rewrite && stack[depth] == MAY_NUMBER && stack[depth+1] == MAY_NUMBER && may_hold(info[code[o+1]].var) == MAY_NUMBER) {
+                    code[o+2] = code[o+1];
+                    code[o+1] = OP_LETNUM;
+                    code[o+3] = 0;
+                    code[o]   = OP_ADDN;
+                }
+                break;
+
+            case OP_READ:
+            case OP_DIM:
+                depth -= code[o+2];
+                grown |= merge_types(&info[code[o+1]].var, op == OP_READ ? data : MAY_NUMBER);
+                break;
+
+            case OP_NEG:
+            case OP_NOT:
+                // a string stays on the stack after the error
+                if (rewrite && stack[depth-1] == MAY_NUMBER)
+                    code[o] = (code_t) (op + OP_NEGN - OP_NEG);
+                break;
+
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_POW: case OP_LT: case OP_LE:
+            case OP_GT: case OP_GE: case OP_EQ: case OP_NEQ: case OP_AND: case OP_OR:
+                --depth;
+                stack[depth-1] = stack[depth-1] == MAY_NUMBER && stack[depth] == MAY_NUMBER ? MAY_NUMBER : MAY_ANY;
+                if (rewrite && stack[depth-1] == MAY_NUMBER)
+                    code[o] = (code_t) (op + OP_NEGN - OP_NEG);
+                break;
+
+            case OP_CALL:
+                // host functions may return anything
+                depth -= code[o+2];
+                stack[depth-1] = MAY_ANY;
+                break;
+
+            case OP_CALLDEF:
+                // a missing DEF function gives 0
+                depth -= code[o+2];
+                for (i=0; i<code[o+2]; ++i)
+                    grown |= merge_types(&info[code[o+1]].param, stack[depth+i]);
+                stack[depth++] = (uint8_t) (may_hold(info[code[o+1]].result) | MAY_NUMBER);
+                break;
+
+            case OP_JUMP:
+                // DEF skips its function body
+                for (i=1, def=0; i<=ctx->slot_count && def == 0; ++i) {
+                    sym = get_symbol(ctx->slot_table[i]);
+                    if (sym->tok == FUNCTION && sym->func == 0 && sym->array_base_size == o + 3)
+                        def = i;
+                }
+                break;
+
+            case OP_RETDEF:
+                --depth;
+                if (def != 0)
+                    grown |= merge_types(&info[def].result, stack[depth]);
+                def = 0;
+                break;
+
+            case OP_POP: case OP_IFFALSE: case OP_GOTO: case OP_GOSUB: case OP_ONTARGET: case OP_ONTABLE:
+            case OP_PRINTVAL: case OP_PRINTTAB: case OP_OPTIONBASE:
+                --depth;
+                break;
+
+            case OP_FOR:
+                depth -= 2;
+                break;
+        }
+        if (depth < 0 || depth > ctx->code_max_depth)
+            return -1;
+    }
+    return grown;
+}
+
+static void ICACHE_FLASH_ATTR infer_types(struct urubasic_ctx *ctx)
+{
+    // whole program type inference: a variable may hold a string only if one of
+    // its assignments may store one, the operations which are proven to see
+    // numbers only are replaced by variants without type checks
+    struct Type_info *info;
+    uint8_t *stack;
+    int i, data = 0, grown;
+
+    // DATA with a string may turn any variable of READ into a string
+    for (i=0; i<ctx->data_buffer_max; i+=data_len(&ctx->data_buffer[i])) {
+        if (ctx->data_buffer[i] != 0)
+            data |= ctx->data_buffer[i] == -1 ? MAY_STRING : MAY_NUMBER;
+    }
+
+    // the stack has room below and above for a pass which goes wrong
+    info  = smemblk_zalloc(ctx->symbol_names, (smemblk_size_t) ((ctx->slot_count + 1) * sizeof(struct Type_info)));
+    stack = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (ctx->code_max_depth + 8));
+    if (info != NULL && stack != NULL) {
+        // the types only grow, a few passes reach the fixpoint
+        do
+            grown = infer_walk(ctx, info, stack + 4, data, 0);
+        while (grown == 1);
+        if (grown == 0)
+            infer_walk(ctx, info, stack + 4, data, 1);
+    }
+    smemblk_free(ctx->symbol_names, stack);
+    smemblk_free(ctx->symbol_names, info);
+}
+
+static int ICACHE_FLASH_ATTR code_ends(int op)
+{
+    // the operation never continues with the code behind
+    return op == OP_GOTOINSN || op == OP_GOTO || op == OP_RETURN || op == OP_STOP;
+}
+
+static int ICACHE_FLASH_ATTR code_live(struct urubasic_ctx *ctx, int insn)
+{
+    // whether the instruction may run: the program or a GOTO may start there,
+    // the instruction before or an IF may continue with it. FOR, NEXT and DEF
+    // are always compiled, the loops and functions depend on them
+    int tok = (unsigned char) ctx->insn_info[insn].line[0];
+
+    return ctx->optimize < 1 || insn == 0 || ctx->code_falls || insn == ctx->code_target
+        || ctx->insn_info[insn].label_max > ctx->insn_info[insn-1].label_max
+        || tok == FOR || tok == NEXT || tok == DEF;
+}
+
+// changes of the optimizer, they are applied at once and move the code behind
+struct Code_edit {
+    int offset;         // first word of the old code
+    int len;            // number of old words which are replaced
+    int word, count;    // the new words in Code_edits.words
+};
+
+struct Code_edits {
+    struct Code_edit *edit;
+    code_t *words;
+    int n, max, word_len, word_max, failed;
+};
+
+// a value on the stack while the optimizer looks at an expression
+struct Expr {
+    int start, end;     // code of the value
+    int ops;            // number of operators in it
+    int8_t kind;
+    int value;          // EXPR_CONST: the number
+    int k, d;           // EXPR_INDUCTION: k * loop variable + d
+};
+
+enum Expr_kinds {
+    EXPR_OTHER,
+    EXPR_CONST,         // number
+    EXPR_INVARIANT,     // does not change in the loop
+    EXPR_INDUCTION,     // changes by a constant with every NEXT
+};
+
+static void ICACHE_FLASH_ATTR edit_add(struct urubasic_ctx *ctx, struct Code_edits *e, int offset, int len)
+{
+    // start an edit which replaces len words at offset, edit_word() adds the new words
+    struct Code_edit *p = NULL;
+
+    if (e->failed)
+        return;
+    if (e->n >= e->max) {
+        if ((e->max + 16) * sizeof(*p) < SMEMBLK_MAX_SIZE)
+            p = smemblk_realloc(ctx->symbol_names, e->edit, (smemblk_size_t) ((e->max + 16) * sizeof(*p)));
+        if (p == NULL) {
+            e->failed = 1;
+            return;
+        }
+        e->edit = p;
+        e->max += 16;
+    }
+    p = &e->edit[e->n++];
+    p->offset = offset;
+    p->len    = len;
+    p->word   = e->word_len;
+    p->count  = 0;
+}
+
+static void ICACHE_FLASH_ATTR edit_word(struct urubasic_ctx *ctx, struct Code_edits *e, int w)
+{
+    code_t *p = NULL;
+
+    if (e->failed)
+        return;
+    if (e->word_len >= e->word_max) {
+        if ((e->word_max + CODE_CHUNK) * sizeof(code_t) < SMEMBLK_MAX_SIZE)
+            p = smemblk_realloc(ctx->symbol_names, e->words, (smemblk_size_t) ((e->word_max + CODE_CHUNK) * sizeof(code_t)));
+        if (p == NULL) {
+            e->failed = 1;
+            return;
+        }
+        e->words = p;
+        e->word_max += CODE_CHUNK;
+    }
+    e->words[e->word_len++] = (code_t) w;
+    e->edit[e->n-1].count++;
+}
+
+static void ICACHE_FLASH_ATTR edit_word32(struct urubasic_ctx *ctx, struct Code_edits *e, int value)
+{
+    edit_word(ctx, e, value & 0xffff);
+    edit_word(ctx, e, (value >> 16) & 0xffff);
+}
+
+static int ICACHE_FLASH_ATTR edit_offset(struct Code_edits *e, int offset)
+{
+    // new offset of the old code at offset, e is sorted
+    int i, moved = offset;
+
+    for (i=0; i<e->n && e->edit[i].offset < offset; ++i)
+        moved += e->edit[i].count - e->edit[i].len;
+    return moved;
+}
+
+static void ICACHE_FLASH_ATTR edit_apply(struct urubasic_ctx *ctx, struct Code_edits *e)
+{
+    // rebuild the code with the edits, the code offsets of jumps, instructions
+    // and DEF functions move along
+    struct Code_edit t;
+    struct symbol_def *sym;
+    code_t *code = NULL;
+    int i, j, o, n, len = ctx->code_len;
+
+    for (i=1; i<e->n; ++i) {
+        for (j=i; j>0 && e->edit[j-1].offset > e->edit[j].offset; --j) {
+            t = e->edit[j];
+            e->edit[j] = e->edit[j-1];
+            e->edit[j-1] = t;
+        }
+    }
+    for (i=0; i<e->n; ++i)
+        len += e->edit[i].count - e->edit[i].len;
+    if (!e->failed && e->n > 0 && len < CODE_MAX && len * sizeof(code_t) < SMEMBLK_MAX_SIZE)
+        code = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (len * sizeof(code_t)));
+    if (code == NULL)
+        return;
+
+    for (o=0, n=0, i=0; o<ctx->code_len; ) {
+        if (i < e->n && e->edit[i].offset == o) {
+            memcpy(code + n, e->words + e->edit[i].word, e->edit[i].count * sizeof(code_t));
+            n += e->edit[i].count;
+            o += e->edit[i].len;
+            ++i;
+            continue;
+        }
+        j = code_op_len(ctx->code + o);
+        memcpy(code + n, ctx->code + o, j * sizeof(code_t));
+        if (code[n] == OP_JUMP) {
+            int target = edit_offset(e, code_get32(&code[n+1]));
+            code[n+1] = (code_t) (target & 0xffff);
+            code[n+2] = (code_t) ((target >> 16) & 0xffff);
+        }
+        n += j;
+        o += j;
+    }
+
+    for (i=0; i<ctx->insn_count; ++i)
+        ctx->insn_info[i].code = edit_offset(e, ctx->insn_info[i].code);
+    for (i=1; i<=ctx->slot_count; ++i) {
+        sym = get_symbol(ctx->slot_table[i]);
+        if (sym->tok == FUNCTION && sym->func == 0 && sym->array_base_size >= 0)
+            sym->array_base_size = (smemblk_size_t) edit_offset(e, sym->array_base_size);
+    }
+    smemblk_free(ctx->symbol_names, ctx->code);
+    ctx->code = code;
+    ctx->code_len = ctx->code_max = len;
+}
+
+static void ICACHE_FLASH_ATTR edit_free(struct urubasic_ctx *ctx, struct Code_edits *e)
+{
+    smemblk_free(ctx->symbol_names, e->edit);
+    smemblk_free(ctx->symbol_names, e->words);
+    memset(e, 0, sizeof(*e));
+}
+
+static int ICACHE_FLASH_ATTR code_op_stack(code_t *p, int *pops)
+{
+    // number of values the operation at p takes from the stack, returns the number it pushes
+    *pops = 0;
+    switch (p[0]) {
+        case OP_PUSHNUM: case OP_PUSHSTR: case OP_PUSHNIL: case OP_LOADVAR: case OP_LOADNUM: case OP_LOADPARAM:
+            return 1;
+        case OP_LOADARR1: case OP_LOADARR2:
+            *pops = p[0] == OP_LOADARR1 ? 1 : 2;
+            return 1;
+        case OP_LET: case OP_LETNUM:
+            *pops = p[2] + 1;
+            return 0;
+        case OP_LETARR1: case OP_FOR: case OP_APPEND:
+            *pops = 2;
+            return 0;
+        case OP_READ: case OP_DIM:
+            *pops = p[2];
+            return 0;
+        case OP_CALL:
+            *pops = p[2] + 1;
+            return 1;
+        case OP_CALLDEF:
+            *pops = p[2];
+            return 1;
+        case OP_NEG: case OP_NOT: case OP_NEGN: case OP_NOTN:
+            *pops = 1;
+            return 1;
+        case OP_ASSIGN: case OP_RETDEF: case OP_POP: case OP_IFFALSE: case OP_GOTO: case OP_GOSUB:
+        case OP_ONTARGET: case OP_ONTABLE: case OP_PRINTVAL: case OP_PRINTTAB: case OP_OPTIONBASE:
+            *pops = 1;
+            return 0;
+        default:
+            if ((p[0] >= OP_ADD && p[0] <= OP_OR) || (p[0] >= OP_ADDN && p[0] <= OP_ORN)) {
+                *pops = 2;
+                return 1;
+            }
+            return 0;
+    }
+}
+
+static void ICACHE_FLASH_ATTR optimize_propagate(struct urubasic_ctx *ctx, struct Code_edits *e)
+{
+    // a variable which is assigned once, to a number and before the first jump
+    // of the program, is replaced by the number in the code behind
+    int *info, o, op, prev = -1, s, prefix = 1;
+
+    // per slot: number of assignments (2 for more), offset of the assignment, number
+    info = smemblk_zalloc(ctx->symbol_names, (smemblk_size_t) (3 * (ctx->slot_count + 1) * sizeof(int)));
+    if (info == NULL)
+        return;
+
+    for (o=0; o<ctx->code_len; o+=code_op_len(ctx->code + o)) {
+        op = ctx->code[o];
+        if (op == OP_LET || op == OP_LETARR1 || op == OP_APPEND || op == OP_ASSIGN || op == OP_READ || op == OP_DIM || op == OP_NEXT) {
+            s = 3 * ctx->code[o+1];
+            if (info[s] < 2)
+                ++info[s];
+            info[s+1] = 0;
+        }
+    }
+
+    for (o=0; o<ctx->code_len && prefix; prev=o, o+=code_op_len(ctx->code + o)) {
+        switch (op = ctx->code[o]) {
+            case OP_IFFALSE: case OP_IFVAR: case OP_GOTO: case OP_GOSUB: case OP_GOTOINSN: case OP_GOSUBINSN:
+            case OP_ONTARGET: case OP_ONTABLE: case OP_RETURN: case OP_STOP: case OP_FOR: case OP_NEXT:
+            case OP_CALLDEF:
+                prefix = 0;
+                break;
+
+            case OP_LET:
+                s = 3 * ctx->code[o+1];
+                if (info[s] == 1 && ctx->code[o+2] == 0 && prev == o - 3 && ctx->code[prev] == OP_PUSHNUM) {
+                    info[s+1] = o;
+                    info[s+2] = code_get32(&ctx->code[prev+1]);
+                }
+                break;
+        }
+    }
+
+    // the generic code of superinstructions keeps its layout
+    for (o=0; o<ctx->code_len; ) {
+        op = ctx->code[o];
+        if (op == OP_LOADVAR) {
+            s = 3 * ctx->code[o+1];
+            if (info[s+1] > 0 && o > info[s+1]) {
+                edit_add(ctx, e, o, 2);
+                edit_word(ctx, e, OP_PUSHNUM);
+                edit_word32(ctx, e, info[s+2]);
+            }
+        }
+        o += op == OP_ADDVAR ? 4 + 9 : (op == OP_IFVAR ? 5 + 6 : code_op_len(ctx->code + o));
+    }
+    smemblk_free(ctx->symbol_names, info);
+}
+
+static void ICACHE_FLASH_ATTR optimize_fold(struct urubasic_ctx *ctx, struct Code_edits *e, struct Expr *stack)
+{
+    // operators on numbers are evaluated, which the compiler could not do
+    // before the variables were replaced by numbers
+    int o, op, n, i, depth = 0;
+    struct Expr *a;
+
+    for (o=0; o<ctx->code_len; ) {
+        op = ctx->code[o];
+        a = &stack[depth-1];
+        if (op == OP_PUSHNUM) {
+            a = &stack[depth++];
+            a->kind  = EXPR_CONST;
+            a->value = code_get32(&ctx->code[o+1]);
+            a->start = o;
+            a->end   = o + 3;
+            a->ops   = 0;
+        }
+        else if ((op == OP_NEG || op == OP_NOT) && a->kind == EXPR_CONST && code_eval(op, a->value, 0, &a->value)) {
+            a->end = o + 1;
+            ++a->ops;
+        }
+        else if (op >= OP_ADD && op <= OP_OR && a[-1].kind == EXPR_CONST && a->kind == EXPR_CONST && code_eval(op, a[-1].value, a->value, &a[-1].value)) {
+            a[-1].ops += a->ops + 1;
+            a[-1].end  = o + 1;
+            --depth;
+        }
+        else if (op == OP_ADDVAR) {
+            o += 4 + 9;
+            continue;
+        }
+        else {
+            // the values which the operation takes are done
+            i = code_op_stack(ctx->code + o, &n);
+            if (op == OP_IFVAR)
+                i = 1;
+            for (depth-=n; n>0; --n) {
+                a = &stack[depth+n-1];
+                if (a->kind == EXPR_CONST && a->ops > 0) {
+                    edit_add(ctx, e, a->start, a->end - a->start);
+                    edit_word(ctx, e, OP_PUSHNUM);
+                    edit_word32(ctx, e, a->value);
+                }
+            }
+            for (; i>0; --i)
+                stack[depth++].kind = EXPR_OTHER;
+            if (op == OP_IFVAR) {
+                o += 5 + 6;
+                continue;
+            }
+        }
+        o += code_op_len(ctx->code + o);
+        if (depth < 0 || depth > ctx->code_max_depth) {
+            e->failed = 1;
+            return;
+        }
+    }
+}
+
+static int ICACHE_FLASH_ATTR loop_next(struct urubasic_ctx *ctx, int f)
+{
+    // code offset of the NEXT which belongs to the FOR at f, -1 if there is none
+    int exit = ctx->code[f+2], o;
+
+    if (exit < 1 || exit > ctx->insn_count)
+        return -1;
+    o = ctx->insn_info[exit-1].code;
+    if (o <= f || o >= ctx->code_len || ctx->code[o] != OP_NEXT || ctx->code[o+1] != ctx->code[f+1])
+        return -1;
+    return o;
+}
+
+static int ICACHE_FLASH_ATTR loop_closed(struct urubasic_ctx *ctx, int f, int next, uint8_t *assigned, int slots)
+{
+    // whether the body of the loop is entered by the FOR only and is left by
+    // NEXT or a jump, collects the variables the body assigns
+    int o, op, i, n, inside;
+
+    memset(assigned, 0, slots);
+    for (o=0; o<ctx->code_len; o+=code_op_len(ctx->code + o)) {
+        inside = o >= f + 4 && o < next;
+        switch (op = ctx->code[o]) {
+            case OP_LET: case OP_LETNUM: case OP_LETARR1: case OP_ASSIGN: case OP_READ: case OP_DIM: case OP_NEXT:
+            case OP_ADDVAR: case OP_APPEND:
+                if (inside)
+                    assigned[ctx->code[o+1]] = 1;
+                break;
+
+            case OP_RETURN: case OP_JUMP:
+                if (inside)
+                    return 0;
+                break;
+
+            case OP_GOTOINSN: case OP_GOSUBINSN: case OP_IFFALSE: case OP_ONTABLE:
+                if (inside && (op == OP_GOSUBINSN || op == OP_ONTABLE))
+                    return 0;
+                n = op == OP_ONTABLE ? ctx->code[o+1] : 1;
+                for (i=0; i<n; ++i) {
+                    int target = insn_code(ctx, ctx->code[op == OP_ONTABLE ? o+4+i : o+1]);
+                    if ((target >= f + 4 && target <= next) != inside)
+                        return 0;
+                }
+                break;
+        }
+    }
+    return 1;
+}
+
+static void ICACHE_FLASH_ATTR loop_record(struct Expr *a, struct Expr *found, int *nfound, int induction)
+{
+    // an expression worth to be moved in front of the loop
+    if (*nfound < LOOP_EXPRS && a->ops > 0
+        && (a->kind == EXPR_INVARIANT || (a->kind == EXPR_INDUCTION && induction)))
+        found[(*nfound)++] = *a;
+}
+
+static int ICACHE_FLASH_ATTR loop_scan(struct urubasic_ctx *ctx, int f, int next, uint8_t *assigned, struct Expr *stack, struct Expr *found, int induction)
+{
+    // finds the invariant and induction expressions of the loop body, the
+    // bodies of inner loops are left to their own scan
+    int o, op, n, i, depth = 0, nfound = 0, var = ctx->code[f+1];
+    struct Expr *a, *b;
+
+    for (o=f+4; o<next; ) {
+        op = ctx->code[o];
+        a = &stack[depth-2];
+        b = &stack[depth-1];
+        if (op == OP_PUSHNUM || op == OP_LOADNUM) {
+            a = &stack[depth++];
+            a->start = o;
+            a->end   = o + code_op_len(ctx->code + o);
+            a->ops   = 0;
+            a->kind  = op == OP_PUSHNUM ? EXPR_CONST : (assigned[ctx->code[o+1]] ? EXPR_OTHER : EXPR_INVARIANT);
+            a->value = op == OP_PUSHNUM ? code_get32(&ctx->code[o+1]) : 0;
+            if (op == OP_LOADNUM && ctx->code[o+1] == var && !assigned[var]) {
+                a->kind = EXPR_INDUCTION;
+                a->k = 1;
+                a->d = 0;
+            }
+        }
+        else if (op == OP_NEGN && b->kind != EXPR_OTHER) {
+            if (b->kind == EXPR_CONST)
+                b->kind = EXPR_INVARIANT;
+            b->k = 0 - (unsigned) b->k;
+            b->d = 0 - (unsigned) b->d;
+            b->end = o + 1;
+            ++b->ops;
+        }
+        else if (op >= OP_ADDN && op <= OP_ORN && op != OP_DIVN
+                 && (a->kind == EXPR_CONST || a->kind == EXPR_INVARIANT) && (b->kind == EXPR_CONST || b->kind == EXPR_INVARIANT)) {
+            a->kind = EXPR_INVARIANT;
+            a->ops += b->ops + 1;
+            a->end  = o + 1;
+            --depth;
+        }
+        else if ((op == OP_ADDN || op == OP_SUBN || op == OP_MULN)
+                 && ((a->kind == EXPR_INDUCTION && b->kind == EXPR_CONST) || (a->kind == EXPR_CONST && b->kind == EXPR_INDUCTION))) {
+            n = a->kind == EXPR_CONST ? a->value : b->value;
+            if (a->kind == EXPR_CONST) {
+                a->k = b->k;
+                a->d = b->d;
+            }
+            if (op == OP_MULN) {
+                a->k = (unsigned) a->k * n;
+                a->d = (unsigned) a->d * n;
             }
-            else if (data_buffer[data_buffer_index] == 1) {
-                *value_ptr = data_buffer[data_buffer_index+1];
-                data_buffer_index += 2;
+            else if (op == OP_ADDN || b->kind == EXPR_INDUCTION) {
+                // c - induction is negated first
+                if (op == OP_SUBN) {
+                    a->k = 0 - (unsigned) a->k;
+                    a->d = 0 - (unsigned) a->d;
+                }
+                a->d = (unsigned) a->d + n;
             }
-            else if (data_buffer[data_buffer_index] == 2) {
-                *value_ptr = data_buffer[data_buffer_index+1];
-                *value_ptr <<= 8;
-                *value_ptr += data_buffer[data_buffer_index+2];
-                data_buffer_index += 3;
+            else
+                a->d = (unsigned) a->d - n;
+            a->kind = EXPR_INDUCTION;
+            a->ops += b->ops + 1;
+            a->end  = o + 1;
+            --depth;
+        }
+        else if (op == OP_ADDVAR) {
+            o += 4 + 9;
+            continue;
+        }
+        else {
+            // the values which the operation takes are done
+            i = code_op_stack(ctx->code + o, &n);
+            if (op == OP_IFVAR)
+                i = 1;
+            for (depth-=n; n>0; --n)
+                loop_record(&stack[depth+n-1], found, &nfound, induction);
+            for (; i>0; --i)
+                stack[depth++].kind = EXPR_OTHER;
+            if (op == OP_IFVAR) {
+                o += 5 + 6;
+                continue;
             }
-            else if (data_buffer[data_buffer_index] == 4) {
-                *value_ptr = data_buffer[data_buffer_index+1];
-                *value_ptr <<= 8;
-                *value_ptr += data_buffer[data_buffer_index+2];
-                *value_ptr <<= 8;
-                *value_ptr += data_buffer[data_buffer_index+3];
-                *value_ptr <<= 8;
-                *value_ptr += data_buffer[data_buffer_index+4];
-                data_buffer_index += 5;
+            if (op == OP_FOR) {
+                o = loop_next(ctx, o);
+                if (o < 0)
+                    return 0;
             }
         }
-        tok = lex_next_token(&symidx);
-    } while (COMMA == check_token(tok, symidx, COMMA, 0));
-    return insn+1;
+        o += code_op_len(ctx->code + o);
+        if (depth < 0 || depth > ctx->code_max_depth)
+            return 0;
+    }
+    return nfound;
+}
+
+static void ICACHE_FLASH_ATTR optimize_loops(struct urubasic_ctx *ctx, struct Code_edits *e, struct Expr *stack)
+{
+    // loop invariant expressions are computed once in front of the FOR and
+    // expressions k * I + d of the loop variable are updated by NEXT
+    struct Expr found[LOOP_EXPRS];
+    uint8_t *assigned;
+    int o, f, next, prev = -1, n, i, v, step, induction, slot[LOOP_EXPRS], slots = ctx->slot_count + 1;
+    char name[16];
+    SYMIDX symidx;
+
+    // the loops are known only if all jumps are resolved
+    for (o=0; o<ctx->code_len; o+=code_op_len(ctx->code + o))
+        if (ctx->code[o] == OP_GOTO || ctx->code[o] == OP_GOSUB || ctx->code[o] == OP_ONTARGET)
+            return;
+    // the temporaries get slots behind the ones of the code
+    assigned = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) slots);
+    if (assigned == NULL)
+        return;
+
+    for (f=0; f<ctx->code_len; prev=f, f+=code_op_len(ctx->code + f)) {
+        if (ctx->code[f] != OP_FOR || (next = loop_next(ctx, f)) < 0 || !loop_closed(ctx, f, next, assigned, slots))
+            continue;
+        // the step is the value in front of FOR
+        induction = prev == f - 3 && ctx->code[prev] == OP_PUSHNUM;
+        step = induction ? code_get32(&ctx->code[prev+1]) : 0;
+        n = loop_scan(ctx, f, next, assigned, stack, found, induction);
+
+        for (i=0; i<n; ++i) {
+            sprintf(name, "~%d", ctx->slot_count + 1);
+            symidx = parse_lookup_symbol(ctx, name, 1);
+            slot[i] = symidx != NULL ? code_slot(ctx, symidx) : 0;
+            if (slot[i] == 0)
+                break;
+            edit_add(ctx, e, found[i].start, found[i].end - found[i].start);
+            edit_word(ctx, e, OP_LOADNUM);
+            edit_word(ctx, e, slot[i]);
+        }
+        if ((n = i) == 0)
+            continue;
+        edit_add(ctx, e, f, 0);
+        for (i=0; i<n; ++i) {
+            for (o=found[i].start; o<found[i].end; ++o)
+                edit_word(ctx, e, ctx->code[o]);
+            edit_word(ctx, e, OP_LETNUM);
+            edit_word(ctx, e, slot[i]);
+            edit_word(ctx, e, 0);
+        }
+        edit_add(ctx, e, next, 0);
+        for (i=0; i<n; ++i) {
+            if (found[i].kind != EXPR_INDUCTION)
+                continue;
+            v = (unsigned) found[i].k * step;
+            edit_word(ctx, e, OP_ADDVAR);
+            edit_word(ctx, e, slot[i]);
+            edit_word32(ctx, e, v);
+            edit_word(ctx, e, OP_LOADVAR);
+            edit_word(ctx, e, slot[i]);
+            edit_word(ctx, e, OP_PUSHNUM);
+            edit_word32(ctx, e, v);
+            edit_word(ctx, e, OP_ADD);
+            edit_word(ctx, e, OP_LET);
+            edit_word(ctx, e, slot[i]);
+            edit_word(ctx, e, 0);
+        }
+        ctx->code_max_depth += 2;
+    }
+    smemblk_free(ctx->symbol_names, assigned);
+}
+
+static void ICACHE_FLASH_ATTR optimize_program(struct urubasic_ctx *ctx)
+{
+    // the optimizations over the whole program, each pass rebuilds the code
+    struct Code_edits e;
+    struct Expr *stack;
+    int pass;
+
+    stack = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) ((ctx->code_max_depth + 8) * sizeof(struct Expr)));
+    if (stack == NULL)
+        return;
+    memset(&e, 0, sizeof(e));
+    memset(stack, 0, 2 * sizeof(struct Expr));     // EXPR_OTHER below the bottom
+    for (pass=0; pass<3; ++pass) {
+        if (pass == 0)
+            optimize_propagate(ctx, &e);
+        else if (pass == 1)
+            optimize_fold(ctx, &e, stack + 2);
+        else {
+            infer_types(ctx);
+            optimize_loops(ctx, &e, stack + 2);
+        }
+        edit_apply(ctx, &e);
+        edit_free(ctx, &e);
+    }
+    smemblk_free(ctx->symbol_names, stack);
+}
+
+static void ICACHE_FLASH_ATTR compile_program(struct urubasic_ctx *ctx)
+{
+    int insn, tok, errors, live;
+    SYMIDX symidx;
+
+    ctx->for_chain = -1;
+
+    // DEF functions may be used in front of their definition
+    for (insn=0; insn<ctx->insn_count; ++insn) {
+        if ((unsigned char) ctx->insn_info[insn].line[0] != DEF)
+            continue;
+        lex_setup(ctx, insn);
+        tok = lex_next_token(ctx, &symidx);
+        if (!is_keyword(symidx) || get_symbol(symidx)->tok != DEF)
+            continue;
+
+        tok = lex_next_token(ctx, &symidx);
+        if (tok != IDENTIFIER)
+            continue;
+        if (symidx == 0)
+            symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+        if (symidx != NULL) {
+            get_symbol(symidx)->tok = FUNCTION;
+            get_symbol(symidx)->func = 0;
+            get_symbol(symidx)->array_base_size = -1;   // not compiled yet
+            get_symbol(symidx)->value_type = 0;
+        }
+    }
+
+    ctx->code_falls  = 1;
+    ctx->code_target = -1;
+    for (insn=0; insn<ctx->insn_count && !ctx->compile_failed; ++insn) {
+        lex_setup(ctx, insn);
+        errors = ctx->error_count;
+        ctx->code_depth = 0;
+        ctx->code_op[0] = ctx->code_op[1] = -1;
+        ctx->insn_info[insn].code = ctx->code_len;
+        live = code_live(ctx, insn);
+        compile_stmt(ctx, insn);
+        if (errors != ctx->error_count) {
+            // a broken instruction is left out, the program continues after it
+            ctx->code_len = ctx->insn_info[insn].code;
+            while (ctx->for_chain >= ctx->code_len)
+                ctx->for_chain = ctx->code[ctx->for_chain];
+            continue;
+        }
+        else if (!live) {
+            // unreachable, it was compiled for the errors only
+            ctx->code_len = ctx->insn_info[insn].code;
+            continue;
+        }
+        if (ctx->code_op[1] >= ctx->insn_info[insn].code)
+            ctx->code_falls = !code_ends(ctx->code[ctx->code_op[1]]);
+    }
+    ctx->lex_tokens = NULL;
+    code_emit(ctx, OP_STOP);
+    compile_loop_exit(ctx, NULL, ctx->insn_count);    // loops without NEXT end the program
+
+    if (!ctx->compile_failed && ctx->optimize > 1)
+        optimize_program(ctx);
+    else if (!ctx->compile_failed && ctx->optimize > 0)
+        infer_types(ctx);
+
+    // the stack has room for the deepest expression and nested DEF functions
+    if (!ctx->compile_failed && (VM_STACK_SIZE + ctx->code_max_depth) * sizeof(struct urubasic_type) < SMEMBLK_MAX_SIZE) {
+        ctx->vm_stack_size = VM_STACK_SIZE + ctx->code_max_depth;
+        ctx->vm_stack = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (ctx->vm_stack_size * sizeof(struct urubasic_type)));
+    }
+    if (ctx->vm_stack == NULL && !ctx->compile_failed) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        ctx->compile_failed = 1;
+    }
+
+    // variables share one frame, they are created in it on first use
+    if (!ctx->compile_failed)
+        ctx->vm_vars = smemblk_zalloc(ctx->symbol_names, (smemblk_size_t) ((ctx->slot_count + 1) * sizeof(int)));
+    if (ctx->vm_vars != NULL)
+        ctx->vm_var_count = ctx->slot_count + 1;
+
+    if (ctx->compile_failed) {
+        smemblk_free(ctx->symbol_names, ctx->code);
+        ctx->code = NULL;
+        ctx->code_len = ctx->code_max = 0;
+    }
+    else {
+        ctx->code = smemblk_realloc(ctx->symbol_names, ctx->code, (smemblk_size_t) ((ctx->code_max = ctx->code_len) * sizeof(code_t)));
+        if (ctx->const_pool != NULL)
+            ctx->const_pool = smemblk_realloc(ctx->symbol_names, ctx->const_pool, ctx->const_max = ctx->const_len);
+    }
+}
+
+#ifndef __ETS__
+static unsigned int ICACHE_FLASH_ATTR code_hash(struct urubasic_ctx *ctx)
+{
+    // FNV-1a of the compiled code, a translated program checks it before it runs
+    unsigned int h = 2166136261u ^ (unsigned int) ctx->code_len;
+    int i;
+
+    for (i=0; i<ctx->code_len; ++i)
+        h = (h ^ (uint16_t) ctx->code[i]) * 16777619u;
+    return h;
+}
+
+static void ICACHE_FLASH_ATTR emit_c(struct urubasic_ctx *ctx, const char *fmt, ...)
+{
+    char temp[256];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(temp, sizeof(temp), fmt, ap);
+    va_end(ap);
+    output_text(ctx, temp, len < (int) sizeof(temp) ? len : (int) sizeof(temp) - 1);
+}
+
+static void ICACHE_FLASH_ATTR emit_c_number(struct urubasic_ctx *ctx, const char *fmt, int value)
+{
+    // fmt has one %s for the number, INT_MIN is no valid literal
+    char temp[16];
+
+    if (value == INT_MIN)
+        strcpy(temp, "INT_MIN");
+    else
+        sprintf(temp, "%d", value);
+    emit_c(ctx, fmt, temp);
+}
+
+struct Emit_c_text {
+    int     (*write)(void *arg, const char *buf, int len);
+    void    *arg;
+};
+
+static int ICACHE_FLASH_ATTR emit_c_text(void *arg, const char *buf, int len)
+{
+    // output sink which writes the listing as lines of a C string literal
+    struct Emit_c_text *out = arg;
+    char temp[256];
+    int i, n = 0, open = 0;
+
+    for (i=0; i<len; ++i) {
+        unsigned char c = (unsigned char) buf[i];
+
+        if (n > (int) sizeof(temp) - 16) {
+            out->write(out->arg, temp, n);
+            n = 0;
+        }
+        if (!open)
+            n += sprintf(temp + n, "    \"");
+        open = 1;
+        if (c == '\n') {
+            n += sprintf(temp + n, "\\n\"\n");
+            open = 0;
+        }
+        else if (c == '"' || c == '\\')
+            n += sprintf(temp + n, "\\%c", c);
+        else if (c < ' ' || c >= 127)
+            n += sprintf(temp + n, "\\%03o", c);
+        else
+            temp[n++] = (char) c;
+    }
+    if (open)
+        n += sprintf(temp + n, "\"\n");
+    out->write(out->arg, temp, n);
+    return len;
+}
+
+static void ICACHE_FLASH_ATTR emit_c_source(struct urubasic_ctx *ctx, int insn)
+{
+    // the instruction as a comment, a trailing backslash would continue it
+    char source[MAX_LINE_LEN];
+    int len;
+
+    list_insn(ctx, insn, source, sizeof(source));
+    for (len = strlen(source); len > 0 && source[len-1] == '\\'; )
+        source[--len] = '\0';
+    if (ctx->insn_info[insn].label)
+        emit_c(ctx, "    // %d %s\n", ctx->insn_info[insn].label, source);
+    else
+        emit_c(ctx, "    // %s\n", source);
+}
+
+static void ICACHE_FLASH_ATTR emit_c_jump(struct urubasic_ctx *ctx, int push_offset, int target)
+{
+    // GOSUB pushes its return address before the jump
+    if (push_offset >= 0)
+        emit_c(ctx, "    if (!vm_push_frame(ctx, NULL, %d, -1, 0)) { ctx->vm_pc = code + %d; return NULL; }\n", push_offset, push_offset - 1);
+    emit_c(ctx, "    goto L%d;\n", target);
 }
 
-static int ICACHE_FLASH_ATTR stmt_restore(int insn, struct urubasic_type *arg, void *user)
-{
-    data_buffer_index = 0;
-    return insn+1;
-}
+static void ICACHE_FLASH_ATTR emit_c_op(struct urubasic_ctx *ctx, int o, int for_body)
+{
+    // C code of the instruction at offset o, it does what vm_run() does
+    static const char *const operators[] = {
+        "sp[-1].value += sp->value", "PLUS", "sp[-1].value -= sp->value", "MINUS",
+        "sp[-1].value *= sp->value", "MULT", "sp[-1].value /= sp->value", "SOLIDUS",
+        "sp[-1].value = power(sp[-1].value, sp->value)", "CIRCUMFLEX",
+        "sp[-1].value = sp[-1].value < sp->value ? -1 : 0", "LT", "sp[-1].value = sp[-1].value <= sp->value ? -1 : 0", "LE",
+        "sp[-1].value = sp[-1].value > sp->value ? -1 : 0", "GT", "sp[-1].value = sp[-1].value >= sp->value ? -1 : 0", "GE",
+        "sp[-1].value = sp[-1].value == sp->value ? -1 : 0", "EQ", "sp[-1].value = sp[-1].value != sp->value ? -1 : 0", "NEQ",
+        "sp[-1].value &= sp->value", "AND", "sp[-1].value |= sp->value", "OR",
+    };
+    static const char *const relops[] = { "<", "<=", ">", ">=", "==", "!=" };
+    code_t *p = ctx->code + o;
+    int a = o + 1, i, n;    // a is pc of the VM behind the opcode
+    const char *s;
+
+    emit_c(ctx, "L%d:\n", o);
+    switch (p[0]) {
+        case OP_STOP:
+            emit_c(ctx, "    return NULL;\n");
+            break;
+
+        case OP_JUMP:
+            emit_c(ctx, "    goto L%d;\n", code_get32(p + 1));
+            break;
+
+        case OP_PUSHNUM:
+            emit_c_number(ctx, "    sp->type = NUMBER; sp->value = %s; ++sp;\n", code_get32(p + 1));
+            break;
+
+        case OP_PUSHSTR:
+            emit_c(ctx, "    sp->type = STRING; sp->value = ~%d; ++sp;\n", p[1]);
+            break;
+
+        case OP_PUSHNIL:
+            emit_c(ctx, "    sp->type = 0; sp->value = 0; ++sp;\n");
+            break;
+
+        case OP_LOADVAR:
+            emit_c(ctx, "    sym = ctx->slot_table[%d];\n", p[1]);
+            emit_c(ctx, "    if ((sym->value_type & 0xff) == STRING) { sp->type = STRING; sp->value = *sym->value_ptr; }\n");
+            emit_c(ctx, "    else {\n        value_ptr = sym->value_ptr;\n");
+            emit_c(ctx, "        if (value_ptr == NULL) { ctx->vm_pc = code + %d; value_ptr = vm_element(ctx, sym, 0, sp); }\n", a + 1);
+            emit_c(ctx, "        sp->type = NUMBER; sp->value = value_ptr != NULL ? *value_ptr : 0;\n    }\n    ++sp;\n");
+            break;
+
+        case OP_LOADPARAM:
+            emit_c(ctx, "    arg = &ctx->vm_fp[%d];\n", p[1]);
+            emit_c(ctx, "    *sp = *arg;\n    if (arg->type != NUMBER) { string_retain(ctx, arg->value); sp->type = STRING|ALLOC; }\n    ++sp;\n");
+            break;
+
+        case OP_LOADARR1:
+        case OP_LOADARR2:
+            n = p[0] == OP_LOADARR1 ? 1 : 2;
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; sp -= %d;\n", p[1], n);
+            emit_c(ctx, "    if ((sym->value_type & 0xff) == STRING) { vm_release(ctx, sp, %d); sp->type = STRING; sp->value = *sym->value_ptr; }\n", n);
+            emit_c(ctx, "    else {\n");
+            if (n == 1)
+                emit_c(ctx, "        if (sym->value_ptr != NULL) value_ptr = sym->value_ptr + (sp[0].value - ctx->option_base);\n");
+            else
+                emit_c(ctx, "        if (sym->value_ptr != NULL) value_ptr = sym->value_ptr + sym->array_base_size * (sp[1].value - ctx->option_base) + (sp[0].value - ctx->option_base);\n");
+            emit_c(ctx, "        else { ctx->vm_pc = code + %d; value_ptr = vm_element(ctx, sym, %d, sp); }\n", a + 1, n);
+            emit_c(ctx, "        sp->type = NUMBER; sp->value = value_ptr != NULL ? *value_ptr : 0;\n    }\n    ++sp;\n");
+            break;
+
+        case OP_LET:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; sp -= %d;\n", p[1], p[2] + 1);
+            if (p[2] == 0)
+                emit_c(ctx, "    if (sp->type == NUMBER && sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER) *sym->value_ptr = sp->value;\n    else ");
+            else
+                emit_c(ctx, "    ");
+            emit_c(ctx, "{ ctx->vm_pc = code + %d; vm_let(ctx, sym, %d, sp); }\n", a, p[2]);
+            break;
+
+        case OP_LETARR1:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; sp -= 2;\n", p[1]);
+            emit_c(ctx, "    if (sp[1].type == NUMBER && sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER) sym->value_ptr[sp[0].value - ctx->option_base] = sp[1].value;\n");
+            emit_c(ctx, "    else { ctx->vm_pc = code + %d; vm_let(ctx, sym, 1, sp); }\n", a);
+            break;
+
+        case OP_APPEND:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; sp -= 2;\n", p[1]);
+            emit_c(ctx, "    if (vm_numbers(sp + 1) && sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER) *sym->value_ptr = sp[0].value + sp[1].value;\n");
+            emit_c(ctx, "    else { ctx->vm_pc = code + %d; vm_append(ctx, sym, sp); }\n", a);
+            break;
+
+        case OP_ASSIGN:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; --sp; ctx->vm_pc = code + %d;\n", p[1], a + 1);
+            emit_c(ctx, "    value_ptr = vm_number(ctx, sym, 0, sp);\n    if (value_ptr != NULL) *value_ptr = sp->value;\n    vm_release(ctx, sp, 1);\n");
+            break;
+
+        case OP_NEG:
+        case OP_NOT:
+            emit_c(ctx, "    if (sp[-1].type == NUMBER) sp[-1].value = %csp[-1].value; else vm_error(ctx, code + %d, E_SYNTAX_ERROR);\n", p[0] == OP_NEG ? '-' : '~', a);
+            break;
+
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_POW: case OP_LT: case OP_LE:
+        case OP_GT: case OP_GE: case OP_EQ: case OP_NEQ: case OP_AND: case OP_OR:
+            i = 2 * (p[0] - OP_ADD);
+            emit_c(ctx, "    --sp; if (vm_numbers(sp)) %s; else { ctx->vm_pc = code + %d; vm_operator(ctx, %s, sp-1, sp); }\n", operators[i], a, operators[i+1]);
+            break;
+
+        case OP_LOADNUM:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; value_ptr = sym->value_ptr;\n", p[1]);
+            emit_c(ctx, "    if (value_ptr == NULL) { ctx->vm_pc = code + %d; value_ptr = vm_element(ctx, sym, 0, sp); }\n", a + 1);
+            emit_c(ctx, "    sp->type = NUMBER; sp->value = value_ptr != NULL ? *value_ptr : 0; ++sp;\n");
+            break;
+
+        case OP_LETNUM:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; --sp;\n", p[1]);
+            emit_c(ctx, "    if (sym->value_ptr != NULL) *sym->value_ptr = sp->value; else { ctx->vm_pc = code + %d; vm_let(ctx, sym, 0, sp); }\n", a);
+            break;
+
+        case OP_NEGN:
+        case OP_NOTN:
+            emit_c(ctx, "    sp[-1].value = %csp[-1].value;\n", p[0] == OP_NEGN ? '-' : '~');
+            break;
+
+        case OP_ADDN: case OP_SUBN: case OP_MULN: case OP_DIVN: case OP_POWN: case OP_LTN: case OP_LEN:
+        case OP_GTN: case OP_GEN: case OP_EQN: case OP_NEQN: case OP_ANDN: case OP_ORN:
+            emit_c(ctx, "    --sp; %s;\n", operators[2 * (p[0] - OP_ADDN)]);
+            break;
+
+        case OP_CALL:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; arg = sp - %d; ctx->vm_pc = code + %d;\n", p[1], p[2] + 1, a + 2);
+            emit_c(ctx, "    call_function(ctx, sym, %d, arg);\n    vm_release(ctx, arg + 1, %d);\n    sp = arg + 1;\n", p[2] + 1, p[2]);
+            break;
+
+        case OP_CALLDEF:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; n = %d; arg = sp - n; result.type = NUMBER; result.value = 0;\n", p[1], p[2]);
+            emit_c(ctx, "    if (sym->array_base_size < 0) vm_error(ctx, code + %d, E_MISSING_DEF);\n", a + 2);
+            emit_c(ctx, "    else if (sp + sym->value_type + ctx->code_max_depth > ctx->vm_stack + ctx->vm_stack_size) vm_error(ctx, code + %d, E_OUT_OF_MEMORY);\n", a + 2);
+            emit_c(ctx, "    else {\n        struct urubasic_type *fp = ctx->vm_fp;\n");
+            emit_c(ctx, "        for ( ; n < sym->value_type; ++n, ++sp) { sp->type = NUMBER; sp->value = 0; }\n");
+            emit_c(ctx, "        ctx->vm_fp = arg;\n        result = aot_run(ctx, code + sym->array_base_size, sp)[-1];\n        ctx->vm_fp = fp;\n    }\n");
+            emit_c(ctx, "    vm_release(ctx, arg, n); *arg = result; sp = arg + 1;\n");
+            break;
+
+        case OP_RETDEF:
+            emit_c(ctx, "    return sp;\n");
+            break;
+
+        case OP_POP:
+            emit_c(ctx, "    --sp; vm_release(ctx, sp, 1);\n");
+            break;
+
+        case OP_IFFALSE:
+            emit_c(ctx, "    --sp; v = sp->value; vm_release(ctx, sp, 1);\n    if (v == 0) goto L%d;\n", insn_code(ctx, p[1]));
+            break;
 
-static int ICACHE_FLASH_ATTR stmt_def(int insn, struct urubasic_type *arg, void *user)
-{
-    int tok;
-    SYMIDX symidx;
+        case OP_GOTO:
+        case OP_GOSUB:
+            emit_c(ctx, "    --sp; vm_release(ctx, sp, 1);\n");
+            if (p[0] == OP_GOSUB)
+                emit_c(ctx, "    if (!vm_push_frame(ctx, NULL, %d, -1, 0)) { ctx->vm_pc = code + %d; return NULL; }\n", a, a);
+            emit_c(ctx, "    pc = code + insn_code(ctx, find_insn(ctx, sp->value));\n    goto dispatch;\n");
+            break;
 
-    tok = lex_next_token(&symidx);
-    check_token(tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER);
-    if (symidx == 0)
-        symidx = parse_lookup_symbol(token_text, 1);
-    get_symbol(symidx)->tok = FUNCTION;
-    get_symbol(symidx)->func = NULL;
-    if (get_symbol(symidx)->value_ptr == NULL)
-        get_symbol(symidx)->value_ptr = smemblk_alloc(symbol_names, sizeof(int));
-    *get_symbol(symidx)->value_ptr = insn;
+        case OP_GOTOINSN:
+            emit_c_jump(ctx, -1, insn_code(ctx, p[1]));
+            break;
+
+        case OP_GOSUBINSN:
+            emit_c_jump(ctx, a + 1, insn_code(ctx, p[1]));
+            break;
+
+        case OP_RETURN:
+            emit_c(ctx, "    do {\n        if (ctx->frame_count == 0) return NULL;\n        frame = &ctx->frame_stack[--ctx->frame_count];\n    } while (frame->var != NULL);\n");
+            emit_c(ctx, "    pc = code + frame->offset;\n    goto dispatch;\n");
+            break;
+
+        case OP_ONTARGET:
+            emit_c(ctx, "    --sp;\n    if (sp[-1].value != %d) vm_release(ctx, sp, 1);\n", p[1]);
+            emit_c(ctx, "    else {\n        v = sp->value; vm_release(ctx, sp, 1); --sp;\n");
+            if (p[2])
+                emit_c(ctx, "        if (!vm_push_frame(ctx, NULL, %d, -1, 0)) { ctx->vm_pc = code + %d; return NULL; }\n", insn_code(ctx, p[3] + 1), a);
+            emit_c(ctx, "        pc = code + insn_code(ctx, find_insn(ctx, v));\n        goto dispatch;\n    }\n");
+            break;
+
+        case OP_ONTABLE:
+            emit_c(ctx, "    --sp; v = sp->value; vm_release(ctx, sp, 1);\n    if (v >= 1 && v <= %d) {\n", p[1]);
+            if (p[2])
+                emit_c(ctx, "        if (!vm_push_frame(ctx, NULL, %d, -1, 0)) { ctx->vm_pc = code + %d; return NULL; }\n", insn_code(ctx, p[3] + 1), a);
+            emit_c(ctx, "        switch (v) {\n");
+            for (i=1; i<=p[1]; ++i)
+                emit_c(ctx, "        case %d: goto L%d;\n", i, insn_code(ctx, p[3+i]));
+            emit_c(ctx, "        }\n    }\n");
+            break;
+
+        case OP_FOR:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; sp -= 2; end = sp[0].value; step = sp[1].value;\n", p[1]);
+            emit_c(ctx, "    n = code[%d];\n    if (n > 0 && n <= ctx->frame_count && ctx->frame_stack[n-1].offset == %d) ctx->frame_count = n - 1;\n", a + 2, a + 3);
+            emit_c(ctx, "    ctx->vm_pc = code + %d;\n    value_ptr = vm_number(ctx, sym, 0, sp);\n", a);
+            emit_c(ctx, "    if (value_ptr != NULL && ((step > 0 && *value_ptr > end) || (step < 0 && *value_ptr < end))) { *value_ptr += step; goto L%d; }\n", insn_code(ctx, p[2]));
+            emit_c(ctx, "    if (!vm_push_frame(ctx, sym, %d, end, step)) return NULL;\n    code[%d] = ctx->frame_count;\n", a + 3, a + 2);
+            break;
+
+        case OP_NEXT:
+            emit_c(ctx, "    sym = ctx->slot_table[%d];\n    if (ctx->frame_count > 0) {\n", p[1]);
+            emit_c(ctx, "        frame = &ctx->frame_stack[ctx->frame_count-1];\n        value_ptr = sym->value_ptr;\n");
+            emit_c(ctx, "        if (value_ptr == NULL || (sym->value_type & 0xff) != NUMBER) { ctx->vm_pc = code + %d; value_ptr = vm_number(ctx, sym, 0, sp); }\n", a);
+            emit_c(ctx, "        if (value_ptr != NULL) {\n            v = *value_ptr += frame->step;\n");
+            emit_c(ctx, "            if ((frame->step > 0 && v > frame->end) || (frame->step < 0 && v < frame->end)) --ctx->frame_count;\n");
+            if (for_body >= 0)
+                emit_c(ctx, "            else if (frame->offset == %d) goto L%d;\n", for_body, for_body);
+            emit_c(ctx, "            else { pc = code + frame->offset; goto dispatch; }\n        }\n    }\n");
+            emit_c(ctx, "    else vm_error(ctx, code + %d, E_NEXT_WITHOUT_FOR);\n", a);
+            break;
+
+        case OP_PRINTVAL:
+            emit_c(ctx, "    vm_print(ctx, --sp);\n");
+            break;
+
+        case OP_PRINTSTR:
+            emit_c(ctx, "    print_text(ctx, ctx->const_pool + %d, %d);\n", p[1], ((struct String *) (ctx->const_pool + p[1]) - 1)->len);
+            break;
+
+        case OP_PRINTTAB:
+            emit_c(ctx, "    --sp; print_tab(ctx, sp->value);\n");
+            break;
+
+        case OP_PRINTCOMMA:
+            emit_c(ctx, "    print_tab(ctx, ctx->print_column + (PRINT_ZONE_LEN - (ctx->print_column %% PRINT_ZONE_LEN)));\n");
+            break;
+
+        case OP_PRINTEND:
+            emit_c(ctx, "    print_end(ctx, %d);\n", p[1]);
+            break;
+
+        case OP_READ:
+        case OP_DIM:
+            emit_c(ctx, "    sym = ctx->slot_table[%d]; sp -= %d; ctx->vm_pc = code + %d;\n", p[1], p[2], a);
+            emit_c(ctx, "    %s(ctx, sym, %d, sp);\n", p[0] == OP_READ ? "vm_read" : "vm_dim", p[2]);
+            break;
+
+        case OP_RESTORE:
+            emit_c(ctx, "    ctx->data_buffer_index = 0;\n");
+            break;
+
+        case OP_OPTIONBASE:
+            emit_c(ctx, "    --sp;\n    if (sp->value == 0 || sp->value == 1) ctx->option_base = sp->value;\n");
+            emit_c(ctx, "    else vm_error(ctx, code + %d, E_INVALID_OPTION_BASE);\n", a - 1);
+            break;
+
+        case OP_ADDVAR:
+            emit_c(ctx, "    sym = ctx->slot_table[%d];\n", p[1]);
+            emit_c_number(ctx, "    if (sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER) {\n        *sym->value_ptr += %s;\n", code_get32(p + 2));
+            emit_c(ctx, "        goto L%d;\n    }\n", o + 4 + 9);
+            break;
+
+        case OP_IFVAR:
+            s = p[2] >= OP_LT && p[2] <= OP_NEQ ? relops[p[2] - OP_LT] : "!=";
+            emit_c(ctx, "    sym = ctx->slot_table[%d];\n    if (sym->value_ptr != NULL && (sym->value_type & 0xff) == NUMBER) {\n", p[1]);
+            emit_c(ctx, "        if (*sym->value_ptr %s ", s);
+            emit_c_number(ctx, "%s)\n", code_get32(p + 3));
+            emit_c(ctx, "            goto L%d;\n        goto L%d;\n    }\n", o + 5 + 6 + 2, insn_code(ctx, p[12]));
+            break;
 
-    return insn+1;
+        default:
+            emit_c(ctx, "    vm_error(ctx, code + %d, E_SYNTAX_ERROR);\n    return NULL;\n", a);
+            break;
+    }
 }
 
-static int ICACHE_FLASH_ATTR stmt_for(int insn, struct urubasic_type *arg, void *user)
+void ICACHE_FLASH_ATTR urubasic_emit_c(struct urubasic_ctx *ctx)
 {
-    int start, end, step = 1, tok, i, n;
-    SYMIDX dummy, symidx;
-    char var[MAX_LINE_LEN];
-    struct urubasic_type tval = { 0, };
-
-    tok = lex_next_token(&dummy);
-    check_token(tok, dummy, IDENTIFIER, E_MISSING_IDENTIFIER);
-    strcpy(var, token_text);
-
-    tok = lex_next_token(&dummy);
-    check_token(tok, dummy, EQ, E_MISSING_EQUALSIGN);
-    expr(&tval);
-    start = tval.value;
-    symidx = assign(var, start);
-    tok = lex_next_token(&dummy);
-    check_token(tok, dummy, TO, E_MISSING_TO);
-    expr(&tval);
-    end = tval.value;
-
-    tok = lex_next_token(&dummy);
-    if (STEP == check_token(tok, dummy, STEP, 0)) {
-        expr(&tval);
-        step = tval.value;
+    // write the program as C source which runs it without the VM
+    struct Emit_c_text text;
+    int o, insn, *for_body;
+
+    if (ctx->code == NULL && !ctx->compile_failed)
+        compile_program(ctx);
+
+    emit_c(ctx, "// BASIC program translated to C by urubasic --emit-c, build it with the\n");
+    emit_c(ctx, "// runtime and the host functions of main.c:\n");
+    emit_c(ctx, "//     gcc -O3 -I<urubasic> -o prog prog.c main.c smemblk.c\n");
+    emit_c(ctx, "#define URUBASIC_AOT\n\n");
+    emit_c(ctx, "// the program is loaded as usual, for its symbols and lines\n");
+    emit_c(ctx, "static const char aot_text[] =\n");
+    output_flush(ctx);
+    text.write = ctx->output_write;
+    text.arg   = ctx->output_arg;
+    urubasic_set_output(ctx, emit_c_text, &text);
+    urubasic_list(ctx);
+    urubasic_set_output(ctx, text.write, text.arg);
+    emit_c(ctx, "    \"\";\n\n");
+    emit_c(ctx, "static const char aot_data[] =\n");
+    output_flush(ctx);
+    // the strings of DATA are written with their text, as they were loaded
+    for (o=0; o<ctx->data_buffer_max; o+=data_len(&ctx->data_buffer[o])) {
+        if (ctx->data_buffer[o] == -1) {
+            char head[2], *s = ctx->const_pool + data_offset(&ctx->data_buffer[o]);
+
+            head[0] = -1;
+            head[1] = (char) (((struct String *) s - 1)->len + 1);
+            emit_c_text(&text, head, 2);
+            emit_c_text(&text, s, (uint8_t) head[1]);
+        }
+        else
+            emit_c_text(&text, &ctx->data_buffer[o], 1 + ctx->data_buffer[o]);
     }
-    else
-        lex_push_token(tok);
-
-    ++insn;
-    n = for_loop_stack[0];
-    // walk the stack and remove entries if we find the same for loop again
-    for (i=0; n >= 3*(i+1); ++i) {
-        if (for_loop_stack[n-(3*i+2)] == insn && for_loop_stack[n-(3*i+1)] == end && for_loop_stack[n-(3*i+0)] == step) {
-            for_loop_stack[0] = n-3*(i+1);
-            break;
+    emit_c(ctx, "    \"\";\n\n");
+    emit_c(ctx, "static const unsigned int aot_code_hash = 0x%08xu;\n\n", ctx->code != NULL ? code_hash(ctx) : 0);
+    emit_c(ctx, "#include \"urubasic.c\"\n\n");
+
+    emit_c(ctx, "static struct urubasic_type *aot_run(struct urubasic_ctx *ctx, code_t *pc, struct urubasic_type *sp)\n{\n");
+    emit_c(ctx, "    code_t *code = ctx->code;\n    struct urubasic_type *arg = NULL, result;\n    struct symbol_def *sym;\n");
+    emit_c(ctx, "    struct Frame *frame;\n    int *value_ptr, n, v, end, step;\n\n");
+    emit_c(ctx, "    (void) arg; (void) result; (void) sym; (void) frame; (void) value_ptr; (void) n; (void) v; (void) end; (void) step;\n");
+    emit_c(ctx, "    goto dispatch;\n\n    // computed jumps of GOTO, RETURN and NEXT\ndispatch:\n    switch (pc - code) {\n");
+    for (o=0; o<ctx->code_len; o+=code_op_len(ctx->code + o))
+        emit_c(ctx, "    case %d: goto L%d;\n", o, o);
+    emit_c(ctx, "    }\n    return NULL;\n\n");
+
+    // NEXT goes straight back to the body of the last FOR of its variable
+    for_body = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) ((ctx->slot_count + 1) * sizeof(int)));
+    for (o=0; for_body != NULL && o<=ctx->slot_count; ++o)
+        for_body[o] = -1;
+    for (o=0, insn=0; o<ctx->code_len; o+=code_op_len(ctx->code + o)) {
+        while (insn < ctx->insn_count && ctx->insn_info[insn].code <= o) {
+            if (ctx->insn_info[insn].code == o)
+                emit_c_source(ctx, insn);
+            ++insn;
         }
+        if (ctx->code[o] == OP_FOR && for_body != NULL)
+            for_body[ctx->code[o+1]] = o + 4;
+        emit_c_op(ctx, o, ctx->code[o] == OP_NEXT && for_body != NULL ? for_body[ctx->code[o+1]] : -1);
     }
-
-    stack_push(for_loop_stack, insn);
-    stack_push(for_loop_stack, end);
-    stack_push(for_loop_stack, step);
-    if ((step > 0 && start > end) || (step < 0 && start < end))
-        master_control = symidx; // prevent execution until NEXT
-    return insn;
+    emit_c(ctx, "}\n");
+    smemblk_free(ctx->symbol_names, for_body);
+    output_flush(ctx);
 }
+#endif
 
-static int ICACHE_FLASH_ATTR stmt_gosub(int insn, struct urubasic_type *arg, void *user)
+void ICACHE_FLASH_ATTR urubasic_execute(struct urubasic_ctx *ctx, int insn)
 {
-    stack_push(for_loop_stack, insn+1);
-    stack_push(for_loop_stack, -1);
-    stack_push(for_loop_stack, 0);
-    return stmt_goto(insn, arg, user);
+    // the program is compiled on first use, when all host functions are known
+    if (ctx->code == NULL && !ctx->compile_failed) {
+        compile_program(ctx);
+#ifdef URUBASIC_AOT
+        ctx->aot_ok = ctx->code != NULL && code_hash(ctx) == aot_code_hash;
+#endif
+    }
+    if (ctx->code == NULL)
+        return;
+
+    ctx->frame_count = 0;    // reset GOSUB and FOR/NEXT stack
+    ctx->vm_pc = ctx->code;
+#ifdef URUBASIC_AOT
+    if (ctx->aot_ok)
+        aot_run(ctx, ctx->code + insn_code(ctx, find_insn(ctx, insn)), ctx->vm_stack);
+    else
+#endif
+    vm_run(ctx, ctx->code + insn_code(ctx, find_insn(ctx, insn)), ctx->vm_stack);
+    ctx->vm_pc = NULL;
+    output_flush(ctx);
 }
 
-static int ICACHE_FLASH_ATTR stmt_on(int insn, struct urubasic_type *arg, void *user)
+void ICACHE_FLASH_ATTR urubasic_list(struct urubasic_ctx *ctx)
 {
-    int val, val_expr, n = 1, tok, new_insn = -1, gosub = 0;
-    SYMIDX dummy;
-    struct urubasic_type tval = { 0, };
-
-    expr(&tval);
-    val_expr = tval.value;
-
-    tok = lex_next_token(&dummy);
-    if (GOSUB == check_token(tok, dummy, GOSUB, 0))
-        gosub = 1;
-    else
-        check_token(tok, dummy, GOTO, E_MISSING_GOTO);
-    while (new_insn == -1) {
-        expr(&tval);
-        val = tval.value;
+    // write the program to the output like LIST does
+    char temp[16];
+    int insn, label = 0, n;
 
-        if (n != val_expr) {
-            tok = lex_next_token(&dummy);
-            ++n;
-            if (!check_token(tok, dummy, COMMA, 0)) {
-                lex_push_token(tok);
-                new_insn = insn+1;
-            }
-        }
+    for (insn=0; insn<ctx->insn_count; ++insn) {
+        if (ctx->insn_info[insn].sep == ':' && ctx->insn_info[insn].label == label)
+            output_text(ctx, ": ", 2);
         else {
-            if (gosub) {
-                stack_push(for_loop_stack, insn+1);
-                stack_push(for_loop_stack, -1);
-                stack_push(for_loop_stack, 0);
+            // a line which ends with a colon continues the instruction
+            if (ctx->insn_info[insn].sep == ':')
+                output_text(ctx, ":", 1);
+            if (insn > 0)
+                output_text(ctx, "\n", 1);
+            if (ctx->insn_info[insn].label != label) {
+                n = format_number(temp, ctx->insn_info[insn].label);
+                output_text(ctx, temp + 1, n - 1);
             }
-            new_insn = find_insn(val);
         }
+        label = ctx->insn_info[insn].label;
+        list_insn(ctx, insn, NULL, 0);
     }
-
-    return new_insn;
+    if (ctx->insn_count > 0)
+        output_text(ctx, "\n", 1);
+    output_flush(ctx);
 }
 
-static int ICACHE_FLASH_ATTR stmt_return(int insn, struct urubasic_type *arg, void *user)
-{
-    int step = 0, end = 0;
-    do {
-        // pop stack until we find a GOSUB (step = 0 and end = -1)
-        if (!stack_empty(for_loop_stack)) step = stack_pop(for_loop_stack); else return -1;
-        if (!stack_empty(for_loop_stack)) end = stack_pop(for_loop_stack);
-        if (stack_empty(for_loop_stack))
-            insn = -1;
-        else
-            insn = stack_pop(for_loop_stack);
-    } while (end != -1 || step != 0);
+void ICACHE_FLASH_ATTR urubasic_set_optimize(struct urubasic_ctx *ctx, int level)
+{
+    // the program is compiled on first use
+    ctx->optimize = (int8_t) (level < 0 ? 0 : (level > 2 ? 2 : level));
+}
 
-    return insn;
+void ICACHE_FLASH_ATTR urubasic_set_output(struct urubasic_ctx *ctx, int (*write)(void *arg, const char *buf, int len), void *arg)
+{
+    output_flush(ctx);
+    ctx->output_write = write;
+    ctx->output_arg = arg;
 }
 
-static int ICACHE_FLASH_ATTR stmt_let(int insn, struct urubasic_type *arg, void *user)
+static void ICACHE_FLASH_ATTR increase_data_buffer(struct urubasic_ctx *ctx, int bytes)
 {
-    int tok, *value_ptr;
-    SYMIDX symidx, dummy;
-    struct urubasic_type tval = { 0, };
+    if (ctx->data_buffer == NULL || ctx->data_buffer_index + bytes > ctx->data_buffer_max)
+        ctx->data_buffer = smemblk_realloc(ctx->symbol_names, ctx->data_buffer, ctx->data_buffer_max += (bytes > 128 ? bytes : 128));
+}
 
-    tok = lex_next_token(&symidx);
-    check_token(tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER);
-    if (symidx == 0)
-        symidx = parse_lookup_symbol(token_text, 1);
-    if (symidx == NULL) {
-        parse_error(E_OUT_OF_MEMORY);
-        return -1;
-    }
+static void ICACHE_FLASH_ATTR intern_data(struct urubasic_ctx *ctx)
+{
+    // the strings of DATA move to the constant pool, READ shares them. A
+    // string -1, length with the NUL, text becomes -1 and the offset of the
+    // text. The records are converted in place, a short string with a 32-bit
+    // offset grows, so the records move up by the bytes they grow first
+    char *data = ctx->data_buffer;
+    int i, j = 0, len, offset, grow = 0, end = ctx->data_buffer_max;
+
+    for (i=0; i<end; i+=data[i] == -1 ? 2 + (uint8_t) data[i+1] : 1 + data[i]) {
+        if (data[i] == -1 && 2 + (uint8_t) data[i+1] < 1 + (int) sizeof(code_t))
+            grow += 1 + (int) sizeof(code_t) - 2 - (uint8_t) data[i+1];
+    }
+    if (grow > 0) {
+        data = smemblk_realloc(ctx->symbol_names, ctx->data_buffer, (smemblk_size_t) (end + grow));
+        if (data == NULL) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            ctx->data_buffer_max = 0;
+            return;
+        }
+        ctx->data_buffer = data;
+        memmove(data + grow, data, (size_t) end);
+        end += grow;
+    }
 
-    value_ptr = parse_subscript(symidx);
-    tok = lex_next_token(&dummy);
-    check_token(tok, dummy, EQ, E_MISSING_EQUALSIGN);
-    if (value_ptr != NULL) {
-        expr(&tval);
-        if ((tval.type & 0xff) == STRING) {
-            if (get_symbol(symidx)->array_base_size != 0)
-                parse_error(E_WRONG_TYPE);
-            set_value_type(symidx, STRING);
-            smemblk_free(symbol_names, get_symbol(symidx)->value_ptr);
-            get_symbol(symidx)->value_ptr = (int *) ((char *) symbol_names + tval.value);
+    for (i=grow; i<end; ) {
+        if (data[i] == -1) {
+            len = (uint8_t) data[i+1];
+            offset = const_string(ctx, &data[i+2], len - 1);
+            if (offset < 0) {
+                // DATA which does not fit is cut
+                parse_error(ctx, -offset);
+                break;
+            }
+            i += 2 + len;
+            data[j] = -1;
+            for (len=(int) sizeof(code_t); len>0; --len, offset >>= 8)
+                data[j+len] = (char) offset;
+            j += 1 + (int) sizeof(code_t);
         }
         else {
-            set_value_type(symidx, NUMBER);
-            *value_ptr = tval.value;
+            len = 1 + data[i];
+            memmove(&data[j], &data[i], (size_t) len);
+            i += len;
+            j += len;
         }
     }
-    return insn+1;
+    ctx->data_buffer_max = j;
 }
 
-static int ICACHE_FLASH_ATTR stmt_if(int insn, struct urubasic_type *arg, void *user)
+static void ICACHE_FLASH_ATTR read_data(struct urubasic_ctx *ctx, int max_data_buffer)
 {
-    int tok;
+    int tok, value, len, i;
     SYMIDX dummy;
-    struct urubasic_type tval;
 
-    expr(&tval);
-    tok = lex_next_token(&dummy);
-    check_token(tok, dummy, THEN, E_MISSING_THEN);
-    if (tval.value) {
-        // then
-        insn = stmt(insn);
-    }
-    else {
-        // else: find the next \n seperated line
-        ++insn;
-        while (insn_info[insn].sep == ':')
-            ++insn;
-    }
+    do {
+        tok = lex_next_token(ctx, &dummy);
+        if (tok == IDENTIFIER || (tok & 0xff) == STRING) {
+            len = 1+strlen(ctx->token_text);
+            if (len > 255) {
+                len = 255;  // the length is stored in one byte
+                ctx->token_text[len-1] = '\0';
+            }
+            increase_data_buffer(ctx, 2+len);
+            ctx->data_buffer[ctx->data_buffer_index++] = -1; // string indicator
+            strcpy(&ctx->data_buffer[ctx->data_buffer_index+1], ctx->token_text);
+            ctx->data_buffer[ctx->data_buffer_index] = len;
+            ctx->data_buffer_index += 1+len;
+        }
+        else if (tok == NUMBER || tok == MINUS) {
+            value = 1;
+            if (tok == MINUS) {
+                value = -1;
+                tok = lex_next_token(ctx, &dummy);
+                check_token(ctx, tok, dummy, NUMBER, E_MISSING_NUMBER);
+            }
+            value *= ctx->token_value;
 
-    return insn;
+            // big endian with 1, 2 or 4 bytes
+            if (value >= -128 && value <= 127)
+                len = 1;
+            else if (value >= -32768 && value <= 32767)
+                len = 2;
+            else
+                len = 4;
+            increase_data_buffer(ctx, 1+len);
+            ctx->data_buffer[ctx->data_buffer_index] = len;
+            for (i=len; i>0; --i) {
+                ctx->data_buffer[ctx->data_buffer_index+i] = value & 0xff;
+                value >>= 8;
+            }
+            ctx->data_buffer_index += 1+len;
+        }
+        tok = lex_next_token(ctx, &dummy);
+    } while (COMMA == check_token(ctx, tok, dummy, COMMA, 0));
+    ctx->current_char = tok == COLON ? ':' : '\n';    // a colon ends the instruction, see load_text()
+
+    // a record of size 0 ends the instruction, LIST finds its constants by it
+    increase_data_buffer(ctx, 1);
+    if (ctx->data_buffer != NULL)
+        ctx->data_buffer[ctx->data_buffer_index++] = 0;
+}
+
+// keywords and builtin functions are the same for every context. Keywords are
+// in the order of keyword_index(), their symbols are used as they are, a
+// builtin function gets a symbol of its own when the program uses it
+#define STD(name, func, tok) { { NULL, -1, 0, NUMBER, tok, 0, 0 }, name, func }
+
+static const struct Std_symbol std_symbols[STD_SYMBOLS] = {
+    STD("", NULL, 0),
+    STD("PRINT", compile_print, PRINT),
+    STD("GOTO", compile_goto, GOTO),
+    STD("END", compile_stop, END),
+    STD("FOR", compile_for, FOR),
+    STD("TO", NULL, TO),
+    STD("NEXT", compile_next, NEXT),
+    STD("REM", compile_rem, REM),
+    STD("GOSUB", compile_gosub, GOSUB),
+    STD("RETURN", compile_return, RETURN),
+    STD("LET", compile_let, LET),
+    STD("IF", compile_if, IF),
+    STD("THEN", NULL, THEN),
+    STD("STOP", compile_stop, STOP),
+    STD("STEP", NULL, STEP),
+    STD("DEF", compile_def, DEF),
+    STD("TAB", NULL, TAB),
+    STD("ON", compile_on, ON),
+    STD("READ", compile_read, READ),
+    STD("RESTORE", compile_restore, RESTORE),
+    STD("DATA", compile_rem, DATA),
+    STD("OPTION", compile_option, OPTION),
+    STD("BASE", NULL, BASE),
+    STD("DIM", compile_dim, DIM),
+    STD("AND", NULL, AND),
+    STD("OR", NULL, OR),
+    STD("NOT", NULL, NOT),
+    STD("ABS", func_abs, FUNCTION),
+    STD("MIN", func_min, FUNCTION),
+    STD("MAX", func_max, FUNCTION),
+    STD("SGN", func_sgn, FUNCTION),
+    STD("LEN", func_len, FUNCTION),
+    STD("CHR$", func_chrS, FUNCTION),
+    STD("LEFT$", func_leftS, FUNCTION),
+    STD("MID$", func_midS, FUNCTION),
+    STD("RIGHT$", func_rightS, FUNCTION),
+    STD("ASC", func_asc, FUNCTION),
+    STD("STR$", func_strS, FUNCTION),
+    STD("STRING$", func_stringS, FUNCTION),
+};
+
+// perfect hash of the names above, std_hash[] of the hash in std_symbol() is the index
+// of the only entry the name can be. When a name is added the factor 22 is
+// searched again so that no two names share an entry
+static const uint8_t std_hash[STD_HASH_SIZE] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 12,  0,
+    15, 11,  0,  0,  0,  0,  0,  0,  0, 14, 33, 32,  0,  0,  0, 17,
+     0, 29,  0, 25,  4,  5,  0,  6, 27, 22,  0,  0,  0,  0, 23,  0,
+     0, 18,  0,  0,  0,  0,  0, 37,  7,  0, 38, 35,  0,  8,  0,  0,
+    19, 20,  0,  0, 16,  0,  0,  0, 31,  0,  0,  0, 10, 28,  0,  0,
+     0, 30,  2,  0,  0,  9,  0,  0, 26, 36,  0,  0,  0, 21,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 24,  0,  0,  1,  3,  0,
+     0,  0, 34,  0,  0, 13,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+#undef STD
+
+static int ICACHE_FLASH_ATTR std_index(const char *name)
+{
+    // all keywords and builtins have two characters at least
+    const unsigned char *s = (const unsigned char *) name;
+    int i;
+
+    if (s[0] == '\0' || s[1] == '\0')
+        return 0;
+    i = std_hash[(s[0] + s[1] + 22 * s[2] + strlen(name)) & (STD_HASH_SIZE-1)];
+    return 0 == strcmp(std_symbols[i].name, name) ? i : 0;
 }
 
-static int ICACHE_FLASH_ATTR stmt_option(int insn, struct urubasic_type *arg, void *user)
+static SYMIDX ICACHE_FLASH_ATTR std_symbol(int index)
 {
-    int tok, v;
-    SYMIDX dummy;
-    struct urubasic_type tval = { 0, };
-
-    tok = lex_next_token(&dummy);
-    check_token(tok, dummy, BASE, E_MISSING_BASE);
-    expr(&tval);
-    v = tval.value;
-    if (v == 0 || v == 1)
-        option_base = v;
-    else
-        parse_error(E_INVALID_OPTION_BASE);
-    return insn+1;
+    return (SYMIDX) &std_symbols[index].sym;
 }
 
-static int ICACHE_FLASH_ATTR stmt_dim(int insn, struct urubasic_type *arg, void *user)
+static int ICACHE_FLASH_ATTR compile_keyword(struct urubasic_ctx *ctx, int tok, int insn)
 {
-    int tok, x, y, size, y_set;
-    SYMIDX symidx, dummy;
-    struct urubasic_type tval = { 0, };
-
-    do {
-        x = 0;
-        y = option_base;
-        y_set = 0;
-        tok = lex_next_token(&symidx);
-        check_token(tok, symidx, IDENTIFIER, E_MISSING_IDENTIFIER);
-        if (symidx == 0)
-            symidx = parse_lookup_symbol(token_text, 1);
-
-        tok = lex_next_token(&dummy);
-        if (LPAREN == check_token(tok, dummy, LPAREN, 0)) {
-            expr(&tval);
-            x = tval.value;
-            tok = lex_next_token(&dummy);
-            if (COMMA == check_token(tok, dummy, COMMA, 0)) {
-                expr(&tval);
-                y = tval.value;
-                y_set = 1;
-                tok = lex_next_token(&dummy);
-            }
-            check_token(tok, dummy, RPAREN, E_MISSING_RPAREN);
-        }
+    // returns 0 if the keyword does not start a statement
+    const struct Std_symbol *std = &std_symbols[keyword_index(tok)];
+
+    if (std->func == NULL)
+        return 0;
+    std->func(ctx, insn, NULL, NULL);
+    return 1;
+}
 
-        if (x < option_base || (y_set && y < option_base))
-            parse_error(E_INVALID_DIM);
+static int ICACHE_FLASH_ATTR call_function(struct urubasic_ctx *ctx, SYMIDX symidx, int n, struct urubasic_type *arg)
+{
+    int func = get_symbol(symidx)->func;
 
-        get_symbol(symidx)->array_base_size = x - option_base + 1;
-        size = get_symbol(symidx)->array_base_size * (y - option_base + 1) * sizeof(int);
-        get_symbol(symidx)->value_ptr = smemblk_realloc(symbol_names, get_symbol(symidx)->value_ptr, (int16_t) size);
-        tok = lex_next_token(&dummy);
-    } while (COMMA == check_token(tok, dummy, COMMA, 0));
+    if (func < STD_SYMBOLS)
+        return std_symbols[func].func(ctx, n, arg, NULL);
+    return ctx->functions[func - STD_SYMBOLS].func(ctx, n, arg, ctx->functions[func - STD_SYMBOLS].user);
+}
 
-    lex_push_token(tok);
-    return insn+1;
+static struct urubasic_ctx * ICACHE_FLASH_ATTR load_begin(void *mem, int max_mem)
+{
+    struct urubasic_ctx *ctx;
+    smemblk_t *heap;
+
+    // without a buffer the heap grows up to max_mem bytes
+    if (mem == NULL)
+        heap = smemblk_init_mmap(max_mem < HEAP_INITIAL_SIZE ? max_mem : HEAP_INITIAL_SIZE, max_mem);
+    else
+        heap = smemblk_init(mem, max_mem);
+
+    // the context is the first block of its own heap
+    ctx = smemblk_zalloc(heap, sizeof(*ctx));
+    if (ctx == NULL) {
+        if (heap != NULL)
+            smemblk_term(heap);
+        return NULL;
+    }
+    ctx->symbol_names = heap;
+    ctx->output_write = write_stdout;
+    ctx->optimize     = 1;      // level 2 only when the host asks for it
+    ctx->string_free  = -1;
+
+    ctx->token_text = smemblk_alloc(ctx->symbol_names, MAX_LINE_LEN);
+    if (ctx->token_text != NULL)
+        ctx->token_max = MAX_LINE_LEN;
+    return ctx;
 }
 
-static int ICACHE_FLASH_ATTR stmt(int insn)
+static int ICACHE_FLASH_ATTR load_insn(struct urubasic_ctx *ctx, int sep)
 {
-    int tok;
-    SYMIDX symidx;
+    // append an instruction, returns its index or -1 if it does not fit
+    int insn = ctx->insn_count;
 
-    tok = lex_next_token(&symidx);
-    if (tok == 0)
-        return -1;
+    if (ctx->insn_info == NULL || insn >= ctx->insn_max) {
+        struct Insn_info *p;
 
-    if (is_keyword(symidx) && get_symbol(symidx)->tok == NEXT)
-        insn = get_symbol(symidx)->func(insn, NULL, (void *) get_symbol(symidx)->value_ptr);
-    else if (master_control) {
-        ++insn;
-    }
-    else if (tok == NUMBER) {
-        struct urubasic_type tval = { 0, };
-        lex_push_token(tok);
-        expr(&tval);
-        insn = find_insn(tval.value);
-    }
-    else if (is_keyword(symidx))
-        insn = get_symbol(symidx)->func(insn, NULL, (void *) get_symbol(symidx)->value_ptr);
-    else if (IDENTIFIER == check_token(tok, symidx, IDENTIFIER, 0)) {
-        lex_push_token(tok);
-        insn = stmt_let(insn, NULL, NULL);
-    }
-    else if (FUNCTION == check_token(tok, symidx, FUNCTION, 0)) {
-        struct urubasic_type tval;
-        if (symidx == 0)
-            symidx = parse_lookup_symbol(token_text, 1);
-        function_call(symidx, 1, &tval);
-        ++insn;
-    }
-    else {
-        parse_error(E_SYNTAX_ERROR);
-        insn = -1;
+        // the code refers to instructions by their index in a code word
+        if (ctx->insn_max + 32 >= CODE_MAX || (ctx->insn_max + 32) * sizeof(struct Insn_info) >= SMEMBLK_MAX_SIZE) {
+            parse_error(ctx, E_PROGRAM_TOO_LARGE);
+            return -1;
+        }
+        p = smemblk_realloc(ctx->symbol_names, ctx->insn_info, (smemblk_size_t) ((ctx->insn_max + 32) * sizeof(struct Insn_info)));
+        if (p == NULL) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            return -1;
+        }
+        ctx->insn_info = p;
+        ctx->insn_max += 32;
     }
 
+    ++ctx->insn_count;
+    ctx->insn_info[insn].line  = NULL;
+    ctx->insn_info[insn].sep   = sep;
+    ctx->insn_info[insn].label = insn > 0 ? ctx->insn_info[insn-1].label : 0;
     return insn;
 }
 
-void ICACHE_FLASH_ATTR urubasic_execute(int insn)
+static int ICACHE_FLASH_ATTR crunch_reserve(struct urubasic_ctx *ctx, unsigned char **buf, int *max, int len)
 {
-    // execute until END or no more instruction
-    for_loop_stack[0] = 0;  // reset GOSUB and FOR/NEXT stack
-    insn = find_insn(insn);
-    while (insn >= 0 && insn < insn_count) {
-        lex_clear();
-        pushed_token_stack[0] = 0;
-        lex_input_buffer = insn_info[insn].line;
-        current_line = insn_info[insn].label;
-        insn = stmt(insn);
-    }
-}
+    // make room for len bytes of tokens
+    unsigned char *p = NULL;
 
-static void ICACHE_FLASH_ATTR increase_data_buffer(int bytes)
-{
-    if (data_buffer == NULL || data_buffer_index + bytes > data_buffer_max)
-        data_buffer = smemblk_realloc(symbol_names, data_buffer, data_buffer_max += (bytes > 128 ? bytes : 128));
+    if (len > *max) {
+        if (len + MAX_LINE_LEN < SMEMBLK_MAX_SIZE)
+            p = smemblk_realloc(ctx->symbol_names, *buf, (smemblk_size_t) (len + MAX_LINE_LEN));
+        if (p == NULL)
+            return 0;
+        *buf = p;
+        *max = len + MAX_LINE_LEN;
+    }
+    return 1;
 }
 
-static void ICACHE_FLASH_ATTR read_data(int max_data_buffer)
+static int ICACHE_FLASH_ATTR crunch_insn(struct urubasic_ctx *ctx, int insn, unsigned char **scratch, int *max)
 {
-    int tok;
-    SYMIDX dummy;
-    struct urubasic_type tval = { 0, };
+    // replace the text of an instruction by its tokens. Keywords and operators
+    // take one byte, numbers four bytes and names the two byte index of their
+    // slot. The tokens are collected in scratch and stored in a block of their size
+    unsigned char *buf;
+    int tok, len = 0, n, slot;
+    SYMIDX symidx;
 
+    lex_clear(ctx);
+    ctx->lex_input_buffer = ctx->insn_info[insn].line;
+    ctx->current_line = ctx->insn_info[insn].label;
     do {
-        tok = lex_next_token(&dummy);
-        if (tok == IDENTIFIER || (tok & 0xff) == STRING) {
-            int len = 1+strlen(token_text);
-            increase_data_buffer(1+len);
-            data_buffer[data_buffer_index++] = -1; // string indicator
-            strcpy(&data_buffer[data_buffer_index+1], token_text);
-            data_buffer[data_buffer_index] = len;
-            data_buffer_index += 1+len;
+        tok = lex_scan(ctx, &symidx);
+        if (tok == IDENTIFIER && symidx == NULL)
+            symidx = parse_lookup_symbol(ctx, ctx->token_text, 1);
+
+        n = tok == NUMBER ? 5 : (tok == STRING ? 2 + strlen(ctx->token_text) : 3);
+        if ((tok == IDENTIFIER && symidx == NULL) || !crunch_reserve(ctx, scratch, max, len + n)) {
+            ctx->lex_input_buffer = NULL;
+            return 0;
         }
-        else if (tok == NUMBER || tok == MINUS) {
-            lex_push_token(tok);
-            expr(&tval);
-            if (tval.value >= -128 && tval.value < 0xff) {
-                increase_data_buffer(2);
-                data_buffer[data_buffer_index] = 1;
-                data_buffer[data_buffer_index+1] = tval.value;
-                data_buffer_index += 2;
-            }
-            else if (tval.value >= -32768 && tval.value < 0xffff) {
-                increase_data_buffer(3);
-                data_buffer[data_buffer_index] = 2;
-                data_buffer[data_buffer_index+1] = (tval.value >> 8) & 0xff;
-                data_buffer[data_buffer_index+2] = tval.value & 0xff;
-                data_buffer_index += 3;
-            }
-            else {
-                increase_data_buffer(5);
-                data_buffer[data_buffer_index] = 4;
-                data_buffer[data_buffer_index+1] = (tval.value >> 24) & 0xff;
-                data_buffer[data_buffer_index+2] = (tval.value >> 16) & 0xff;
-                data_buffer[data_buffer_index+3] = (tval.value >> 8) & 0xff;
-                data_buffer[data_buffer_index+4] = tval.value & 0xff;
-                data_buffer_index += 5;
+        buf = *scratch;
+
+        if (symidx != NULL && keyword_index(tok) < 0) {
+            if ((slot = code_slot(ctx, symidx)) == 0) {
+                ctx->lex_input_buffer = NULL;
+                return 0;
             }
+            buf[len++] = IDENTIFIER;
+            buf[len++] = (unsigned char) slot;
+            buf[len++] = (unsigned char) (slot >> 8);
+        }
+        else if (tok == NUMBER) {
+            buf[len++] = NUMBER;
+            for (n=0; n<32; n+=8)
+                buf[len++] = (unsigned char) ((uint32_t) ctx->token_value >> n);
+        }
+        else if (tok == STRING) {
+            buf[len++] = STRING;
+            strcpy((char *) buf + len, ctx->token_text);
+            len += n - 1;
+        }
+        else {
+            buf[len++] = (unsigned char) tok;
+            if (tok == ILLEGAL)
+                buf[len++] = (unsigned char) ctx->token_value;
         }
-        tok = lex_next_token(&dummy);
-    } while (COMMA == check_token(tok, dummy, COMMA, 0));
-    current_char = '\n';
+    } while (tok != 0);
+
+    // the text is freed first, so the tokens can take its place
+    ctx->lex_input_buffer = NULL;
+    smemblk_free(ctx->symbol_names, ctx->insn_info[insn].line);
+    ctx->insn_info[insn].line = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) len);
+    if (ctx->insn_info[insn].line == NULL)
+        return 0;
+    memcpy(ctx->insn_info[insn].line, *scratch, len);
+    return 1;
 }
-
-static void ICACHE_FLASH_ATTR add_std_symbols(void)
-{
-    add_symbol_intern("", 0, NULL, NULL);
-    add_symbol_intern("NEXT", NEXT, stmt_next, NULL);
-    add_symbol_intern("PRINT", PRINT, stmt_print, NULL);
-    add_symbol_intern("GOTO", GOTO, stmt_goto, NULL);
-    add_symbol_intern("END", END, stmt_stop, NULL);
-    add_symbol_intern("FOR", FOR, stmt_for, NULL);
-    add_symbol_intern("TO", TO, NULL, NULL);
-    add_symbol_intern("REM", REM, stmt_rem, NULL);
-    add_symbol_intern("GOSUB", GOSUB, stmt_gosub, NULL);
-    add_symbol_intern("RETURN", RETURN, stmt_return, NULL);
-    add_symbol_intern("LET", LET, stmt_let, NULL);
-    add_symbol_intern("IF", IF, stmt_if, NULL);
-    add_symbol_intern("THEN", THEN, NULL, NULL);
-    add_symbol_intern("TAB", TAB, NULL, NULL);
-    add_symbol_intern("STOP", STOP, stmt_stop, NULL);
-    add_symbol_intern("STEP", STEP, NULL, NULL);
-    add_symbol_intern("DEF", DEF, stmt_def, NULL);
-    add_symbol_intern("ON", ON, stmt_on, NULL);
-    add_symbol_intern("ABS", FUNCTION, func_abs, NULL);
-    add_symbol_intern("MIN", FUNCTION, func_min, NULL);
-    add_symbol_intern("MAX", FUNCTION, func_max, NULL);
-    add_symbol_intern("SGN", FUNCTION, func_sgn, NULL);
-    add_symbol_intern("DATA", DATA, stmt_rem, NULL);
-    add_symbol_intern("READ", READ, stmt_read, NULL);
-    add_symbol_intern("RESTORE", RESTORE, stmt_restore, NULL);
-    add_symbol_intern("OPTION", OPTION, stmt_option, NULL);
-    add_symbol_intern("BASE", BASE, NULL, NULL);
-    add_symbol_intern("DIM", DIM, stmt_dim, NULL);
-    add_symbol_intern("LEN", FUNCTION, func_len, NULL);
-    add_symbol_intern("CHR$", FUNCTION, func_chrS, NULL);
-    add_symbol_intern("LEFT$", FUNCTION, func_leftS, NULL);
-    add_symbol_intern("MID$", FUNCTION, func_midS, NULL);
-    add_symbol_intern("RIGHT$", FUNCTION, func_rightS, NULL);
-    add_symbol_intern("ASC", FUNCTION, func_asc, NULL);
-    add_symbol_intern("STR$", FUNCTION, func_strS, NULL);
-    add_symbol_intern("AND", AND, NULL, NULL);
-    add_symbol_intern("NOT", NOT, NULL, NULL);
-    add_symbol_intern("OR", OR, NULL, NULL);
-    add_symbol_intern("STRING$", FUNCTION, func_stringS, NULL);
-}
-
-int ICACHE_FLASH_ATTR urubasic_init(void *mem, int max_mem, int (*read_from_stdin)(void *), void *arg)
+
+static void ICACHE_FLASH_ATTR load_end(struct urubasic_ctx *ctx)
+{
+    unsigned char *scratch = NULL;
+    int insn, max = 0;
+
+    // shrink buffers to max used bytes
+    ctx->insn_info = smemblk_realloc(ctx->symbol_names, ctx->insn_info, (smemblk_size_t) ((ctx->insn_max = ctx->insn_count) * sizeof(struct Insn_info)));
+    ctx->data_buffer_max = ctx->data_buffer_index;
+    intern_data(ctx);
+    ctx->data_buffer = smemblk_realloc(ctx->symbol_names, ctx->data_buffer, ctx->data_buffer_max);
+    ctx->data_buffer_index = 0;
+    ctx->lex_input_buffer = NULL;
+    ctx->lex_readchar = read_from_buffer;
+    ctx->read_arg = ctx;
+
+    // the program is kept crunched, a program which does not fit is cut
+    for (insn=0; insn<ctx->insn_count; ++insn) {
+        if (!crunch_insn(ctx, insn, &scratch, &max)) {
+            if (!ctx->compile_failed)
+                parse_error(ctx, E_OUT_OF_MEMORY);
+            while (ctx->insn_count > insn)
+                smemblk_free(ctx->symbol_names, ctx->insn_info[--ctx->insn_count].line);
+        }
+    }
+    smemblk_free(ctx->symbol_names, scratch);
+    index_insns(ctx);
+}
+
+struct urubasic_ctx * ICACHE_FLASH_ATTR urubasic_init(void *mem, int max_mem, int (*read_from_stdin)(void *), void *arg)
 {
-    int insn, count, inside_remark, inside_string, sep = '\n', prev_char, offs;
-    char line[MAX_LINE_LEN];
+    struct urubasic_ctx *ctx;
+    int insn, count, inside_remark, inside_string, sep = '\n', prev_char, offs, line_max = MAX_LINE_LEN;
+    char *line, *p;
 
-    read_arg = arg;
-    lex_readchar = read_from_stdin;
-
-    symbol_names = smemblk_init(mem, max_mem);
-    hashtab = smemblk_zalloc(symbol_names, HASHSIZE * sizeof(SYMIDX) + ('_'-'A'+1) * sizeof(SYMIDX));
-    add_std_symbols();
+#ifdef URUBASIC_AOT
+    return urubasic_init_text(mem, max_mem, aot_text, sizeof(aot_text) - 1);
+#endif
+    ctx = load_begin(mem, max_mem);
+    if (ctx == NULL)
+        return NULL;
+    ctx->read_arg = arg;
+    ctx->lex_readchar = read_from_stdin;
+
+    // the line buffer grows for long lines
+    line = smemblk_alloc(ctx->symbol_names, line_max);
+    if (line == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        load_end(ctx);
+        return ctx;
+    }
 
-    lex_readchar = read_from_stdin;
     do {
 again:  do {
-            prev_char = current_char;
-            current_char = lex_readchar(read_arg);
-        } while (current_char == '\r' || current_char == '\n' || is_blank(current_char));
+            prev_char = ctx->current_char;
+            ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+        } while (ctx->current_char == '\r' || ctx->current_char == '\n' || is_blank(ctx->current_char));
 
-        if (current_char == '#') {
-            while (current_char != '\r' && current_char != '\n')
-                current_char = lex_readchar(read_arg);
+        if (ctx->current_char == '#') {
+            while (ctx->current_char != '\r' && ctx->current_char != '\n')
+                ctx->current_char = ctx->lex_readchar(ctx->read_arg);
             goto again;
         }
-        insn = insn_count++;
-        if (insn_info == NULL || insn_count > insn_max)
-            insn_info = smemblk_realloc(symbol_names, insn_info, (int16_t) ((insn_max += 32) * sizeof(struct Insn_info)));
+        insn = load_insn(ctx, sep);
+        if (insn < 0)
+            break;
 
         offs = 0;
-        insn_info[insn].line = line; //smemblk_alloc(symbol_names, MAX_LINE_LEN);
-        insn_info[insn].sep  = sep;
-        if (is_digit(current_char))
-            insn_info[insn].label  = read_number(10);
-        else if (insn > 0)
-            insn_info[insn].label  = insn_info[insn-1].label;
+        if (is_digit(ctx->current_char))
+            ctx->insn_info[insn].label  = read_number(ctx, 10);
 
-        while (is_blank(current_char)) {
-            prev_char = current_char;
-            current_char = lex_readchar(read_arg);
+        while (is_blank(ctx->current_char)) {
+            prev_char = ctx->current_char;
+            ctx->current_char = ctx->lex_readchar(ctx->read_arg);
         }
 
+        // the instruction ends with the line or at a colon outside of a string,
+        // a line with a label only is an empty instruction like in load_text()
         count = inside_remark = inside_string = 0;
-        do {
+        while (ctx->current_char != '\0' && ctx->current_char != '\r' && ctx->current_char != '\n' && (ctx->current_char != ':' || inside_string)) {
             if (!inside_remark) {
                 // only copy to line if it's not a comment and not double blank outside string
-                if (inside_string || !(is_blank(prev_char) && is_blank(current_char)))
-                    insn_info[insn].line[offs++] = (char) current_char;
+                if (inside_string || !(is_blank(prev_char) && is_blank(ctx->current_char))) {
+                    if (offs + 2 >= line_max && (p = smemblk_realloc(ctx->symbol_names, line, line_max + MAX_LINE_LEN)) != NULL) {
+                        line = p;
+                        line_max += MAX_LINE_LEN;
+                    }
+                    if (offs + 2 < line_max)
+                        line[offs++] = (char) ctx->current_char;
+                }
             }
-            prev_char = current_char;
-            current_char = lex_readchar(read_arg);
-            inside_string ^= (current_char == '\"');
+            prev_char = ctx->current_char;
+            ctx->current_char = ctx->lex_readchar(ctx->read_arg);
+            inside_string ^= (ctx->current_char == '\"');
             ++count;
-            if (count == 4 && 0 == strncmp(insn_info[insn].line, "REM ", count))
+            if (count == 4 && 0 == strncmp(line, "REM ", count))
                 inside_remark = 1;
-            else if (count == 5 && 0 == strncmp(insn_info[insn].line, "DATA ", count)) {
-                lex_shift();
-                read_data(max_mem / sizeof(data_buffer[0]));
+            else if (count == 5 && 0 == strncmp(line, "DATA ", count)) {
+                lex_shift(ctx);
+                read_data(ctx, max_mem / sizeof(ctx->data_buffer[0]));
             }
-        } while (current_char != '\0' && current_char != '\r' && current_char != '\n' && (current_char != ':' || inside_string));
+        }
+
+        sep = ctx->current_char == ':' ? ':' : '\n';
+        line[offs++] = sep;
+        line[offs++] = '\0';
+        ctx->insn_info[insn].line = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) offs);
+        if (ctx->insn_info[insn].line == NULL) {
+            parse_error(ctx, E_OUT_OF_MEMORY);
+            --ctx->insn_count;
+            break;
+        }
+        memcpy(ctx->insn_info[insn].line, line, offs);
+    } while (ctx->current_char);
 
-        sep = current_char == ':' ? ':' : '\n';
-        insn_info[insn].line[offs++] = sep;
-        insn_info[insn].line[offs++] = '\0';
-        insn_info[insn].line = smemblk_alloc(symbol_names, (int16_t) offs);
-        strcpy(insn_info[insn].line, line);
-    } while (current_char);
+    smemblk_free(ctx->symbol_names, line);
+    load_end(ctx);
+    return ctx;
+}
 
-    // shrink buffers to max used bytes
-    insn_info = smemblk_realloc(symbol_names, insn_info, (int16_t) ((insn_max = insn_count) * sizeof(struct Insn_info)));
-    data_buffer = smemblk_realloc(symbol_names, data_buffer, data_buffer_max = data_buffer_index);
-    data_buffer_index = 0;
-    lex_readchar = read_from_buffer;
+static int ICACHE_FLASH_ATTR load_text_line(struct urubasic_ctx *ctx, int insn, const char *text, int len, int sep)
+{
+    // store the instruction without double blanks outside of strings
+    int i, offs = 0, inside_string = 0;
+    char *line = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (len + 2));
 
+    if (line == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return 0;
+    }
+    for (i=0; i<len; ++i) {
+        inside_string ^= (text[i] == '\"');
+        if (inside_string || i == 0 || !(is_blank(text[i-1]) && is_blank(text[i])))
+            line[offs++] = text[i];
+    }
+    line[offs++] = (char) sep;
+    line[offs++] = '\0';
+    ctx->insn_info[insn].line = smemblk_realloc(ctx->symbol_names, line, (smemblk_size_t) offs);
     return 1;
 }
 
-void ICACHE_FLASH_ATTR urubasic_term(void)
+static void ICACHE_FLASH_ATTR load_text_data(struct urubasic_ctx *ctx, const char *text, int len, int max_mem)
 {
-    // free all variables
-
-    SYMIDX symidx, p;
-    int i;
-
-    for (i=0; i<HASHSIZE; ++i) {
-        symidx = hashtab[i];
-        while (symidx) {
-            p = symidx;
-            symidx = p->next;
-
-            if ((IDENTIFIER == p->tok || FUNCTION == p->tok) && p->value_ptr != NULL)
-                smemblk_free(symbol_names, p->value_ptr);
-
-            if (p->name != NULL && (p->value_type & NAME_ALLOC))
-               smemblk_free(symbol_names, p->name);
-
-            smemblk_free(symbol_names, p);
-        }
+    // the constants of a DATA instruction are read with the lexer from a copy
+    char *data = smemblk_alloc(ctx->symbol_names, (smemblk_size_t) (len + 1));
+
+    if (data == NULL) {
+        parse_error(ctx, E_OUT_OF_MEMORY);
+        return;
     }
-
-    // free memory
-    for (i=0; i<insn_count; ++i)
-        smemblk_free(symbol_names, insn_info[i].line);
-
-    smemblk_free(symbol_names, data_buffer);
-    smemblk_free(symbol_names, insn_info);
-    smemblk_free(symbol_names, hashtab);
-    smemblk_term(symbol_names); // check for memory leaks
-
-    // reset global variables
-    token_value = current_char = previous_char = token_len = 0;
-    pushed_token_stack[0] = 0;
-    insn_info = NULL;
-    insn_count = insn_max = 0;
-    current_line = 0;
-    hashtab = NULL;
-    for_loop_stack[0] = 0;
-    master_control = 0;
-    option_base = 0;
-    lex_readchar = NULL;
-    data_buffer = NULL;
-    data_buffer_index = data_buffer_max = 0;
-    symbol_names = NULL;
-    extra_table = NULL;
+    memcpy(data, text, len);
+    data[len] = '\0';
+
+    ctx->lex_input_buffer = data;
+    ctx->lex_readchar = read_from_buffer;
+    ctx->read_arg = ctx;
+    ctx->previous_char = 0;
+    ctx->pushed_token_stack[0] = 0;
+    read_data(ctx, max_mem / sizeof(ctx->data_buffer[0]));
+    ctx->lex_input_buffer = NULL;
+    smemblk_free(ctx->symbol_names, data);
+}
+
+static void ICACHE_FLASH_ATTR load_text(struct urubasic_ctx *ctx, const char *text, int len, int max_mem)
+{
+    const char *p, *end, *eol, *e, *q;
+    int insn, sep = '\n', label, inside_string;
+
+#ifdef URUBASIC_AOT
+    // a translated program always loads its own text
+    text = aot_text;
+    len = sizeof(aot_text) - 1;
+#endif
+    p = text;
+
+    // the text ends at its length or at the first NUL
+    end = memchr(text, '\0', len);
+    if (end == NULL)
+        end = text + len;
+
+    for (;;) {
+        while (p < end && (*p == '\r' || *p == '\n' || is_blank(*p)))
+            ++p;
+        if (p >= end)
+            break;
+        if (*p == '#') {
+            p = memchr(p, '\n', end - p);
+            if (p == NULL)
+                p = end;
+            continue;
+        }
+
+        insn = load_insn(ctx, sep);
+        if (insn < 0)
+            break;
+        if (p < end && is_digit(*p)) {
+            for (label = 0; p < end && is_digit(*p); ++p)
+                label = label * 10 + (*p - '0');
+            ctx->insn_info[insn].label = label;
+        }
+        while (p < end && is_blank(*p))
+            ++p;
+
+        // the instruction ends with the line or at a colon outside of a string
+        eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+        if ((e = memchr(p, '\r', eol - p)) != NULL)
+            eol = e;
+        e = eol;
+        if (memchr(p, ':', eol - p) != NULL) {
+            for (q = p, inside_string = 0; q < eol; ++q) {
+                inside_string ^= (*q == '\"');
+                if (*q == ':' && !inside_string)
+                    break;
+            }
+            e = q;
+        }
+        sep = e < end && *e == ':' ? ':' : '\n';
+
+        // only the keyword of REM and DATA is kept
+        if (e - p >= 4 && 0 == strncmp(p, "REM ", 4))
+            q = p + 4;
+        else if (e - p >= 5 && 0 == strncmp(p, "DATA ", 5)) {
+            q = p + 5;
+            load_text_data(ctx, q, (int) (e - q), max_mem);
+        }
+        else
+            q = e;
+        if (!load_text_line(ctx, insn, p, (int) (q - p), sep)) {
+            --ctx->insn_count;
+            break;
+        }
+        p = e < end ? e + 1 : end;
+    }
+
+    load_end(ctx);
+#ifdef URUBASIC_AOT
+    // DATA is loaded as it was translated
+    smemblk_free(ctx->symbol_names, ctx->data_buffer);
+    ctx->data_buffer = smemblk_alloc(ctx->symbol_names, sizeof(aot_data));
+    ctx->data_buffer_max = ctx->data_buffer != NULL ? sizeof(aot_data) - 1 : 0;
+    if (ctx->data_buffer != NULL)
+        memcpy(ctx->data_buffer, aot_data, sizeof(aot_data));
+    intern_data(ctx);
+#endif
+}
+
+struct urubasic_ctx * ICACHE_FLASH_ATTR urubasic_init_text(void *mem, int max_mem, const char *text, int len)
+{
+    struct urubasic_ctx *ctx = load_begin(mem, max_mem);
+
+    if (ctx != NULL)
+        load_text(ctx, text, len, max_mem);
+    return ctx;
+}
+
+#ifdef SMEMBLK_CHECK_LEAKS
+static void ICACHE_FLASH_ATTR free_all(struct urubasic_ctx *ctx)
+{
+    // free all variables
+
+    SYMIDX p;
+    struct Name_chunk *chunk;
+    smemblk_t *heap;
+    int i;
+
+    for (i=0; i<ctx->symtab_size; ++i) {
+        p = ctx->symtab[i];
+        if (p == NULL)
+            continue;
+        if (IDENTIFIER == p->tok && p->value_ptr != NULL)
+            free_value(ctx, p);
+        smemblk_free(ctx->symbol_names, p);
+    }
+    while (ctx->names != NULL) {
+        chunk = ctx->names;
+        ctx->names = chunk->next;
+        smemblk_free(ctx->symbol_names, chunk);
+    }
+
+    // free memory
+    for (i=0; i<ctx->insn_count; ++i)
+        smemblk_free(ctx->symbol_names, ctx->insn_info[i].line);
+
+    smemblk_free(ctx->symbol_names, ctx->code);
+    smemblk_free(ctx->symbol_names, ctx->slot_table);
+    smemblk_free(ctx->symbol_names, ctx->const_pool);
+    smemblk_free(ctx->symbol_names, ctx->string_heap);
+    smemblk_free(ctx->symbol_names, ctx->string_handles);
+    smemblk_free(ctx->symbol_names, ctx->vm_stack);
+    smemblk_free(ctx->symbol_names, ctx->vm_vars);
+    smemblk_free(ctx->symbol_names, ctx->data_buffer);
+    smemblk_free(ctx->symbol_names, ctx->insn_info);
+    smemblk_free(ctx->symbol_names, ctx->symtab);
+    smemblk_free(ctx->symbol_names, ctx->def_params);
+    smemblk_free(ctx->symbol_names, ctx->functions);
+    smemblk_free(ctx->symbol_names, ctx->token_text);
+#ifdef URUBASIC_JIT
+    for (i=0; i<ctx->jit_count; ++i)
+        smemblk_free(ctx->symbol_names, ctx->jit_regions[i].syms);
+    smemblk_free(ctx->symbol_names, ctx->jit_regions);
+#endif
+    heap = ctx->symbol_names;
+    smemblk_free(heap, ctx);
+}
+#endif
+
+void ICACHE_FLASH_ATTR urubasic_term(struct urubasic_ctx *ctx)
+{
+    // everything of the context is in its heap, which is released at once.
+    // With SMEMBLK_CHECK_LEAKS the blocks are freed one by one before, so
+    // that smemblk_term() reports the ones which were lost
+    smemblk_t *heap = ctx->symbol_names;
+
+#ifdef URUBASIC_JIT
+    if (ctx->jit_buffer != NULL)
+        munmap(ctx->jit_buffer, JIT_BUFFER_SIZE);
+#endif
+#ifdef SMEMBLK_CHECK_LEAKS
+    free_all(ctx);
+#endif
+    smemblk_term(heap);
+}
+
+int ICACHE_FLASH_ATTR urubasic_save_size(struct urubasic_ctx *ctx)
+{
+    // the snapshot is the address of the context and the used part of its heap
+    if (ctx->insn_count > 0 || ctx->code != NULL)
+        return 0;
+    return (int) sizeof(ctx) + smemblk_save_size(ctx->symbol_names);
+}
+
+void ICACHE_FLASH_ATTR urubasic_save(struct urubasic_ctx *ctx, void *snapshot)
+{
+    memcpy(snapshot, &ctx, sizeof(ctx));
+    smemblk_save(ctx->symbol_names, (char *) snapshot + sizeof(ctx));
+}
+
+struct urubasic_ctx * ICACHE_FLASH_ATTR urubasic_init_saved(void *mem, int max_mem, const void *snapshot, int snapshot_len, const char *text, int len)
+{
+    struct urubasic_ctx *ctx;
+    smemblk_t *heap;
+
+    if (mem == NULL || snapshot_len <= (int) sizeof(ctx))
+        return NULL;
+    memcpy(&ctx, snapshot, sizeof(ctx));
+    heap = smemblk_restore(mem, max_mem, (const char *) snapshot + sizeof(ctx), snapshot_len - (int) sizeof(ctx));
+
+    // the symbols point into the heap, it must be back at its address
+    if (heap == NULL || (char *) ctx < (char *) heap || (char *) ctx >= (char *) mem + max_mem || ctx->symbol_names != heap)
+        return NULL;
+    load_text(ctx, text, len, max_mem);
+    return ctx;
 }
 
 // argument (urubasic_type) handling
@@ -1803,7 +6191,7 @@ int ICACHE_FLASH_ATTR urubasic_is_number(struct urubasic_type *arg)
 
 int ICACHE_FLASH_ATTR urubasic_is_string(struct urubasic_type *arg)
 {
-    return arg->type & STRING;
+    return (arg->type & 0xff) == STRING;
 }
 
 int ICACHE_FLASH_ATTR urubasic_get_number(struct urubasic_type *arg)
@@ -1829,18 +6217,37 @@ int ICACHE_FLASH_ATTR urubasic_set_number(struct urubasic_type *arg, int num)
     return rc;
 }
 
-char * ICACHE_FLASH_ATTR urubasic_get_string(struct urubasic_type *arg)
+char * ICACHE_FLASH_ATTR urubasic_get_string(struct urubasic_ctx *ctx, struct urubasic_type *arg)
 {
-    return (char *) symbol_names + arg->value;
+    // the host gets a NUL terminated copy of a view
+    struct urubasic_type copy;
+    char *text;
+
+    if (string_head(ctx, arg->value)->refs & STRING_VIEW) {
+        text = string_alloc(ctx, &copy, string_len(ctx, arg->value));
+        if (text == NULL)
+            return "";
+        memcpy(text, string_text(ctx, arg->value), (size_t) string_len(ctx, arg->value));
+        vm_release(ctx, arg, 1);
+        *arg = copy;
+    }
+    return string_text(ctx, arg->value);
 }
 
-int ICACHE_FLASH_ATTR urubasic_alloc_string(struct urubasic_type *arg, int len)
+int ICACHE_FLASH_ATTR urubasic_alloc_string(struct urubasic_ctx *ctx, struct urubasic_type *arg, int len)
 {
-    char *s;
-    s = smemblk_alloc(symbol_names, (int16_t) len);
-    if (s != NULL) {
+    // len bytes for the text and its NUL, the text is counted on first use
+    struct String *s;
+    int handle = -1;
+
+    if (len > 0 && len < SMEMBLK_MAX_SIZE - 2 * (int) sizeof(struct String))
+        handle = string_new(ctx, (int) sizeof(struct String) + len);
+    if (handle >= 0) {
+        s = string_head(ctx, handle);
+        s->len  = -1;
+        s->refs = 1;
         arg[0].type = STRING|ALLOC;
-        arg[0].value = s - (char *)symbol_names;
+        arg[0].value = handle;
     }
-    return s != NULL;
+    return handle >= 0;
 }
@@ -7,16 +7,50 @@
 
 struct urubasic_type {
     uint16_t type; // STRING or NUMBER
-    int     value; // the value itself or a string offset
+    int     value; // the value itself or the handle of a string
 };
 
-int ICACHE_FLASH_ATTR urubasic_init(void *mem, int max_mem, int (*read_from_stdin)(void *), void *arg);
+// one interpreter with its own heap and program, independent contexts may
+// run on different threads
+struct urubasic_ctx;
 
-void ICACHE_FLASH_ATTR urubasic_add_function(char *name, int (*func)(int n, struct urubasic_type *arg, void *user), void *user);
+// mem may be NULL for a heap which grows up to max_mem bytes
+struct urubasic_ctx * ICACHE_FLASH_ATTR urubasic_init(void *mem, int max_mem, int (*read_from_stdin)(void *), void *arg);
 
-void ICACHE_FLASH_ATTR urubasic_execute(int insn);
+// loads the program from len bytes of text, e.g. a mapped file
+struct urubasic_ctx * ICACHE_FLASH_ATTR urubasic_init_text(void *mem, int max_mem, const char *text, int len);
 
-void ICACHE_FLASH_ATTR urubasic_term(void);
+void ICACHE_FLASH_ATTR urubasic_add_function(struct urubasic_ctx *ctx, char *name, int (*func)(struct urubasic_ctx *ctx, int n, struct urubasic_type *arg, void *user), void *user);
+
+void ICACHE_FLASH_ATTR urubasic_execute(struct urubasic_ctx *ctx, int insn);
+
+// optimization level of the program, set before it runs the first time: 0 none,
+// 1 (default) within single statements, 2 also over the whole program. Level 2
+// assumes that the program runs from its start before it is started at other
+// lines and that FOR loops are entered by their FOR, main.c selects it
+void ICACHE_FLASH_ATTR urubasic_set_optimize(struct urubasic_ctx *ctx, int level);
+
+// writes the program to the output like LIST
+void ICACHE_FLASH_ATTR urubasic_list(struct urubasic_ctx *ctx);
+
+// writes the program as C source to the output, compiled with the runtime
+// it runs without the VM (not in the ESP8266 build)
+void ICACHE_FLASH_ATTR urubasic_emit_c(struct urubasic_ctx *ctx);
+
+// PRINT output is handed to write(arg, buf, len) in blocks, buf[len] is '\0'.
+// The default writes to stdout, the output is flushed when urubasic_execute returns
+void ICACHE_FLASH_ATTR urubasic_set_output(struct urubasic_ctx *ctx, int (*write)(void *arg, const char *buf, int len), void *arg);
+
+// releases the heap of the context with everything in it at once
+void ICACHE_FLASH_ATTR urubasic_term(struct urubasic_ctx *ctx);
+
+// batch runs: a context in mem without a program (urubasic_init_text with len
+// 0) and its functions is saved once in urubasic_save_size bytes, 0 if it has
+// a program. urubasic_init_saved restores it to the same mem and loads the text,
+// which skips setting up the symbols. Returns NULL if mem is not the same
+int ICACHE_FLASH_ATTR urubasic_save_size(struct urubasic_ctx *ctx);
+void ICACHE_FLASH_ATTR urubasic_save(struct urubasic_ctx *ctx, void *snapshot);
+struct urubasic_ctx * ICACHE_FLASH_ATTR urubasic_init_saved(void *mem, int max_mem, const void *snapshot, int snapshot_len, const char *text, int len);
 
 
 // argument (urubasic_type) handling
@@ -24,7 +58,8 @@ int ICACHE_FLASH_ATTR urubasic_is_number(struct urubasic_type *arg);
 int ICACHE_FLASH_ATTR urubasic_is_string(struct urubasic_type *arg);
 int ICACHE_FLASH_ATTR urubasic_get_number(struct urubasic_type *arg);
 int ICACHE_FLASH_ATTR urubasic_set_number(struct urubasic_type *arg, int num);
-char * ICACHE_FLASH_ATTR urubasic_get_string(struct urubasic_type *arg);
-int ICACHE_FLASH_ATTR urubasic_alloc_string(struct urubasic_type *arg, int len);
+// the text may move when a string is allocated, e.g. by urubasic_alloc_string
+char * ICACHE_FLASH_ATTR urubasic_get_string(struct urubasic_ctx *ctx, struct urubasic_type *arg);
+int ICACHE_FLASH_ATTR urubasic_alloc_string(struct urubasic_ctx *ctx, struct urubasic_type *arg, int len);
 
 #endif